@@ -0,0 +1,202 @@
+#include "mo_bvh.h"
+#include "mo_mesh.h"
+
+#include <linalg.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace linalg;
+using namespace linalg::aliases;
+
+// compares the build modes on the same meshes: build time, tree quality and ray query time
+// usage: bvh_benchmark [grid size] [ray count]
+
+struct MoBenchmarkMesh
+{
+    std::vector<std::uint32_t> indices;
+    std::vector<float3>        vertices;
+    MoMesh_T                   mesh;
+};
+
+static void moFinalizeMesh(MoBenchmarkMesh& benchmarkMesh)
+{
+    benchmarkMesh.mesh = {};
+    benchmarkMesh.mesh.pIndices = benchmarkMesh.indices.data();
+    benchmarkMesh.mesh.indexCount = std::uint32_t(benchmarkMesh.indices.size());
+    benchmarkMesh.mesh.pVertices = benchmarkMesh.vertices.data();
+    benchmarkMesh.mesh.vertexCount = std::uint32_t(benchmarkMesh.vertices.size());
+}
+
+// rolling height field of 2 * size * size triangles over [-50, 50]
+static void moCreateHeightField(std::uint32_t size, MoBenchmarkMesh& benchmarkMesh)
+{
+    for (std::uint32_t j = 0; j <= size; ++j)
+    {
+        for (std::uint32_t i = 0; i <= size; ++i)
+        {
+            benchmarkMesh.vertices.push_back({float(i) * 100.f / size - 50.f, std::sin(i * 0.3f) * std::cos(j * 0.2f) * 3.f, float(j) * 100.f / size - 50.f});
+        }
+    }
+    for (std::uint32_t j = 0; j < size; ++j)
+    {
+        for (std::uint32_t i = 0; i < size; ++i)
+        {
+            std::uint32_t a = j * (size + 1) + i, b = a + 1, c = a + size + 1, d = c + 1;
+            benchmarkMesh.indices.insert(benchmarkMesh.indices.end(), {a, c, b, b, c, d});
+        }
+    }
+    moFinalizeMesh(benchmarkMesh);
+}
+
+// small triangles scattered through a cube, the worst case for spatial coherence
+static void moCreateTriangleSoup(std::uint32_t triangleCount, std::mt19937& generator, MoBenchmarkMesh& benchmarkMesh)
+{
+    std::uniform_real_distribution<float> center(-50.f, 50.f), offset(-2.f, 2.f);
+    for (std::uint32_t t = 0; t < triangleCount; ++t)
+    {
+        const float3 c(center(generator), center(generator), center(generator));
+        for (std::uint32_t k = 0; k < 3; ++k)
+        {
+            benchmarkMesh.indices.push_back(std::uint32_t(benchmarkMesh.vertices.size()));
+            benchmarkMesh.vertices.push_back(c + float3(offset(generator), offset(generator), offset(generator)));
+        }
+    }
+    moFinalizeMesh(benchmarkMesh);
+}
+
+static double moElapsedMilliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void moBenchmark(const char* meshName, MoBenchmarkMesh& benchmarkMesh, const std::vector<MoRay>& rays)
+{
+    struct Mode
+    {
+        const char*    name;
+        MoBVHBuildMode buildMode;
+        std::uint32_t  threadCount;
+    };
+    const Mode modes[] = {{"midpoint", MO_BVH_BUILD_MODE_MIDPOINT, 1},
+                          {"lbvh", MO_BVH_BUILD_MODE_LBVH, 1},
+                          {"lbvh mt", MO_BVH_BUILD_MODE_LBVH, 0},
+                          {"binned sah", MO_BVH_BUILD_MODE_BINNED_SAH, 1},
+                          {"binned sah mt", MO_BVH_BUILD_MODE_BINNED_SAH, 0}};
+
+    printf("%s, %u triangles, %zu rays\n", meshName, benchmarkMesh.mesh.indexCount / 3, rays.size());
+    printf("  %-14s %10s %10s %8s %12s %8s\n", "mode", "build ms", "sah cost", "depth", "ray ns", "hits");
+    for (const Mode& mode : modes)
+    {
+        MoBVHCreateInfo createInfo = {};
+        createInfo.buildMode = mode.buildMode;
+        createInfo.threadCount = mode.threadCount;
+
+        // best of three builds
+        double buildTime = 0.0;
+        MoBVH bvh = nullptr;
+        for (std::uint32_t repeat = 0; repeat < 3; ++repeat)
+        {
+            if (bvh)
+            {
+                moDestroyBVH(bvh);
+            }
+            auto start = std::chrono::steady_clock::now();
+            moCreateBVH(&benchmarkMesh.mesh, &createInfo, &bvh);
+            double time = moElapsedMilliseconds(start);
+            buildTime = repeat == 0 ? time : std::min(buildTime, time);
+        }
+
+        MoBVHStats stats;
+        moGetBVHStats(bvh, &stats);
+
+        std::uint32_t hitCount = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const MoRay& ray : rays)
+        {
+            MoIntersectResult intersection = {};
+            hitCount += moIntersectBVH(bvh, ray, intersection);
+        }
+        const double rayTime = moElapsedMilliseconds(start) * 1e6 / std::max<std::size_t>(rays.size(), 1);
+
+        printf("  %-14s %10.1f %10.2f %8u %12.0f %8u\n", mode.name, buildTime, stats.sahCost, stats.maxDepth, rayTime, hitCount);
+        moDestroyBVH(bvh);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::uint32_t gridSize = argc > 1 ? std::uint32_t(std::atoi(argv[1])) : 700;
+    const std::uint32_t rayCount = argc > 2 ? std::uint32_t(std::atoi(argv[2])) : 300000;
+
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+    // rays looking down at the height field, and rays from anywhere in any direction through the soup
+    std::vector<MoRay> downwardRays(rayCount), randomRays(rayCount);
+    for (MoRay& ray : downwardRays)
+    {
+        ray = MoRay(float3(unit(generator) * 50.f, 10.f, unit(generator) * 50.f), normalize(float3(unit(generator), -1.f, unit(generator))));
+    }
+    for (MoRay& ray : randomRays)
+    {
+        ray = MoRay(float3(unit(generator) * 60.f, unit(generator) * 10.f, unit(generator) * 60.f), normalize(float3(unit(generator), unit(generator), unit(generator))));
+    }
+
+    MoBenchmarkMesh heightField;
+    moCreateHeightField(gridSize, heightField);
+    moBenchmark("height field", heightField, downwardRays);
+
+    MoBenchmarkMesh triangleSoup;
+    moCreateTriangleSoup(gridSize * gridSize / 2, generator, triangleSoup);
+    moBenchmark("triangle soup", triangleSoup, randomRays);
+
+    return 0;
+}
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE A - MIT License
+Copyright (c) 2018 Patrick Pelletier
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE B - Public Domain (www.unlicense.org)
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------
+*/
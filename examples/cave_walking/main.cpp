@@ -133,11 +133,11 @@ int main(int argc, char** argv)
 
     // Phong
     VkPipeline phongPipeline;
-    moCreatePipeline(swapChain->renderPass, pipelineLayout->pipelineLayout, "phong_noisy.glsl", &phongPipeline);
+    moCreatePipeline(swapChain->renderPass, pipelineLayout, "phong_noisy.glsl", &phongPipeline);
 
     // Dome
     VkPipeline domePipeline;
-    moCreatePipeline(swapChain->renderPass, pipelineLayout->pipelineLayout, "dome_noisy.glsl", &domePipeline, MO_PIPELINE_FEATURE_NONE);
+    moCreatePipeline(swapChain->renderPass, pipelineLayout, "dome_noisy.glsl", &domePipeline, MO_PIPELINE_FEATURE_NONE);
 
     MoMesh sphereMesh;
     moCreateDemoSphere(&sphereMesh);
@@ -214,7 +214,7 @@ int main(int argc, char** argv)
     }
 
     VkPipeline occlusionPipeline;
-    moCreatePipeline(renderPassUV, pipelineLayout->pipelineLayout, "occlusion.glsl", &occlusionPipeline, MO_PIPELINE_FEATURE_NONE);
+    moCreatePipeline(renderPassUV, pipelineLayout, "occlusion.glsl", &occlusionPipeline, MO_PIPELINE_FEATURE_NONE);
 
     VkRenderPass renderPassRepair;
     VkFramebuffer framebufferRepair;
@@ -263,7 +263,7 @@ int main(int argc, char** argv)
     }
 
     VkPipeline occlusionRepairPipeline;
-    moCreatePipeline(renderPassRepair, pipelineLayout->pipelineLayout, "occlusion_repair.glsl", &occlusionRepairPipeline, MO_PIPELINE_FEATURE_NONE);
+    moCreatePipeline(renderPassRepair, pipelineLayout, "occlusion_repair.glsl", &occlusionRepairPipeline, MO_PIPELINE_FEATURE_NONE, VK_TRUE);
 
     MoMesh cubeMesh;
     moCreateDemoCube(&cubeMesh, float3(0.5,0.5,0.5));
@@ -284,23 +284,12 @@ int main(int argc, char** argv)
             {
                 float4 orig = float4(camera.position + float3(0,1.8,0), 1);
                 float4 downDir = float4(0,-1,0,0);
-                std::function<void(MoNode, const float4x4 &)> snap = [&](MoNode node, const float4x4 & model)
+                MoRay ray(orig.xyz(), downDir.xyz());
+                MoSceneIntersectResult result = {};
+                if (moIntersectScene(scene, ray, result, true))
                 {
-                    if (node->mesh)
-                    {
-                        MoRay ray(mul(inverse(model), orig).xyz(), mul(inverse(model), downDir).xyz());
-                        MoIntersectResult result = {};
-                        if (moIntersectBVH(node->mesh->bvh, ray, result, true))
-                        {
-                            camera.position = orig.xyz() + result.distance * downDir.xyz() + float3(0,1.8,0);
-                        }
-                    }
-                    for (std::uint32_t i = 0; i < node->nodeCount; ++i)
-                    {
-                        snap(node->pNodes[i], mul(model, node->pNodes[i]->model));
-                    }
-                };
-                snap(scene->root, scene->root->model);
+                    camera.position = orig.xyz() + result.intersection.distance * downDir.xyz() + float3(0,1.8,0);
+                }
             }
         }
 
@@ -386,7 +375,7 @@ int main(int argc, char** argv)
                             moBindMaterial(currentCommandBuffer.buffer, node->material, pipelineLayout->pipelineLayout);
                             vkCmdPushConstants(currentCommandBuffer.buffer, pipelineLayout->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MoPushConstant), &pmv);
                             moBindMesh(currentCommandBuffer.buffer, cubeMesh, pipelineLayout->pipelineLayout);
-                            moDrawMesh(currentCommandBuffer.buffer, cubeMesh);
+                            moDrawMeshPositions(currentCommandBuffer.buffer, cubeMesh);
                         }
                         for (std::uint32_t i = 0; i < node->nodeCount; ++i)
                         {
@@ -93,7 +93,7 @@ int main(int argc, char** argv)
 
     // Passthrough
     VkPipeline passthroughPipeline;
-    moCreatePipeline(swapChain->renderPass, pipelineLayout->pipelineLayout, "passthrough.glsl", &passthroughPipeline, MO_PIPELINE_FEATURE_NONE);
+    moCreatePipeline(swapChain->renderPass, pipelineLayout, "passthrough.glsl", &passthroughPipeline, MO_PIPELINE_FEATURE_NONE);
 
     MoMesh cubeMesh;
     moCreateDemoCube(&cubeMesh, float3(0.5,0.5,0.5));
@@ -145,11 +145,11 @@ int main(int argc, char** argv)
 
     // Phong
     VkPipeline phongPipeline;
-    moCreatePipeline(swapChain->renderPass, pipelineLayout->pipelineLayout, "phong.glsl", &phongPipeline);
+    moCreatePipeline(swapChain->renderPass, pipelineLayout, "phong.glsl", &phongPipeline);
 
     // Dome
     VkPipeline domePipeline;
-    moCreatePipeline(swapChain->renderPass, pipelineLayout->pipelineLayout, "dome.glsl", &domePipeline, MO_PIPELINE_FEATURE_NONE);
+    moCreatePipeline(swapChain->renderPass, pipelineLayout, "dome.glsl", &domePipeline, MO_PIPELINE_FEATURE_NONE);
 
     MoMesh sphereMesh;
     moCreateDemoSphere(&sphereMesh);
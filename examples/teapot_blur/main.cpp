@@ -133,7 +133,7 @@ int main(int argc, char** argv)
 
     // Phong
     VkPipeline phongPipeline;
-    moCreatePipeline(swapChain->renderPass, pipelineLayout->pipelineLayout, "phong.glsl", &phongPipeline);
+    moCreatePipeline(swapChain->renderPass, pipelineLayout, "phong.glsl", &phongPipeline);
 
     // Blur
     MoRenderbuffer renderBuffer;
@@ -142,7 +142,7 @@ int main(int argc, char** argv)
 
     // Dome
     VkPipeline domePipeline;
-    moCreatePipeline(swapChain->renderPass, pipelineLayout->pipelineLayout, "dome.glsl", &domePipeline, MO_PIPELINE_FEATURE_NONE);
+    moCreatePipeline(swapChain->renderPass, pipelineLayout, "dome.glsl", &domePipeline, MO_PIPELINE_FEATURE_NONE);
 
     MoMesh sphereMesh;
     moCreateDemoSphere(&sphereMesh);
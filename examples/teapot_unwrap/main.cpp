@@ -95,7 +95,7 @@ int main(int argc, char** argv)
 
     // Passthrough
     VkPipeline passthroughPipeline;
-    moCreatePipeline(swapChain->renderPass, pipelineLayout->pipelineLayout, "unwrap.glsl", &passthroughPipeline, MO_PIPELINE_FEATURE_NONE);
+    moCreatePipeline(swapChain->renderPass, pipelineLayout, "unwrap.glsl", &passthroughPipeline, MO_PIPELINE_FEATURE_NONE);
 
     // Blur
     MoRenderbuffer renderBuffer;
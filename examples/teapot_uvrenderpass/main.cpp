@@ -138,11 +138,11 @@ int main(int argc, char** argv)
 
     // Phong
     VkPipeline phongPipeline;
-    moCreatePipeline(swapChain->renderPass, pipelineLayout->pipelineLayout, "phong.glsl", &phongPipeline);
+    moCreatePipeline(swapChain->renderPass, pipelineLayout, "phong.glsl", &phongPipeline);
 
     // Dome
     VkPipeline domePipeline;
-    moCreatePipeline(swapChain->renderPass, pipelineLayout->pipelineLayout, "dome.glsl", &domePipeline, MO_PIPELINE_FEATURE_NONE);
+    moCreatePipeline(swapChain->renderPass, pipelineLayout, "dome.glsl", &domePipeline, MO_PIPELINE_FEATURE_NONE);
 
     MoMesh sphereMesh;
     moCreateDemoSphere(&sphereMesh);
@@ -219,7 +219,7 @@ int main(int argc, char** argv)
     }
 
     VkPipeline occlusionPipeline;
-    moCreatePipeline(renderPassUV, pipelineLayout->pipelineLayout, "occlusion.glsl", &occlusionPipeline, MO_PIPELINE_FEATURE_NONE);
+    moCreatePipeline(renderPassUV, pipelineLayout, "occlusion.glsl", &occlusionPipeline, MO_PIPELINE_FEATURE_NONE);
 
     VkRenderPass renderPassRepair;
     VkFramebuffer framebufferRepair;
@@ -268,7 +268,7 @@ int main(int argc, char** argv)
     }
 
     VkPipeline occlusionRepairPipeline;
-    moCreatePipeline(renderPassRepair, pipelineLayout->pipelineLayout, "occlusion_repair.glsl", &occlusionRepairPipeline, MO_PIPELINE_FEATURE_NONE);
+    moCreatePipeline(renderPassRepair, pipelineLayout, "occlusion_repair.glsl", &occlusionRepairPipeline, MO_PIPELINE_FEATURE_NONE, VK_TRUE);
 
     MoMesh cubeMesh;
     moCreateDemoCube(&cubeMesh, float3(0.5,0.5,0.5));
@@ -365,7 +365,7 @@ int main(int argc, char** argv)
                             moBindMaterial(currentCommandBuffer.buffer, node->material, pipelineLayout->pipelineLayout);
                             vkCmdPushConstants(currentCommandBuffer.buffer, pipelineLayout->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MoPushConstant), &pmv);
                             moBindMesh(currentCommandBuffer.buffer, cubeMesh, pipelineLayout->pipelineLayout);
-                            moDrawMesh(currentCommandBuffer.buffer, cubeMesh);
+                            moDrawMeshPositions(currentCommandBuffer.buffer, cubeMesh);
                         }
                         for (std::uint32_t i = 0; i < node->nodeCount; ++i)
                         {
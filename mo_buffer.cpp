@@ -2,6 +2,9 @@
 #include "mo_pipeline.h"
 #include "mo_swapchain.h"
 
+#include "mo_array.h"
+
+#include <algorithm>
 #include <cstring>
 
 extern MoDevice g_Device;
@@ -16,11 +19,211 @@ uint32_t moMemoryType(VkMemoryPropertyFlags properties, uint32_t type_bits)
     return 0xFFFFFFFF;
 }
 
-void moCreateBuffer(MoDeviceBuffer *pDeviceBuffer, VkDeviceSize size, VkBufferUsageFlags usage)
+static VkMemoryPropertyFlags moMemoryProperties(uint32_t memoryTypeIndex)
+{
+    VkPhysicalDeviceMemoryProperties prop;
+    vkGetPhysicalDeviceMemoryProperties(g_Device->physicalDevice, &prop);
+    return prop.memoryTypes[memoryTypeIndex].propertyFlags;
+}
+
+#define MO_MEMORY_BLOCK_ORDER 18 // log2(MO_MEMORY_BLOCK_SIZE / MO_MEMORY_MIN_ALLOCATION_SIZE)
+
+// nodes of the buddy tree are numbered from 1 at the root, node i has children 2i and 2i+1
+// pLongest holds one plus the order of the largest free node below every node, 0 when it is allocated
+typedef struct MoMemoryBlock_T {
+    VkDeviceMemory memory;
+    uint32_t       memoryTypeIndex;
+    // images with optimal tiling never share a block with buffers, which keeps them bufferImageGranularity apart
+    VkBool32       optimalTiling;
+    const uint8_t* pLongest;
+    uint32_t       nodeCount;
+    uint32_t       allocationCount;
+    // host visible memory only, mapped for the lifetime of the block
+    void*          pMapped;
+} MoMemoryBlock_T;
+
+// unguarded, buffers and images are created and destroyed on the thread that owns g_Device, like every other Vulkan call here
+static const MoMemoryBlock* g_pMemoryBlocks = nullptr;
+static uint32_t g_MemoryBlockCount = 0;
+
+static uint32_t moMemoryOrder(VkDeviceSize size)
+{
+    uint32_t order = 0;
+    while ((VkDeviceSize(MO_MEMORY_MIN_ALLOCATION_SIZE) << order) < size)
+    {
+        ++order;
+    }
+    return order;
+}
+
+static void moCreateMemoryBlock(uint32_t memoryTypeIndex, VkBool32 optimalTiling, MoMemoryBlock *pBlock)
+{
+    MoMemoryBlock block = *pBlock = new MoMemoryBlock_T();
+    *block = {};
+    block->memoryTypeIndex = memoryTypeIndex;
+    block->optimalTiling = optimalTiling;
+
+    VkMemoryAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = MO_MEMORY_BLOCK_SIZE;
+    alloc_info.memoryTypeIndex = memoryTypeIndex;
+    VkResult err = vkAllocateMemory(g_Device->device, &alloc_info, VK_NULL_HANDLE, &block->memory);
+    g_Device->pCheckVkResultFn(err);
+    if (moMemoryProperties(memoryTypeIndex) & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        err = vkMapMemory(g_Device->device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->pMapped);
+        g_Device->pCheckVkResultFn(err);
+    }
+
+    carray_resize(&block->pLongest, &block->nodeCount, 2u << MO_MEMORY_BLOCK_ORDER);
+    uint8_t* pLongest = const_cast<uint8_t*>(block->pLongest);
+    for (uint32_t order = MO_MEMORY_BLOCK_ORDER + 1, node = 1; order > 0; --order)
+    {
+        for (uint32_t last = node * 2; node < last; ++node)
+        {
+            pLongest[node] = uint8_t(order);
+        }
+    }
+}
+
+// the node of the given order with the lowest offset, the offset of a node is a multiple of its size
+static bool moAllocateMemoryBlock(MoMemoryBlock block, uint32_t order, VkDeviceSize *pOffset)
+{
+    uint8_t* pLongest = const_cast<uint8_t*>(block->pLongest);
+    if (pLongest[1] < order + 1)
+    {
+        return false;
+    }
+
+    uint32_t node = 1;
+    for (uint32_t nodeOrder = MO_MEMORY_BLOCK_ORDER; nodeOrder != order; --nodeOrder)
+    {
+        node = pLongest[node * 2] >= order + 1 ? node * 2 : node * 2 + 1;
+    }
+    pLongest[node] = 0;
+    *pOffset = VkDeviceSize(node - (1u << (MO_MEMORY_BLOCK_ORDER - order))) * (VkDeviceSize(MO_MEMORY_MIN_ALLOCATION_SIZE) << order);
+
+    for (node /= 2; node > 0; node /= 2)
+    {
+        pLongest[node] = std::max(pLongest[node * 2], pLongest[node * 2 + 1]);
+    }
+    block->allocationCount++;
+    return true;
+}
+
+// the nodes below an allocated node are left free, the first allocated node above the offset's leaf is the one to free
+static void moFreeMemoryBlock(MoMemoryBlock block, VkDeviceSize offset)
+{
+    uint8_t* pLongest = const_cast<uint8_t*>(block->pLongest);
+    uint32_t node = uint32_t(offset / MO_MEMORY_MIN_ALLOCATION_SIZE) + (1u << MO_MEMORY_BLOCK_ORDER);
+    uint32_t order = 0;
+    for (; pLongest[node] != 0; node /= 2)
+    {
+        ++order;
+    }
+    pLongest[node] = uint8_t(order + 1);
+
+    for (node /= 2, ++order; node > 0; node /= 2, ++order)
+    {
+        const uint8_t left = pLongest[node * 2], right = pLongest[node * 2 + 1];
+        pLongest[node] = (left == order && right == order) ? uint8_t(order + 1) : std::max(left, right);
+    }
+    block->allocationCount--;
+}
+
+// sub-allocate from the blocks of the memory type, large resources get their own VkDeviceMemory and no block
+// *ppMapped points at the allocation when the memory type is host visible, nullptr otherwise
+static void moAllocateMemory(const VkMemoryRequirements &req, uint32_t memoryTypeIndex, VkBool32 optimalTiling, VkDeviceMemory *pMemory, VkDeviceSize *pOffset, MoMemoryBlock *pBlock, void **ppMapped)
+{
+    *pOffset = 0;
+    *pBlock = VK_NULL_HANDLE;
+    *ppMapped = nullptr;
+    if (std::max(req.size, req.alignment) > MO_MEMORY_BLOCK_SIZE / 2)
+    {
+        VkMemoryAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = req.size;
+        alloc_info.memoryTypeIndex = memoryTypeIndex;
+        VkResult err = vkAllocateMemory(g_Device->device, &alloc_info, VK_NULL_HANDLE, pMemory);
+        g_Device->pCheckVkResultFn(err);
+        if (moMemoryProperties(memoryTypeIndex) & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        {
+            err = vkMapMemory(g_Device->device, *pMemory, 0, VK_WHOLE_SIZE, 0, ppMapped);
+            g_Device->pCheckVkResultFn(err);
+        }
+        return;
+    }
+
+    // power of two alignments are met by the nodes' offsets
+    const uint32_t order = moMemoryOrder(std::max(req.size, req.alignment));
+    for (uint32_t i = 0; i < g_MemoryBlockCount; ++i)
+    {
+        MoMemoryBlock block = g_pMemoryBlocks[i];
+        if (block->memoryTypeIndex == memoryTypeIndex && block->optimalTiling == optimalTiling
+         && moAllocateMemoryBlock(block, order, pOffset))
+        {
+            *pMemory = block->memory;
+            *pBlock = block;
+            *ppMapped = block->pMapped ? static_cast<char*>(block->pMapped) + *pOffset : nullptr;
+            return;
+        }
+    }
+
+    MoMemoryBlock block;
+    moCreateMemoryBlock(memoryTypeIndex, optimalTiling, &block);
+    carray_push_back(&g_pMemoryBlocks, &g_MemoryBlockCount, block);
+    moAllocateMemoryBlock(block, order, pOffset);
+    *pMemory = block->memory;
+    *pBlock = block;
+    *ppMapped = block->pMapped ? static_cast<char*>(block->pMapped) + *pOffset : nullptr;
+}
+
+// empty blocks are kept for the next allocations until moFreeMemoryBlocks
+// freeing a mapped VkDeviceMemory unmaps it
+static void moFreeMemory(VkDeviceMemory memory, VkDeviceSize offset, MoMemoryBlock block)
+{
+    if (block == VK_NULL_HANDLE)
+    {
+        vkFreeMemory(g_Device->device, memory, VK_NULL_HANDLE);
+        return;
+    }
+    moFreeMemoryBlock(block, offset);
+}
+
+void moFreeMemoryBlocks()
+{
+    uint32_t blockCount = 0;
+    for (uint32_t i = 0; i < g_MemoryBlockCount; ++i)
+    {
+        MoMemoryBlock block = g_pMemoryBlocks[i];
+        if (block->allocationCount == 0)
+        {
+            vkFreeMemory(g_Device->device, block->memory, VK_NULL_HANDLE);
+            carray_free(block->pLongest, &block->nodeCount);
+            delete block;
+            continue;
+        }
+        const_cast<MoMemoryBlock*>(g_pMemoryBlocks)[blockCount++] = block;
+    }
+    if (blockCount == 0)
+    {
+        carray_free(g_pMemoryBlocks, &g_MemoryBlockCount);
+        g_pMemoryBlocks = nullptr;
+        return;
+    }
+    carray_resize(&g_pMemoryBlocks, &g_MemoryBlockCount, blockCount);
+}
+
+void moCreateBuffer(MoDeviceBuffer *pDeviceBuffer, VkDeviceSize size, VkBufferUsageFlags usage, MoMemoryPlacement placement)
 {
     MoDeviceBuffer deviceBuffer = *pDeviceBuffer = new MoDeviceBuffer_T();
     *deviceBuffer = {};
 
+    if (placement == MO_MEMORY_PLACEMENT_DEVICE_LOCAL)
+    {
+        usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    }
+
     VkResult err;
     {
         VkDeviceSize buffer_size_aligned = ((size - 1) / g_Device->memoryAlignment + 1) * g_Device->memoryAlignment;
@@ -36,44 +239,175 @@ void moCreateBuffer(MoDeviceBuffer *pDeviceBuffer, VkDeviceSize size, VkBufferUs
         VkMemoryRequirements req;
         vkGetBufferMemoryRequirements(g_Device->device, deviceBuffer->buffer, &req);
         g_Device->memoryAlignment = (g_Device->memoryAlignment > req.alignment) ? g_Device->memoryAlignment : req.alignment;
-        VkMemoryAllocateInfo alloc_info = {};
-        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        alloc_info.allocationSize = req.size;
-        alloc_info.memoryTypeIndex = moMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, req.memoryTypeBits);
-        err = vkAllocateMemory(g_Device->device, &alloc_info, VK_NULL_HANDLE, &deviceBuffer->memory);
-        g_Device->pCheckVkResultFn(err);
+        VkMemoryPropertyFlags properties = placement == MO_MEMORY_PLACEMENT_DEVICE_LOCAL ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        uint32_t memoryTypeIndex = moMemoryType(properties, req.memoryTypeBits);
+        moAllocateMemory(req, memoryTypeIndex, VK_FALSE, &deviceBuffer->memory, &deviceBuffer->offset, &deviceBuffer->block, &deviceBuffer->pMapped);
+        deviceBuffer->memoryProperties = moMemoryProperties(memoryTypeIndex);
     }
 
-    err = vkBindBufferMemory(g_Device->device, deviceBuffer->buffer, deviceBuffer->memory, 0);
+    err = vkBindBufferMemory(g_Device->device, deviceBuffer->buffer, deviceBuffer->memory, deviceBuffer->offset);
     g_Device->pCheckVkResultFn(err);
     deviceBuffer->size = size;
 }
 
 void moUploadBuffer(MoDeviceBuffer deviceBuffer, VkDeviceSize dataSize, const void *pData)
 {
+    moUploadBuffer(deviceBuffer, 0, dataSize, pData);
+}
+
+// makes the transfer writes to size bytes at offset visible to any later command
+static void moTransferBarrier(VkCommandBuffer commandBuffer, MoDeviceBuffer toBuffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    VkBufferMemoryBarrier use_barrier = {};
+    use_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    use_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    use_barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    use_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    use_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    use_barrier.buffer = toBuffer->buffer;
+    use_barrier.offset = offset;
+    use_barrier.size = size;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, VK_NULL_HANDLE, 1, &use_barrier, 0, VK_NULL_HANDLE);
+}
+
+// host visible copy of pData for the batch's copies, deleted by moEndUploadBatch
+static MoDeviceBuffer moCreateStagingBuffer(MoUploadBatch batch, VkDeviceSize size, const void *pData)
+{
+    MoDeviceBuffer staging = {};
+    moCreateBuffer(&staging, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    moUploadBuffer(staging, size, pData);
+    carray_push_back(&batch->pStagingBuffers, &batch->stagingBufferCount, staging);
+    return staging;
+}
+
+void moUploadBuffer(MoDeviceBuffer deviceBuffer, VkDeviceSize offset, VkDeviceSize dataSize, const void *pData)
+{
+    if (dataSize == 0)
+    {
+        return;
+    }
+    if ((deviceBuffer->memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
+    {
+        MoUploadBatch batch;
+        moBeginUploadBatch(&batch);
+        moUploadBuffer(batch, deviceBuffer, offset, dataSize, pData);
+        moEndUploadBatch(batch);
+        return;
+    }
+
+    memcpy(static_cast<char*>(deviceBuffer->pMapped) + offset, pData, dataSize);
+    moFlushBuffer(deviceBuffer, offset, dataSize);
+}
+
+void moBeginUploadBatch(MoUploadBatch *pBatch)
+{
+    MoUploadBatch batch = *pBatch = new MoUploadBatch_T();
+    *batch = {};
+
     VkResult err;
     {
-        void* dest = nullptr;
-        err = vkMapMemory(g_Device->device, deviceBuffer->memory, 0, dataSize, 0, &dest);
+        VkCommandBufferAllocateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        info.commandPool = g_Device->uploadCommandPool;
+        info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        info.commandBufferCount = 1;
+        err = vkAllocateCommandBuffers(g_Device->device, &info, &batch->commandBuffer);
+        g_Device->pCheckVkResultFn(err);
+    }
+    {
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        err = vkBeginCommandBuffer(batch->commandBuffer, &begin_info);
         g_Device->pCheckVkResultFn(err);
-        memcpy(dest, pData, dataSize);
     }
+}
+
+void moUploadBuffer(MoUploadBatch batch, MoDeviceBuffer deviceBuffer, VkDeviceSize offset, VkDeviceSize dataSize, const void *pData)
+{
+    if (dataSize == 0)
+    {
+        return;
+    }
+    if (deviceBuffer->memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        moUploadBuffer(deviceBuffer, offset, dataSize, pData);
+        return;
+    }
+
+    MoDeviceBuffer staging = moCreateStagingBuffer(batch, dataSize, pData);
+    moTransferBuffer(batch->commandBuffer, staging, deviceBuffer, offset, dataSize);
+}
+
+void moEndUploadBatch(MoUploadBatch batch)
+{
+    VkResult err = vkEndCommandBuffer(batch->commandBuffer);
+    g_Device->pCheckVkResultFn(err);
+
+    // nothing recorded when every buffer was host visible
+    if (batch->stagingBufferCount)
     {
-        VkMappedMemoryRange range = {};
-        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        range.memory = deviceBuffer->memory;
-        range.size = VK_WHOLE_SIZE;
-        err = vkFlushMappedMemoryRanges(g_Device->device, 1, &range);
+        VkSubmitInfo endInfo = {};
+        endInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        endInfo.commandBufferCount = 1;
+        endInfo.pCommandBuffers = &batch->commandBuffer;
+        err = vkQueueSubmit(g_Device->queue, 1, &endInfo, g_Device->uploadFence);
+        g_Device->pCheckVkResultFn(err);
+
+        // wait
+        err = vkWaitForFences(g_Device->device, 1, &g_Device->uploadFence, VK_TRUE, UINT64_MAX);
+        g_Device->pCheckVkResultFn(err);
+        err = vkResetFences(g_Device->device, 1, &g_Device->uploadFence);
         g_Device->pCheckVkResultFn(err);
     }
 
-    vkUnmapMemory(g_Device->device, deviceBuffer->memory);
+    vkFreeCommandBuffers(g_Device->device, g_Device->uploadCommandPool, 1, &batch->commandBuffer);
+    for (uint32_t i = 0; i < batch->stagingBufferCount; ++i)
+    {
+        moDeleteBuffer(batch->pStagingBuffers[i]);
+    }
+    carray_free(batch->pStagingBuffers, &batch->stagingBufferCount);
+    delete batch;
+}
+
+void moFlushBuffer(MoDeviceBuffer deviceBuffer, VkDeviceSize offset, VkDeviceSize dataSize)
+{
+    if (deviceBuffer->memoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+    {
+        return;
+    }
+
+    // widened to nonCoherentAtomSize, buffer offsets and sizes are multiples of MO_MEMORY_MIN_ALLOCATION_SIZE which is never smaller
+    const VkDeviceSize atomSize = g_Device->nonCoherentAtomSize;
+    const VkDeviceSize begin = (deviceBuffer->offset + offset) / atomSize * atomSize;
+    const VkDeviceSize end = ((deviceBuffer->offset + offset + dataSize - 1) / atomSize + 1) * atomSize;
+
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = deviceBuffer->memory;
+    range.offset = begin;
+    // a dedicated allocation is as large as the buffer, its rounded end may fall past the memory
+    range.size = deviceBuffer->block == VK_NULL_HANDLE && end > deviceBuffer->offset + deviceBuffer->size ? VK_WHOLE_SIZE : end - begin;
+    VkResult err = vkFlushMappedMemoryRanges(g_Device->device, 1, &range);
+    g_Device->pCheckVkResultFn(err);
+}
+
+void moTransferBuffer(VkCommandBuffer commandBuffer, MoDeviceBuffer fromBuffer, MoDeviceBuffer toBuffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    {
+        VkBufferCopy region = {};
+        region.srcOffset = 0;
+        region.dstOffset = offset;
+        region.size = size;
+        vkCmdCopyBuffer(commandBuffer, fromBuffer->buffer, toBuffer->buffer, 1, &region);
+    }
+    moTransferBarrier(commandBuffer, toBuffer, offset, size);
 }
 
 void moDeleteBuffer(MoDeviceBuffer deviceBuffer)
 {
     vkDestroyBuffer(g_Device->device, deviceBuffer->buffer, VK_NULL_HANDLE);
-    vkFreeMemory(g_Device->device, deviceBuffer->memory, VK_NULL_HANDLE);
+    moFreeMemory(deviceBuffer->memory, deviceBuffer->offset, deviceBuffer->block);
     delete deviceBuffer;
 }
 
@@ -102,13 +436,10 @@ void moCreateBuffer(MoImageBuffer *pImageBuffer, const VkExtent3D & extent, VkFo
     {
         VkMemoryRequirements req;
         vkGetImageMemoryRequirements(g_Device->device, imageBuffer->image, &req);
-        VkMemoryAllocateInfo info = {};
-        info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        info.allocationSize = req.size;
-        info.memoryTypeIndex = moMemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, req.memoryTypeBits);
-        err = vkAllocateMemory(g_Device->device, &info, VK_NULL_HANDLE, &imageBuffer->memory);
-        g_Device->pCheckVkResultFn(err);
-        err = vkBindImageMemory(g_Device->device, imageBuffer->image, imageBuffer->memory, 0);
+        uint32_t memoryTypeIndex = moMemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, req.memoryTypeBits);
+        void* pMapped;
+        moAllocateMemory(req, memoryTypeIndex, VK_TRUE, &imageBuffer->memory, &imageBuffer->offset, &imageBuffer->block, &pMapped);
+        err = vkBindImageMemory(g_Device->device, imageBuffer->image, imageBuffer->memory, imageBuffer->offset);
         g_Device->pCheckVkResultFn(err);
     }
     {
@@ -175,7 +506,7 @@ void moDeleteBuffer(MoImageBuffer imageBuffer)
 {
     vkDestroyImageView(g_Device->device, imageBuffer->view, VK_NULL_HANDLE);
     vkDestroyImage(g_Device->device, imageBuffer->image, VK_NULL_HANDLE);
-    vkFreeMemory(g_Device->device, imageBuffer->memory, VK_NULL_HANDLE);
+    moFreeMemory(imageBuffer->memory, imageBuffer->offset, imageBuffer->block);
     delete imageBuffer;
 }
 
@@ -6,15 +6,40 @@
 
 #include <linalg.h>
 
+typedef enum MoMemoryPlacement {
+    // read by the GPU only, uploads go through a staging buffer and a transfer command buffer
+    MO_MEMORY_PLACEMENT_DEVICE_LOCAL = 0,
+    // mapped by every upload, for data that changes every frame
+    MO_MEMORY_PLACEMENT_HOST_VISIBLE = 1,
+    MO_MEMORY_PLACEMENT_MAX_ENUM     = 0x7FFFFFFF
+} MoMemoryPlacement;
+
+// buffers and images share large VkDeviceMemory blocks, one buddy allocator per block
+// the allocator is not thread safe, create and destroy buffers and images from a single thread
+#define MO_MEMORY_BLOCK_SIZE (64 * 1024 * 1024)
+#define MO_MEMORY_MIN_ALLOCATION_SIZE 256
+
+typedef struct MoMemoryBlock_T* MoMemoryBlock;
+
 typedef struct MoDeviceBuffer_T {
     VkBuffer buffer;
     VkDeviceMemory memory;
+    // of the buffer in memory, shared with other buffers when block is set
+    VkDeviceSize offset;
+    MoMemoryBlock block;
     VkDeviceSize size;
+    // of the memory type picked for the placement, device local memory may also be host visible on integrated GPUs
+    VkMemoryPropertyFlags memoryProperties;
+    // host visible memory only, mapped for the lifetime of the buffer, see moFlushBuffer after writing to it
+    void* pMapped;
 }* MoDeviceBuffer;
 
 typedef struct MoImageBuffer_T {
     VkImage image;
     VkDeviceMemory memory;
+    // of the image in memory, shared with other images when block is set
+    VkDeviceSize offset;
+    MoMemoryBlock block;
     VkImageView view;
 }* MoImageBuffer;
 
@@ -33,6 +58,14 @@ typedef struct MoCommandBuffer {
     VkSemaphore     complete;
 } MoCommandBuffer;
 
+// copies to device local memory recorded into one command buffer of the device's upload pool, submitted once by moEndUploadBatch
+typedef struct MoUploadBatch_T {
+    VkCommandBuffer       commandBuffer;
+    // host visible sources of the recorded copies, deleted once they are done
+    const MoDeviceBuffer* pStagingBuffers;
+    uint32_t              stagingBufferCount;
+}* MoUploadBatch;
+
 typedef struct MoPushConstant {
     alignas(16) linalg::aliases::float4x4 model;
 } MoPushConstant;
@@ -46,10 +79,29 @@ typedef struct MoUniform {
 
 uint32_t moMemoryType(VkMemoryPropertyFlags properties, uint32_t type_bits);
 
-void moCreateBuffer(MoDeviceBuffer *pDeviceBuffer, VkDeviceSize size, VkBufferUsageFlags usage);
+void moCreateBuffer(MoDeviceBuffer *pDeviceBuffer, VkDeviceSize size, VkBufferUsageFlags usage, MoMemoryPlacement placement = MO_MEMORY_PLACEMENT_HOST_VISIBLE);
 
 void moUploadBuffer(MoDeviceBuffer deviceBuffer, VkDeviceSize dataSize, const void *pData);
 
+// upload dataSize bytes at offset, the rest of the buffer is left untouched
+// memory that is not host visible is copied from a staging buffer and waited for, the buffer must not be in use by the GPU
+void moUploadBuffer(MoDeviceBuffer deviceBuffer, VkDeviceSize offset, VkDeviceSize dataSize, const void *pData);
+
+// start recording uploads, several buffers are then filled with a single submission and wait
+void moBeginUploadBatch(MoUploadBatch *pBatch);
+
+// as above, host visible memory is written right away, memory that is not is copied when the batch is ended
+void moUploadBuffer(MoUploadBatch batch, MoDeviceBuffer deviceBuffer, VkDeviceSize offset, VkDeviceSize dataSize, const void *pData);
+
+// submit the recorded copies and wait for them, the buffers must not be in use by the GPU
+void moEndUploadBatch(MoUploadBatch batch);
+
+// make dataSize bytes written at offset through pMapped visible to the device, nothing to do for coherent memory
+void moFlushBuffer(MoDeviceBuffer deviceBuffer, VkDeviceSize offset, VkDeviceSize dataSize);
+
+// record a copy of size bytes to offset in toBuffer, followed by a barrier making it visible to any later command
+void moTransferBuffer(VkCommandBuffer commandBuffer, MoDeviceBuffer fromBuffer, MoDeviceBuffer toBuffer, VkDeviceSize offset, VkDeviceSize size);
+
 void moDeleteBuffer(MoDeviceBuffer deviceBuffer);
 
 void moCreateBuffer(MoImageBuffer *pImageBuffer, const VkExtent3D &extent, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask);
@@ -58,6 +110,9 @@ void moTransferBuffer(VkCommandBuffer commandBuffer, MoDeviceBuffer fromBuffer,
 
 void moDeleteBuffer(MoImageBuffer imageBuffer);
 
+// free the memory blocks left empty, every buffer and image must have been deleted before the device is destroyed
+void moFreeMemoryBlocks();
+
 template <typename T, size_t N> std::uint32_t countof(T (& arr)[N]) { return std::uint32_t(std::extent<T[N]>::value); }
 
 /*
@@ -3,11 +3,58 @@
 #include "mo_mesh.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MO_BVH_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MO_BVH_SSE
+#endif
 
 using namespace linalg;
 using namespace linalg::aliases;
 
+// 1 + 2 * gamma(3) rounded up, gamma(3) = 3 * 2^-24 / (1 - 3 * 2^-24), keeps the slab tests conservative under rounding
+// so that rays along seams reach their triangles, from Thiago Ize's "Robust BVH Ray Traversal"
+#define MO_BVH_SLAB_SCALE 1.0000004f
+
+#ifdef MO_BVH_TRAVERSAL_STATS
+static thread_local MoBVHTraversalStats moTraversalStats = {};
+#define MO_BVH_COUNT(counter, value) (moTraversalStats.counter += (value))
+#define MO_BVH_COUNT_STACK(stackPtr) (moTraversalStats.stackHighWater = std::max(moTraversalStats.stackHighWater, std::uint32_t((stackPtr) + 1)))
+#else
+#define MO_BVH_COUNT(counter, value)
+#define MO_BVH_COUNT_STACK(stackPtr)
+#endif
+
+// room for the children an inner node pushes, the builders keep leaves within MO_BVH_STACK_SIZE - 1 levels of the root
+#define MO_BVH_CHECK_STACK(traversal, stackPtr, pushCount) assert(std::int64_t(stackPtr) + std::int64_t(pushCount) < std::int64_t(sizeof(traversal) / sizeof((traversal)[0])))
+
 MoBBox::MoBBox(const float3& _min, const float3& _max)
     : min(_min)
     , max(_max)
@@ -40,6 +87,12 @@ std::uint32_t MoBBox::longestSide() const
     return dimension;
 }
 
+float MoBBox::surfaceArea() const
+{
+    float3 extent = max - min;
+    return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
 // adapted from Tavian Barnes' "Fast, Branchless Ray/Bounding Box Intersections"
 bool MoBBox::intersect(const MoRay& ray, float &t_near, float &t_far) const
 {
@@ -61,7 +114,7 @@ bool MoBBox::intersect(const MoRay& ray, float &t_near, float &t_far) const
     t_near = std::max(t_near, std::min(tz1, tz2));
     t_far = std::min(t_far, std::max(tz1, tz2));
 
-    return t_far >= t_near;
+    return t_far * MO_BVH_SLAB_SCALE >= t_near;
 }
 
 void MoBBox::expandToInclude(const float3& point)
@@ -136,9 +189,205 @@ bool moRayTriangleIntersect(const MoRay &ray, const MoTriangle &triangle,
     return false;
 }
 
-bool moIntersectBVH(MoBVH bvh, const MoRay& ray, MoIntersectResult& intersection, bool backfaceCulling)
+// ray against the unit triangle after moving both into its space, adapted from Sven Woop's "A Ray Tracing Hardware Architecture for Dynamic Scenes"
+bool moRayTriangleIntersect(const MoRay& ray, const MoTriangleTransform& transform,
+                            float &t, float &u, float &v, bool backfaceCulling)
+{
+    const float EPSILON = 0.0000001f;
+    const float4& m0 = transform.m0;
+    const float4& m1 = transform.m1;
+    const float4& m2 = transform.m2;
+
+    const float originZ = m2.w + m2.x * ray.origin.x + m2.y * ray.origin.y + m2.z * ray.origin.z;
+    const float directionZ = m2.x * ray.direction.x + m2.y * ray.direction.y + m2.z * ray.direction.z;
+    if (backfaceCulling && directionZ >= 0.f)
+    {
+        return false;
+    }
+
+    t = -originZ / directionZ;
+    if (!(t > EPSILON))
+    {
+        return false;
+    }
+
+    // written so that the NaNs of degenerate and parallel cases fail
+    u = m0.w + m0.x * ray.origin.x + m0.y * ray.origin.y + m0.z * ray.origin.z
+        + t * (m0.x * ray.direction.x + m0.y * ray.direction.y + m0.z * ray.direction.z);
+    if (!(u >= 0.f && u <= 1.f))
+    {
+        return false;
+    }
+
+    v = m1.w + m1.x * ray.origin.x + m1.y * ray.origin.y + m1.z * ray.origin.z
+        + t * (m1.x * ray.direction.x + m1.y * ray.direction.y + m1.z * ray.direction.z);
+    return v >= 0.f && u + v <= 1.f;
+}
+
+// per ray shear of the watertight test
+struct MoRayShear
+{
+    std::uint32_t kx, ky, kz;
+    float3 shear;
+};
+
+static void moInitRayShear(const MoRay& ray, MoRayShear& rayShear)
+{
+    float3 direction = {std::abs(ray.direction.x), std::abs(ray.direction.y), std::abs(ray.direction.z)};
+    rayShear.kz = direction.x > direction.y ? (direction.x > direction.z ? 0 : 2) : (direction.y > direction.z ? 1 : 2);
+    rayShear.kx = (rayShear.kz + 1) % 3;
+    rayShear.ky = (rayShear.kx + 1) % 3;
+    // keep the winding of the triangles
+    if (ray.direction[rayShear.kz] < 0.f)
+    {
+        std::swap(rayShear.kx, rayShear.ky);
+    }
+    rayShear.shear = {ray.direction[rayShear.kx] / ray.direction[rayShear.kz],
+                      ray.direction[rayShear.ky] / ray.direction[rayShear.kz],
+                      1.f / ray.direction[rayShear.kz]};
+}
+
+// adapted from Woop, Benthin and Wald's "Watertight Ray/Triangle Intersection"
+static bool moRayTriangleIntersectWatertight(const MoRay& ray, const MoRayShear& rayShear, const MoTriangle& triangle,
+                                             float &t, float &u, float &v, bool backfaceCulling)
+{
+    const float EPSILON = 0.0000001f;
+    const std::uint32_t kx = rayShear.kx, ky = rayShear.ky, kz = rayShear.kz;
+    const float3& shear = rayShear.shear;
+
+    // vertices relative to the origin, sheared so that the ray runs along z
+    const float3 a = triangle.v0 - ray.origin;
+    const float3 b = triangle.v1 - ray.origin;
+    const float3 c = triangle.v2 - ray.origin;
+    const float ax = a[kx] - shear.x * a[kz];
+    const float ay = a[ky] - shear.y * a[kz];
+    const float bx = b[kx] - shear.x * b[kz];
+    const float by = b[ky] - shear.y * b[kz];
+    const float cx = c[kx] - shear.x * c[kz];
+    const float cy = c[ky] - shear.y * c[kz];
+
+    // scaled barycentric coordinates, exact in double precision along the edges
+    float e0 = cx * by - cy * bx;
+    float e1 = ax * cy - ay * cx;
+    float e2 = bx * ay - by * ax;
+    if (e0 == 0.f || e1 == 0.f || e2 == 0.f)
+    {
+        e0 = float(double(cx) * double(by) - double(cy) * double(bx));
+        e1 = float(double(ax) * double(cy) - double(ay) * double(cx));
+        e2 = float(double(bx) * double(ay) - double(by) * double(ax));
+    }
+
+    if (backfaceCulling ? (e0 < 0.f || e1 < 0.f || e2 < 0.f)
+                        : ((e0 < 0.f || e1 < 0.f || e2 < 0.f) && (e0 > 0.f || e1 > 0.f || e2 > 0.f)))
+    {
+        return false;
+    }
+    const float determinant = e0 + e1 + e2;
+    if (determinant == 0.f)
+    {
+        return false;
+    }
+
+    const float distance = shear.z * (e0 * a[kz] + e1 * b[kz] + e2 * c[kz]);
+    const float oneOverDeterminant = 1.f / determinant;
+    t = distance * oneOverDeterminant;
+    if (!(t > EPSILON))
+    {
+        return false;
+    }
+    u = e1 * oneOverDeterminant;
+    v = e2 * oneOverDeterminant;
+    return true;
+}
+
+bool moRayTriangleIntersectWatertight(const MoRay& ray, const MoTriangle& triangle, float &t, float &u, float &v, bool backfaceCulling)
+{
+    MoRayShear rayShear;
+    moInitRayShear(ray, rayShear);
+    return moRayTriangleIntersectWatertight(ray, rayShear, triangle, t, u, v, backfaceCulling);
+}
+
+static MoTriangleTransform moComputeTriangleTransform(const MoTriangle& triangle)
+{
+    MoTriangleTransform transform = {};
+    const float3 edge1 = triangle.v1 - triangle.v0;
+    const float3 edge2 = triangle.v2 - triangle.v0;
+    const float3 normal = cross(edge1, edge2);
+    const float determinant = dot(normal, normal);
+    if (determinant == 0.f)
+    {
+        // degenerate, every test divides 0 by 0
+        return transform;
+    }
+
+    const float3 row0 = cross(edge2, normal) / determinant;
+    const float3 row1 = cross(normal, edge1) / determinant;
+    const float3 row2 = normal / determinant;
+    transform.m0 = float4(row0, -dot(row0, triangle.v0));
+    transform.m1 = float4(row1, -dot(row1, triangle.v0));
+    transform.m2 = float4(row2, -dot(row2, triangle.v0));
+    return transform;
+}
+
+MoTriangle moGetBVHTriangle(MoBVH bvh, std::uint32_t index)
+{
+    if (bvh->pTriangles)
+    {
+        return bvh->pTriangles[index];
+    }
+    const std::uint32_t* face = &bvh->pTriangleIndices[index*3];
+    MoTriangle triangle;
+    triangle.v0 = bvh->pVertices[face[0]];
+    triangle.v1 = bvh->pVertices[face[1]];
+    triangle.v2 = bvh->pVertices[face[2]];
+    return triangle;
+}
+
+// MoIntersectResult, MoSweepResult or MoContact
+template<typename Result>
+static void moSetIntersectTriangle(MoBVH bvh, std::uint32_t index, Result& intersection)
+{
+    intersection.pTriangle = bvh->pTriangles ? &bvh->pTriangles[index] : nullptr;
+    intersection.triangleIndex = index;
+    intersection.sourceTriangleIndex = bvh->pSourceTriangles[index];
+}
+
+// per ray state of the triangle test selected by the BVH's triangle format
+struct MoTriangleTest
+{
+    MoBVH        bvh;
+    const MoRay* pRay;
+    MoRayShear   rayShear;
+    bool         backfaceCulling;
+};
+
+static void moInitTriangleTest(MoTriangleTest& test, MoBVH bvh, const MoRay& ray, bool backfaceCulling)
+{
+    test.bvh = bvh;
+    test.pRay = &ray;
+    test.backfaceCulling = backfaceCulling;
+    if (bvh->triangleFormat == MO_BVH_TRIANGLE_FORMAT_WATERTIGHT)
+    {
+        moInitRayShear(ray, test.rayShear);
+    }
+}
+
+static bool moIntersectTriangle(const MoTriangleTest& test, std::uint32_t index, float &t, float &u, float &v)
+{
+    switch (test.bvh->triangleFormat)
+    {
+    case MO_BVH_TRIANGLE_FORMAT_WATERTIGHT:
+        return moRayTriangleIntersectWatertight(*test.pRay, test.rayShear, moGetBVHTriangle(test.bvh, index), t, u, v, test.backfaceCulling);
+    case MO_BVH_TRIANGLE_FORMAT_TRANSFORM:
+        return moRayTriangleIntersect(*test.pRay, test.bvh->pTriangleTransforms[index], t, u, v, test.backfaceCulling);
+    default:
+        return moRayTriangleIntersect(*test.pRay, moGetBVHTriangle(test.bvh, index), t, u, v, test.backfaceCulling);
+    }
+}
+
+// closest hit below root, intersection.distance must hold the farthest distance of interest
+static void moIntersectSubtree(MoBVH bvh, std::uint32_t root, const MoRay& ray, MoIntersectResult& intersection, bool backfaceCulling)
 {
-    intersection.distance = std::numeric_limits<float>::max();
     float bbhits[4];
     std::uint32_t closer, other;
 
@@ -148,12 +397,15 @@ bool moIntersectBVH(MoBVH bvh, const MoRay& ray, MoIntersectResult& intersection
         std::uint32_t index;
         float distance;
     };
-    Traversal traversal[64];
+    Traversal traversal[MO_BVH_STACK_SIZE];
     std::int32_t stackPtr = 0;
 
-    traversal[stackPtr].index = 0;
+    traversal[stackPtr].index = root;
     traversal[stackPtr].distance = std::numeric_limits<float>::lowest();
 
+    MoTriangleTest test;
+    moInitTriangleTest(test, bvh, ray, backfaceCulling);
+
     while (stackPtr >= 0)
     {
         std::uint32_t index = traversal[stackPtr].index;
@@ -165,28 +417,29 @@ bool moIntersectBVH(MoBVH bvh, const MoRay& ray, MoIntersectResult& intersection
         {
             continue;
         }
+        MO_BVH_COUNT(nodesVisited, 1);
 
         if (node.offset == 0)
         {
-            float t, u, v;
-            const MoTriangle& triangle = bvh->pTriangles[node.start];
-            if (moRayTriangleIntersect(ray, triangle, t, u, v, backfaceCulling))
+            for (std::uint32_t i = node.start; i < node.start + node.count; ++i)
             {
-                if (t <= 0.0)
-                {
-                    intersection.pTriangle = &triangle;
-                    return true;
-                }
-                if (t < intersection.distance)
+                MO_BVH_COUNT(triangleTests, 1);
+                float t, u, v;
+                if (moIntersectTriangle(test, i, t, u, v))
                 {
-                    intersection.pTriangle = &triangle;
-                    intersection.barycentric = {1.f - u - v, u, v};
-                    intersection.distance = t;
+                    if (t < intersection.distance)
+                    {
+                        moSetIntersectTriangle(bvh, i, intersection);
+                        intersection.barycentric = {1.f - u - v, u, v};
+                        intersection.distance = t;
+                    }
                 }
             }
         }
         else
         {
+            MO_BVH_COUNT(boxTests, 2);
+            MO_BVH_CHECK_STACK(traversal, stackPtr, 2);
             bool hitLeft =  bvh->pSplitNodes[index + 1].boundingBox.intersect(ray, bbhits[0], bbhits[1]);
             bool hitRight = bvh->pSplitNodes[index + node.offset].boundingBox.intersect(ray, bbhits[2], bbhits[3]);
 
@@ -217,157 +470,4090 @@ bool moIntersectBVH(MoBVH bvh, const MoRay& ray, MoIntersectResult& intersection
                 ++stackPtr;
                 traversal[stackPtr] = Traversal{index + node.offset, bbhits[2]};
             }
+            MO_BVH_COUNT_STACK(stackPtr);
         }
     }
-
-    return intersection.distance < std::numeric_limits<float>::max();
 }
 
-void moCreateBVH(MoMesh mesh, MoBVH *pBVH)
+// the same arithmetic builds and traverses the quantized nodes so that their bounds stay conservative
+template<typename T>
+static MoBBox moDequantize(const MoBVHQuantizedNode<T>& node, const MoBBox& parent)
 {
-    MoBVH bvh = *pBVH = new MoBVH_T();
-    *bvh = {};
+    const float maxQuantized = float(std::numeric_limits<T>::max());
+    const float3 step = (parent.max - parent.min) * (1.f / maxQuantized);
 
-    carray_resize(&bvh->pTriangles, &bvh->triangleCount, mesh->indexCount / 3);
-    for (std::uint32_t faceIdx = 0; faceIdx < mesh->indexCount / 3; ++faceIdx)
+    MoBBox boundingBox;
+    for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
     {
-        const auto* face = &mesh->pIndices[faceIdx*3];
-        MoTriangle& triangle = const_cast<MoTriangle&>(bvh->pTriangles[faceIdx]);
-        triangle.v0 = mesh->pVertices[face[0]];
-        triangle.v1 = mesh->pVertices[face[1]];
-        triangle.v2 = mesh->pVertices[face[2]];
+        boundingBox.min[dimension] = parent.min[dimension] + float(node.min[dimension]) * step[dimension];
+        boundingBox.max[dimension] = parent.max[dimension] - float(maxQuantized - node.max[dimension]) * step[dimension];
     }
+    return boundingBox;
+}
 
-    enum : std::uint32_t
-    {
-        Node_Untouched    = 0xffffffff,
-        Node_TouchedTwice = 0xfffffffd,
-        Node_Root         = 0xfffffffc,
-    };
-
-    std::uint32_t currentSize = 0;
-    const std::uint32_t* indices = nullptr;
-    carray_resize(&indices, &currentSize, bvh->triangleCount);
-    for (std::uint32_t i = 0; i < currentSize; ++i)
-        const_cast<std::uint32_t*>(indices)[i] = i;
-
-    bvh->splitNodeCount = 0;
-    std::uint32_t stackPtr = 0;
+// closest hit traversal of the quantized nodes, every node's bounds are dequantized from its parent's
+template<typename T>
+static void moIntersectQuantized(MoBVH bvh, const MoBVHQuantizedNode<T>* pNodes, const MoRay& ray, MoIntersectResult& intersection, bool backfaceCulling)
+{
+    float bbhits[4];
 
-    struct Entry
+    // Working set
+    struct Traversal
     {
-        std::uint32_t parent;
-        std::uint32_t start;
-        std::uint32_t end;
+        std::uint32_t index;
+        float distance;
+        MoBBox boundingBox;
     };
-    Entry* entries = {};
-    std::uint32_t entryCount = 0;
-    carray_resize(&entries, &entryCount, 1);
-    entries[stackPtr].start = 0;
-    entries[stackPtr].end = currentSize;
-    entries[stackPtr].parent = Node_Root;
-    stackPtr++;
+    Traversal traversal[MO_BVH_STACK_SIZE];
+    std::int32_t stackPtr = 0;
 
-    std::uint32_t splitNodeCount = 0;
+    traversal[stackPtr].index = 0;
+    traversal[stackPtr].distance = std::numeric_limits<float>::lowest();
+    traversal[stackPtr].boundingBox = moDequantize(pNodes[0], bvh->pSplitNodes[0].boundingBox);
 
-    MoBVHSplitNode splitNode;
-    while (stackPtr > 0)
-    {
-        Entry &entry = entries[--stackPtr];
-        std::uint32_t start = entry.start;
-        std::uint32_t end = entry.end;
-        std::uint32_t count = end - start;
+    MoTriangleTest test;
+    moInitTriangleTest(test, bvh, ray, backfaceCulling);
 
-        splitNodeCount++;
-        splitNode.start = start;
-        splitNode.offset = Node_Untouched;
+    while (stackPtr >= 0)
+    {
+        std::uint32_t index = traversal[stackPtr].index;
+        float near = traversal[stackPtr].distance;
+        MoBBox boundingBox = traversal[stackPtr].boundingBox;
+        stackPtr--;
+        const MoBVHQuantizedNode<T>& node = pNodes[index];
 
-        MoBBox boundingBox = bvh->pTriangles[indices[start]].getBoundingBox();
-        MoBBox boundingBoxCentroids = bvh->pTriangles[indices[start]].getCentroid();
-        for (std::uint32_t i = start + 1; i < end; ++i)
+        if (near > intersection.distance)
         {
-            boundingBox.expandToInclude(bvh->pTriangles[indices[i]].getBoundingBox());
-            boundingBoxCentroids.expandToInclude(bvh->pTriangles[indices[i]].getCentroid());
+            continue;
         }
-        splitNode.boundingBox = boundingBox;
+        MO_BVH_COUNT(nodesVisited, 1);
 
-        // we're at the leaf
-        if (count <= 1)
+        if (node.count != 0)
         {
-            splitNode.offset = 0;
+            for (std::uint32_t i = node.index; i < node.index + node.count; ++i)
+            {
+                MO_BVH_COUNT(triangleTests, 1);
+                float t, u, v;
+                if (moIntersectTriangle(test, i, t, u, v) && t < intersection.distance)
+                {
+                    moSetIntersectTriangle(bvh, i, intersection);
+                    intersection.barycentric = {1.f - u - v, u, v};
+                    intersection.distance = t;
+                }
+            }
         }
-
-        carray_push_back(&bvh->pSplitNodes, &bvh->splitNodeCount, splitNode);
-        if (entry.parent != Node_Root)
+        else
         {
-            MoBVHSplitNode & splitNode = const_cast<MoBVHSplitNode*>(bvh->pSplitNodes)[entry.parent];
-            splitNode.offset--;
-            if (splitNode.offset == Node_TouchedTwice)
+            MO_BVH_COUNT(boxTests, 2);
+            MO_BVH_CHECK_STACK(traversal, stackPtr, 2);
+            Traversal left = {index + 1, 0.f, moDequantize(pNodes[index + 1], boundingBox)};
+            Traversal right = {index + node.index, 0.f, moDequantize(pNodes[index + node.index], boundingBox)};
+            bool hitLeft = left.boundingBox.intersect(ray, bbhits[0], bbhits[1]);
+            bool hitRight = right.boundingBox.intersect(ray, bbhits[2], bbhits[3]);
+            left.distance = bbhits[0];
+            right.distance = bbhits[2];
+
+            if (hitLeft && hitRight)
             {
-                splitNode.offset = splitNodeCount - 1 - entry.parent;
+                if (right.distance < left.distance)
+                {
+                    std::swap(left, right);
+                }
+                traversal[++stackPtr] = right;
+                traversal[++stackPtr] = left;
+            }
+            else if (hitLeft)
+            {
+                traversal[++stackPtr] = left;
+            }
+            else if (hitRight)
+            {
+                traversal[++stackPtr] = right;
             }
+            MO_BVH_COUNT_STACK(stackPtr);
         }
+    }
+}
 
-        if (splitNode.offset == 0)
+// closest hit nearer than intersection.distance, in the node format the BVH was built with
+static void moIntersectNodes(MoBVH bvh, const MoRay& ray, MoIntersectResult& intersection, bool backfaceCulling)
+{
+    if (bvh->splitNodeCount == 0)
+    {
+        return;
+    }
+
+    if (bvh->pQuantizedNodes16)
+    {
+        moIntersectQuantized(bvh, bvh->pQuantizedNodes16, ray, intersection, backfaceCulling);
+    }
+    else if (bvh->pQuantizedNodes8)
+    {
+        moIntersectQuantized(bvh, bvh->pQuantizedNodes8, ray, intersection, backfaceCulling);
+    }
+    else
+    {
+        moIntersectSubtree(bvh, 0, ray, intersection, backfaceCulling);
+    }
+}
+
+bool moIntersectBVH(MoBVH bvh, const MoRay& ray, MoIntersectResult& intersection, bool backfaceCulling)
+{
+    MO_BVH_COUNT(queryCount, 1);
+    intersection.distance = std::numeric_limits<float>::max();
+    moIntersectNodes(bvh, ray, intersection, backfaceCulling);
+    return intersection.distance < std::numeric_limits<float>::max();
+}
+
+bool moOccludedBVH(MoBVH bvh, const MoRay& ray, float tMax, float tMin, bool backfaceCulling)
+{
+    if (bvh->splitNodeCount == 0)
+    {
+        return false;
+    }
+
+    // Working set
+    std::uint32_t traversal[MO_BVH_STACK_SIZE];
+    std::int32_t stackPtr = 0;
+
+    traversal[stackPtr] = 0;
+
+    MoTriangleTest test;
+    moInitTriangleTest(test, bvh, ray, backfaceCulling);
+
+    while (stackPtr >= 0)
+    {
+        std::uint32_t index = traversal[stackPtr];
+        stackPtr--;
+        const MoBVHSplitNode& node = bvh->pSplitNodes[index];
+
+        float near, far;
+        if (!node.boundingBox.intersect(ray, near, far) || far < tMin || near > tMax)
         {
             continue;
         }
 
-        // find longest bbox side
-        std::uint32_t splitDimension = boundingBoxCentroids.longestSide();
-        float splitLength = .5f * (boundingBoxCentroids.min[splitDimension] + boundingBoxCentroids.max[splitDimension]);
-
-        std::uint32_t mid = start;
-        for (std::uint32_t i = start; i < end; ++i)
+        if (node.offset == 0)
         {
-            if (bvh->pTriangles[indices[i]].getCentroid()[splitDimension] < splitLength)
+            for (std::uint32_t i = node.start; i < node.start + node.count; ++i)
             {
-                std::uint32_t* lObjects = const_cast<std::uint32_t*>(indices);
-                std::swap(lObjects[i], lObjects[mid]);
-                ++mid;
+                float t, u, v;
+                if (moIntersectTriangle(test, i, t, u, v) && t >= tMin && t <= tMax)
+                {
+                    return true;
+                }
             }
         }
-
-        if (mid == start || mid == end)
+        else
         {
-            mid = start + (end-start) / 2;
+            MO_BVH_CHECK_STACK(traversal, stackPtr, 2);
+            ++stackPtr;
+            traversal[stackPtr] = index + node.offset;
+            ++stackPtr;
+            traversal[stackPtr] = index + 1;
         }
+    }
 
-        // left
-        if (entryCount <= stackPtr)
-            carray_push_back(&entries, &entryCount, {});
-        entries[stackPtr].start = mid;
-        entries[stackPtr].end = end;
-        entries[stackPtr].parent = splitNodeCount - 1;
-        stackPtr++;
+    return false;
+}
 
-        // right
-        if (entryCount <= stackPtr)
-            carray_push_back(&entries, &entryCount, {});
-        entries[stackPtr].start = start;
-        entries[stackPtr].end = mid;
-        entries[stackPtr].parent = splitNodeCount - 1;
-        stackPtr++;
-    }
+MoBVHTraversalStats moGetBVHTraversalStats()
+{
+#ifdef MO_BVH_TRAVERSAL_STATS
+    return moTraversalStats;
+#else
+    return MoBVHTraversalStats{};
+#endif
+}
+
+void moResetBVHTraversalStats()
+{
+#ifdef MO_BVH_TRAVERSAL_STATS
+    moTraversalStats = MoBVHTraversalStats{};
+#endif
+}
+
+void moAccumulateBVHTraversalStats(const MoBVHTraversalStats& stats, MoBVHTraversalStats* pTotal)
+{
+    pTotal->queryCount += stats.queryCount;
+    pTotal->nodesVisited += stats.nodesVisited;
+    pTotal->boxTests += stats.boxTests;
+    pTotal->triangleTests += stats.triangleTests;
+    pTotal->stackHighWater = std::max(pTotal->stackHighWater, stats.stackHighWater);
+}
 
-    for (std::uint32_t i = 0; i < splitNodeCount; ++i)
+// slab test of one box against every ray in mask, returns a bit per ray entering it before its closest hit
+static std::uint32_t moIntersectPacket(const MoBBox& box, const float (*origin)[MO_RAY_PACKET_MAX_SIZE], const float (*oneOverDirection)[MO_RAY_PACKET_MAX_SIZE], const float* distance, std::uint32_t mask)
+{
+    std::uint32_t hits = 0;
+#if defined(MO_BVH_SSE)
+    for (std::uint32_t lane = 0; lane < MO_RAY_PACKET_MAX_SIZE; lane += 4)
+    {
+        if (((mask >> lane) & 0xf) == 0)
+        {
+            continue;
+        }
+        __m128 nearest = _mm_setzero_ps();
+        __m128 farther = _mm_loadu_ps(&distance[lane]);
+        for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+        {
+            const __m128 o = _mm_loadu_ps(&origin[dimension][lane]);
+            const __m128 d = _mm_loadu_ps(&oneOverDirection[dimension][lane]);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.min[dimension]), o), d);
+            __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(box.max[dimension]), o), d);
+            nearest = _mm_max_ps(nearest, _mm_min_ps(t1, t2));
+            farther = _mm_min_ps(farther, _mm_max_ps(t1, t2));
+        }
+        hits |= std::uint32_t(_mm_movemask_ps(_mm_cmple_ps(nearest, _mm_mul_ps(farther, _mm_set1_ps(MO_BVH_SLAB_SCALE))))) << lane;
+    }
+#else
+    for (std::uint32_t lane = 0; lane < MO_RAY_PACKET_MAX_SIZE; ++lane)
     {
-        MoBVHSplitNode& splitNode = const_cast<MoBVHSplitNode&>(bvh->pSplitNodes[i]);
-        splitNode.start = splitNode.offset == 0 ? indices[splitNode.start] : 0;
+        if ((mask & (1u << lane)) == 0)
+        {
+            continue;
+        }
+        float nearest = 0.f;
+        float farther = distance[lane];
+        for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+        {
+            float t1 = (box.min[dimension] - origin[dimension][lane]) * oneOverDirection[dimension][lane];
+            float t2 = (box.max[dimension] - origin[dimension][lane]) * oneOverDirection[dimension][lane];
+            nearest = std::max(nearest, std::min(t1, t2));
+            farther = std::min(farther, std::max(t1, t2));
+        }
+        hits |= std::uint32_t(nearest <= farther * MO_BVH_SLAB_SCALE) << lane;
     }
+#endif
+    return hits & mask;
+}
 
-    carray_resize(&bvh->pSplitNodes, &bvh->splitNodeCount, splitNodeCount);
-    carray_free(entries, &entryCount);
-    carray_free(indices, &currentSize);
+static std::uint32_t moBitCount(std::uint32_t mask)
+{
+    std::uint32_t count = 0;
+    for (; mask != 0; mask &= mask - 1)
+    {
+        ++count;
+    }
+    return count;
 }
 
-void moDestroyBVH(MoBVH bvh)
+std::uint32_t moIntersectBVHPacket(MoBVH bvh, const MoRayPacket& packet, MoIntersectResult* pIntersections, bool backfaceCulling)
 {
+    std::uint32_t rayCount = std::min<std::uint32_t>(packet.rayCount, MO_RAY_PACKET_MAX_SIZE);
+    std::uint32_t active = packet.activeMask & (rayCount == MO_RAY_PACKET_MAX_SIZE ? ~0u : (1u << rayCount) - 1);
+
+    MoRay rays[MO_RAY_PACKET_MAX_SIZE];
+    MoTriangleTest tests[MO_RAY_PACKET_MAX_SIZE];
+    float origin[3][MO_RAY_PACKET_MAX_SIZE] = {};
+    float oneOverDirection[3][MO_RAY_PACKET_MAX_SIZE] = {};
+    float distance[MO_RAY_PACKET_MAX_SIZE];
+    for (std::uint32_t ray = 0; ray < MO_RAY_PACKET_MAX_SIZE; ++ray)
+    {
+        distance[ray] = std::numeric_limits<float>::max();
+        if (ray < rayCount)
+        {
+            pIntersections[ray].distance = std::numeric_limits<float>::max();
+        }
+        if ((active & (1u << ray)) == 0)
+        {
+            continue;
+        }
+        rays[ray] = MoRay({packet.originX[ray], packet.originY[ray], packet.originZ[ray]},
+                          {packet.directionX[ray], packet.directionY[ray], packet.directionZ[ray]});
+        moInitTriangleTest(tests[ray], bvh, rays[ray], backfaceCulling);
+        for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+        {
+            origin[dimension][ray] = rays[ray].origin[dimension];
+            oneOverDirection[dimension][ray] = rays[ray].oneOverDirection[dimension];
+        }
+    }
+    if (bvh->splitNodeCount == 0 || active == 0)
+    {
+        return 0;
+    }
+
+    // below this many rays the packet is no longer coherent enough to share node fetches
+    const std::uint32_t minimumRayCount = std::max<std::uint32_t>(2, moBitCount(active) / 4);
+
+    // Working set
+    struct Traversal
+    {
+        std::uint32_t index;
+        std::uint32_t mask;
+    };
+    Traversal traversal[MO_BVH_STACK_SIZE];
+    std::int32_t stackPtr = 0;
+
+    traversal[stackPtr].index = 0;
+    traversal[stackPtr].mask = active;
+
+    while (stackPtr >= 0)
+    {
+        std::uint32_t index = traversal[stackPtr].index;
+        std::uint32_t mask = traversal[stackPtr].mask;
+        stackPtr--;
+        const MoBVHSplitNode& node = bvh->pSplitNodes[index];
+
+        mask = moIntersectPacket(node.boundingBox, origin, oneOverDirection, distance, mask);
+        if (mask == 0)
+        {
+            continue;
+        }
+
+        if (moBitCount(mask) < minimumRayCount)
+        {
+            for (std::uint32_t ray = 0; ray < MO_RAY_PACKET_MAX_SIZE; ++ray)
+            {
+                if (mask & (1u << ray))
+                {
+                    pIntersections[ray].distance = distance[ray];
+                    moIntersectSubtree(bvh, index, rays[ray], pIntersections[ray], backfaceCulling);
+                    distance[ray] = pIntersections[ray].distance;
+                }
+            }
+        }
+        else if (node.offset == 0)
+        {
+            for (std::uint32_t i = node.start; i < node.start + node.count; ++i)
+            {
+                for (std::uint32_t ray = 0; ray < MO_RAY_PACKET_MAX_SIZE; ++ray)
+                {
+                    float t, u, v;
+                    if ((mask & (1u << ray)) && moIntersectTriangle(tests[ray], i, t, u, v) && t < distance[ray])
+                    {
+                        moSetIntersectTriangle(bvh, i, pIntersections[ray]);
+                        pIntersections[ray].barycentric = {1.f - u - v, u, v};
+                        pIntersections[ray].distance = distance[ray] = t;
+                    }
+                }
+            }
+        }
+        else
+        {
+            // the packet visits the child closer to the origin of its first ray along its direction first
+            std::uint32_t closer = index + 1;
+            std::uint32_t other = index + node.offset;
+            std::uint32_t first = 0;
+            while ((mask & (1u << first)) == 0)
+            {
+                ++first;
+            }
+            const MoBBox& left = bvh->pSplitNodes[closer].boundingBox;
+            const MoBBox& right = bvh->pSplitNodes[other].boundingBox;
+            if (dot((right.min + right.max) - (left.min + left.max), rays[first].direction) < 0.f)
+            {
+                std::swap(closer, other);
+            }
+
+            MO_BVH_CHECK_STACK(traversal, stackPtr, 2);
+            ++stackPtr;
+            traversal[stackPtr] = Traversal{other, mask};
+            ++stackPtr;
+            traversal[stackPtr] = Traversal{closer, mask};
+        }
+    }
+
+    std::uint32_t hits = 0;
+    for (std::uint32_t ray = 0; ray < rayCount; ++ray)
+    {
+        hits |= std::uint32_t(distance[ray] < std::numeric_limits<float>::max()) << ray;
+    }
+    return hits;
+}
+
+static bool moEqual(const float3& a, const float3& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// recompute every node's bounds from the triangles, children always follow their parent in the array
+// returns the range of nodes whose bounds changed in first and count
+static void moRefitSplitNodes(MoBVH bvh, std::uint32_t& first, std::uint32_t& count)
+{
+    std::uint32_t last = 0;
+    first = bvh->splitNodeCount;
+    MoBVHSplitNode* pSplitNodes = const_cast<MoBVHSplitNode*>(bvh->pSplitNodes);
+    for (std::uint32_t index = bvh->splitNodeCount; index-- > 0;)
+    {
+        MoBVHSplitNode& node = pSplitNodes[index];
+        MoBBox boundingBox;
+        if (node.offset == 0)
+        {
+            boundingBox = moGetBVHTriangle(bvh, node.start).getBoundingBox();
+            for (std::uint32_t i = node.start + 1; i < node.start + node.count; ++i)
+            {
+                boundingBox.expandToInclude(moGetBVHTriangle(bvh, i).getBoundingBox());
+            }
+        }
+        else
+        {
+            boundingBox = pSplitNodes[index + 1].boundingBox;
+            boundingBox.expandToInclude(pSplitNodes[index + node.offset].boundingBox);
+        }
+
+        if (!moEqual(boundingBox.min, node.boundingBox.min) || !moEqual(boundingBox.max, node.boundingBox.max))
+        {
+            node.boundingBox = boundingBox;
+            first = index;
+            last = std::max(last, index);
+        }
+    }
+    count = first < bvh->splitNodeCount ? last - first + 1 : 0;
+    first = count > 0 ? first : 0;
+}
+
+// lay the nodes out depth first again with the child of larger surface area next to its parent, the one a ray most likely enters,
+// and move the triangles to the new leaf order so that the nodes and the triangles of every subtree stay contiguous
+static void moReorderSplitNodes(MoBVH bvh)
+{
+    if (bvh->splitNodeCount == 0)
+    {
+        return;
+    }
+
+    const MoBVHSplitNode* pSplitNodes = nullptr;
+    std::uint32_t splitNodeCount = 0;
+    carray_resize(&pSplitNodes, &splitNodeCount, bvh->splitNodeCount);
+    MoBVHSplitNode* pReordered = const_cast<MoBVHSplitNode*>(pSplitNodes);
+
+    // previous index of the triangle at every new index
+    std::vector<std::uint32_t> order;
+    order.reserve(bvh->triangleCount);
+
+    struct Entry
+    {
+        std::uint32_t index;
+        // new index of the parent whose offset points here, the first child needs none
+        std::uint32_t parent;
+    };
+    std::vector<Entry> entries = {{0, ~0u}};
+    std::uint32_t reorderedCount = 0;
+    while (!entries.empty())
+    {
+        const Entry entry = entries.back();
+        entries.pop_back();
+
+        const MoBVHSplitNode& node = bvh->pSplitNodes[entry.index];
+        MoBVHSplitNode& reordered = pReordered[reorderedCount];
+        reordered = node;
+        if (entry.parent != ~0u)
+        {
+            pReordered[entry.parent].offset = reorderedCount - entry.parent;
+        }
+
+        if (node.offset == 0)
+        {
+            reordered.start = std::uint32_t(order.size());
+            for (std::uint32_t i = node.start; i < node.start + node.count; ++i)
+            {
+                order.push_back(i);
+            }
+        }
+        else
+        {
+            std::uint32_t first = entry.index + 1;
+            std::uint32_t second = entry.index + node.offset;
+            if (bvh->pSplitNodes[second].boundingBox.surfaceArea() > bvh->pSplitNodes[first].boundingBox.surfaceArea())
+            {
+                std::swap(first, second);
+            }
+            entries.push_back({second, reorderedCount});
+            entries.push_back({first, ~0u});
+        }
+        ++reorderedCount;
+    }
+
+    std::uint32_t previousCount = bvh->splitNodeCount;
+    carray_free(bvh->pSplitNodes, &previousCount);
+    bvh->pSplitNodes = pSplitNodes;
+
+    // the triangles follow, INDEXED storage permutes the mesh's indices in place
+    const std::uint32_t triangleCount = std::uint32_t(order.size());
+    if (bvh->pTriangles)
+    {
+        std::vector<MoTriangle> triangles(bvh->pTriangles, bvh->pTriangles + triangleCount);
+        for (std::uint32_t i = 0; i < triangleCount; ++i)
+        {
+            const_cast<MoTriangle&>(bvh->pTriangles[i]) = triangles[order[i]];
+        }
+    }
+    if (bvh->pTriangleTransforms)
+    {
+        std::vector<MoTriangleTransform> transforms(bvh->pTriangleTransforms, bvh->pTriangleTransforms + triangleCount);
+        for (std::uint32_t i = 0; i < triangleCount; ++i)
+        {
+            const_cast<MoTriangleTransform&>(bvh->pTriangleTransforms[i]) = transforms[order[i]];
+        }
+    }
+    const std::vector<std::uint32_t> indices(bvh->pTriangleIndices, bvh->pTriangleIndices + triangleCount * 3);
+    const std::vector<std::uint32_t> sourceTriangles(bvh->pSourceTriangles, bvh->pSourceTriangles + triangleCount);
+    for (std::uint32_t i = 0; i < triangleCount; ++i)
+    {
+        carray_copy(bvh->pTriangleIndices + i * 3, &indices[order[i] * 3], 3);
+        const_cast<std::uint32_t&>(bvh->pSourceTriangles[i]) = sourceTriangles[order[i]];
+    }
+}
+
+// smallest quantized bounds whose dequantization still contains boundingBox
+template<typename T>
+static void moQuantize(const MoBBox& boundingBox, const MoBBox& parent, MoBVHQuantizedNode<T>& node)
+{
+    const std::uint32_t maxQuantized = std::numeric_limits<T>::max();
+    const float3 step = (parent.max - parent.min) * (1.f / float(maxQuantized));
+    for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+    {
+        std::int64_t min = 0;
+        std::int64_t max = maxQuantized;
+        if (step[dimension] > 0.f)
+        {
+            min = std::int64_t(std::floor((boundingBox.min[dimension] - parent.min[dimension]) / step[dimension]));
+            max = maxQuantized - std::int64_t(std::floor((parent.max[dimension] - boundingBox.max[dimension]) / step[dimension]));
+            min = std::min<std::int64_t>(std::max<std::int64_t>(min, 0), maxQuantized);
+            max = std::min<std::int64_t>(std::max<std::int64_t>(max, 0), maxQuantized);
+        }
+        node.min[dimension] = T(min);
+        node.max[dimension] = T(max);
+        // step outwards until rounding of the dequantization is accounted for
+        while (node.min[dimension] > 0 && moDequantize(node, parent).min[dimension] > boundingBox.min[dimension])
+        {
+            --node.min[dimension];
+        }
+        while (node.max[dimension] < maxQuantized && moDequantize(node, parent).max[dimension] < boundingBox.max[dimension])
+        {
+            ++node.max[dimension];
+        }
+    }
+}
+
+// encode every node inside its parent's dequantized bounds, returns the range of nodes whose encoding changed
+template<typename T>
+static void moQuantizeSplitNodes(MoBVH bvh, const MoBVHQuantizedNode<T>** ppNodes, std::uint32_t& first, std::uint32_t& count)
+{
+    if (*ppNodes == nullptr)
+    {
+        carray_resize(ppNodes, &bvh->quantizedNodeCount, bvh->splitNodeCount);
+        memset(const_cast<MoBVHQuantizedNode<T>*>(*ppNodes), 0xff, bvh->splitNodeCount * sizeof(MoBVHQuantizedNode<T>));
+    }
+    MoBVHQuantizedNode<T>* pNodes = const_cast<MoBVHQuantizedNode<T>*>(*ppNodes);
+
+    std::vector<MoBBox> boundingBoxes(bvh->splitNodeCount);
+    std::vector<std::uint32_t> parents(bvh->splitNodeCount, 0);
+    std::uint32_t last = 0;
+    first = bvh->splitNodeCount;
+    for (std::uint32_t index = 0; index < bvh->splitNodeCount; ++index)
+    {
+        const MoBVHSplitNode& splitNode = bvh->pSplitNodes[index];
+        const MoBBox& parent = index == 0 ? bvh->pSplitNodes[0].boundingBox : boundingBoxes[parents[index]];
+
+        // cleared padding so that unchanged nodes compare equal
+        MoBVHQuantizedNode<T> node;
+        memset(&node, 0, sizeof(node));
+        moQuantize(splitNode.boundingBox, parent, node);
+        node.index = splitNode.offset == 0 ? splitNode.start : splitNode.offset;
+        node.count = splitNode.offset == 0 ? splitNode.count : 0;
+        boundingBoxes[index] = moDequantize(node, parent);
+        if (splitNode.offset != 0)
+        {
+            parents[index + 1] = index;
+            parents[index + splitNode.offset] = index;
+        }
+
+        if (memcmp(&pNodes[index], &node, sizeof(node)) != 0)
+        {
+            pNodes[index] = node;
+            first = std::min(first, index);
+            last = index;
+        }
+    }
+    count = first < bvh->splitNodeCount ? last - first + 1 : 0;
+    first = count > 0 ? first : 0;
+}
+
+static void moQuantizeSplitNodes(MoBVH bvh, std::uint32_t& first, std::uint32_t& count)
+{
+    first = count = 0;
+    if (bvh->nodeFormat == MO_BVH_NODE_FORMAT_QUANTIZED_16)
+    {
+        moQuantizeSplitNodes(bvh, &bvh->pQuantizedNodes16, first, count);
+    }
+    else if (bvh->nodeFormat == MO_BVH_NODE_FORMAT_QUANTIZED_8)
+    {
+        moQuantizeSplitNodes(bvh, &bvh->pQuantizedNodes8, first, count);
+    }
+}
+
+// ranges at least this large are bounded, binned and partitioned by every available thread
+#define MO_BVH_PARALLEL_PASS_SIZE 65536
+// ranges smaller than this are built by a single thread
+#define MO_BVH_PARALLEL_TASK_SIZE 4096
+
+struct MoBVHBuilder
+{
+    MoBVHCreateInfo createInfo;
+    const MoBBox*   pBoxes;
+    const float3*   pCentroids;
+    std::uint32_t*  pIndices;
+    // destination of the parallel partition pass and of the radix sort, as large as pIndices
+    std::uint32_t*  pScratch;
+    // MO_BVH_BUILD_MODE_LBVH only, sorted along with pIndices
+    std::uint64_t*  pMortonCodes;
+};
+
+struct MoBVHBin
+{
+    MoBBox        boundingBox;
+    std::uint32_t count;
+};
+
+// split [0, count) in up to threadCount chunks and run function(begin, end, chunk) on each, the first chunk on the calling thread
+template<typename Function>
+static void moParallelFor(std::uint32_t threadCount, std::uint32_t count, const Function& function)
+{
+    threadCount = std::max(1u, std::min(threadCount, count));
+    auto chunkBegin = [&](std::uint32_t chunk) { return std::uint32_t(std::uint64_t(count) * chunk / threadCount); };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (std::uint32_t chunk = 1; chunk < threadCount; ++chunk)
+    {
+        threads.emplace_back(function, chunkBegin(chunk), chunkBegin(chunk + 1), chunk);
+    }
+    function(chunkBegin(0), chunkBegin(1), 0u);
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+typedef struct MoBVHWorkerPool_T {
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    // run by every worker with its chunk, the calling thread runs chunk 0
+    std::function<void(std::uint32_t)> job;
+    std::uint64_t generation;
+    std::uint32_t pending;
+    bool quit;
+} MoBVHWorkerPool_T;
+
+static void moRunBVHWorker(MoBVHWorkerPool workerPool, std::uint32_t chunk)
+{
+    std::uint64_t generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(workerPool->mutex);
+            workerPool->wake.wait(lock, [&]() { return workerPool->quit || workerPool->generation != generation; });
+            if (workerPool->quit)
+            {
+                return;
+            }
+            generation = workerPool->generation;
+        }
+        workerPool->job(chunk);
+        std::lock_guard<std::mutex> lock(workerPool->mutex);
+        if (--workerPool->pending == 0)
+        {
+            workerPool->done.notify_one();
+        }
+    }
+}
+
+void moCreateBVHWorkerPool(std::uint32_t threadCount, MoBVHWorkerPool* pWorkerPool)
+{
+    MoBVHWorkerPool workerPool = *pWorkerPool = new MoBVHWorkerPool_T();
+    workerPool->generation = 0;
+    workerPool->pending = 0;
+    workerPool->quit = false;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workerPool->threads.reserve(threadCount - 1);
+    for (std::uint32_t chunk = 1; chunk < threadCount; ++chunk)
+    {
+        workerPool->threads.emplace_back(moRunBVHWorker, workerPool, chunk);
+    }
+}
+
+void moDestroyBVHWorkerPool(MoBVHWorkerPool workerPool)
+{
+    {
+        std::lock_guard<std::mutex> lock(workerPool->mutex);
+        workerPool->quit = true;
+    }
+    workerPool->wake.notify_all();
+    for (std::thread& thread : workerPool->threads)
+    {
+        thread.join();
+    }
+    delete workerPool;
+}
+
+// moParallelFor on the pool's threads, one chunk per thread
+template<typename Function>
+static void moParallelFor(MoBVHWorkerPool workerPool, std::uint32_t count, const Function& function)
+{
+    const std::uint32_t threadCount = std::uint32_t(workerPool->threads.size()) + 1;
+    auto chunkBegin = [&](std::uint32_t chunk) { return std::uint32_t(std::uint64_t(count) * chunk / threadCount); };
+    auto job = [&](std::uint32_t chunk) { function(chunkBegin(chunk), chunkBegin(chunk + 1), chunk); };
+    if (threadCount == 1)
+    {
+        job(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(workerPool->mutex);
+        workerPool->job = job;
+        workerPool->pending = threadCount - 1;
+        ++workerPool->generation;
+    }
+    workerPool->wake.notify_all();
+    job(0);
+    std::unique_lock<std::mutex> lock(workerPool->mutex);
+    workerPool->done.wait(lock, [&]() { return workerPool->pending == 0; });
+    workerPool->job = nullptr;
+}
+
+static std::uint32_t moPassThreadCount(std::uint32_t threadCount, std::uint32_t start, std::uint32_t end)
+{
+    return end - start < MO_BVH_PARALLEL_PASS_SIZE ? 1 : threadCount;
+}
+
+static void moComputeBounds(const MoBVHBuilder& builder, std::uint32_t start, std::uint32_t end, std::uint32_t threadCount, MoBBox& boundingBox, MoBBox& boundingBoxCentroids)
+{
+    threadCount = moPassThreadCount(threadCount, start, end);
+    if (threadCount <= 1)
+    {
+        boundingBox = builder.pBoxes[builder.pIndices[start]];
+        boundingBoxCentroids = builder.pCentroids[builder.pIndices[start]];
+        for (std::uint32_t i = start + 1; i < end; ++i)
+        {
+            boundingBox.expandToInclude(builder.pBoxes[builder.pIndices[i]]);
+            boundingBoxCentroids.expandToInclude(builder.pCentroids[builder.pIndices[i]]);
+        }
+        return;
+    }
+
+    std::vector<MoBBox> boxes(threadCount * 2);
+    moParallelFor(threadCount, end - start, [&](std::uint32_t begin, std::uint32_t finish, std::uint32_t chunk)
+    {
+        MoBBox& box = boxes[chunk * 2];
+        MoBBox& centroidBox = boxes[chunk * 2 + 1];
+        box = builder.pBoxes[builder.pIndices[start + begin]];
+        centroidBox = builder.pCentroids[builder.pIndices[start + begin]];
+        for (std::uint32_t i = start + begin + 1; i < start + finish; ++i)
+        {
+            box.expandToInclude(builder.pBoxes[builder.pIndices[i]]);
+            centroidBox.expandToInclude(builder.pCentroids[builder.pIndices[i]]);
+        }
+    });
+
+    boundingBox = boxes[0];
+    boundingBoxCentroids = boxes[1];
+    for (std::uint32_t chunk = 1; chunk < threadCount && chunk < end - start; ++chunk)
+    {
+        boundingBox.expandToInclude(boxes[chunk * 2]);
+        boundingBoxCentroids.expandToInclude(boxes[chunk * 2 + 1]);
+    }
+}
+
+// move the indices for which left(index) holds to the front of [start, end), returns the first index of the right side
+template<typename Predicate>
+static std::uint32_t moPartition(const MoBVHBuilder& builder, std::uint32_t start, std::uint32_t end, std::uint32_t threadCount, const Predicate& left)
+{
+    threadCount = moPassThreadCount(threadCount, start, end);
+    if (threadCount <= 1)
+    {
+        std::uint32_t mid = start;
+        for (std::uint32_t i = start; i < end; ++i)
+        {
+            if (left(builder.pIndices[i]))
+            {
+                std::swap(builder.pIndices[i], builder.pIndices[mid]);
+                ++mid;
+            }
+        }
+        return mid;
+    }
+
+    // count each chunk's sides, then scatter every chunk to its own slice of the scratch array and copy back
+    std::vector<std::uint32_t> leftCounts(threadCount, 0);
+    std::vector<std::uint32_t> rightCounts(threadCount, 0);
+    moParallelFor(threadCount, end - start, [&](std::uint32_t begin, std::uint32_t finish, std::uint32_t chunk)
+    {
+        for (std::uint32_t i = start + begin; i < start + finish; ++i)
+        {
+            if (left(builder.pIndices[i])) { leftCounts[chunk]++; }
+            else                           { rightCounts[chunk]++; }
+        }
+    });
+
+    std::uint32_t leftTotal = 0;
+    for (std::uint32_t count : leftCounts)
+    {
+        leftTotal += count;
+    }
+    std::vector<std::uint32_t> leftOffsets(threadCount);
+    std::vector<std::uint32_t> rightOffsets(threadCount);
+    for (std::uint32_t chunk = 0, leftOffset = start, rightOffset = start + leftTotal; chunk < threadCount; ++chunk)
+    {
+        leftOffsets[chunk] = leftOffset;
+        rightOffsets[chunk] = rightOffset;
+        leftOffset += leftCounts[chunk];
+        rightOffset += rightCounts[chunk];
+    }
+
+    moParallelFor(threadCount, end - start, [&](std::uint32_t begin, std::uint32_t finish, std::uint32_t chunk)
+    {
+        std::uint32_t leftOffset = leftOffsets[chunk];
+        std::uint32_t rightOffset = rightOffsets[chunk];
+        for (std::uint32_t i = start + begin; i < start + finish; ++i)
+        {
+            std::uint32_t index = builder.pIndices[i];
+            builder.pScratch[left(index) ? leftOffset++ : rightOffset++] = index;
+        }
+    });
+    moParallelFor(threadCount, end - start, [&](std::uint32_t begin, std::uint32_t finish, std::uint32_t)
+    {
+        memcpy(&builder.pIndices[start + begin], &builder.pScratch[start + begin], (finish - begin) * sizeof(std::uint32_t));
+    });
+
+    return start + leftTotal;
+}
+
+// partition around the middle of the centroids' longest side, returns the first index of the right side
+static std::uint32_t moSplitMidpoint(const MoBVHBuilder& builder, std::uint32_t start, std::uint32_t end, std::uint32_t threadCount, const MoBBox& boundingBoxCentroids)
+{
+    std::uint32_t splitDimension = boundingBoxCentroids.longestSide();
+    float splitLength = .5f * (boundingBoxCentroids.min[splitDimension] + boundingBoxCentroids.max[splitDimension]);
+
+    return moPartition(builder, start, end, threadCount, [&](std::uint32_t index)
+    {
+        return builder.pCentroids[index][splitDimension] < splitLength;
+    });
+}
+
+static std::uint32_t moBinIndex(float centroid, float min, float scale, std::uint32_t binCount)
+{
+    std::uint32_t bin = std::uint32_t((centroid - min) * scale);
+    return std::min(bin, binCount - 1);
+}
+
+static void moAccumulateBin(MoBVHBin& bin, const MoBBox& boundingBox, std::uint32_t count)
+{
+    if (bin.count == 0) { bin.boundingBox = boundingBox; }
+    else                { bin.boundingBox.expandToInclude(boundingBox); }
+    bin.count += count;
+}
+
+// adapted from Ingo Wald's "On fast Construction of SAH-based Bounding Volume Hierarchies"
+// partition along the cheapest bin boundary, returns the first index of the right side
+// splitCost is the unnormalized SAH cost of the two sides, or float max when no boundary separates the range
+// pBins is scratch space for 3 * MO_BVH_MAX_BIN_COUNT bins owned by the calling thread
+static std::uint32_t moSplitBinnedSAH(const MoBVHBuilder& builder, std::uint32_t start, std::uint32_t end, std::uint32_t threadCount, const MoBBox& boundingBoxCentroids, MoBVHBin* pBins, float& splitCost)
+{
+    const std::uint32_t binCount = builder.createInfo.binCount;
+    const float3 extent = boundingBoxCentroids.max - boundingBoxCentroids.min;
+    const float3 scale = float(binCount) / extent;
+
+    // every chunk bins its share of the range along all three axes, the chunks are then merged into the first
+    threadCount = moPassThreadCount(threadCount, start, end);
+    std::vector<MoBVHBin> sharedBins;
+    MoBVHBin* chunkBins = pBins;
+    if (threadCount > 1)
+    {
+        sharedBins.resize(threadCount * 3 * MO_BVH_MAX_BIN_COUNT);
+        chunkBins = sharedBins.data();
+    }
+    for (std::uint32_t chunk = 0; chunk < threadCount; ++chunk)
+    {
+        for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+        {
+            for (std::uint32_t b = 0; b < binCount; ++b)
+            {
+                chunkBins[(chunk * 3 + dimension) * MO_BVH_MAX_BIN_COUNT + b].count = 0;
+            }
+        }
+    }
+    moParallelFor(threadCount, end - start, [&](std::uint32_t begin, std::uint32_t finish, std::uint32_t chunk)
+    {
+        MoBVHBin* bins = &chunkBins[chunk * 3 * MO_BVH_MAX_BIN_COUNT];
+        for (std::uint32_t i = start + begin; i < start + finish; ++i)
+        {
+            std::uint32_t index = builder.pIndices[i];
+            for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+            {
+                if (extent[dimension] > 0.f)
+                {
+                    std::uint32_t b = moBinIndex(builder.pCentroids[index][dimension], boundingBoxCentroids.min[dimension], scale[dimension], binCount);
+                    MoBVHBin& bin = bins[dimension * MO_BVH_MAX_BIN_COUNT + b];
+                    moAccumulateBin(bin, builder.pBoxes[index], 1);
+                }
+            }
+        }
+    });
+    for (std::uint32_t chunk = 1; chunk < threadCount; ++chunk)
+    {
+        for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+        {
+            for (std::uint32_t b = 0; b < binCount; ++b)
+            {
+                const MoBVHBin& bin = chunkBins[(chunk * 3 + dimension) * MO_BVH_MAX_BIN_COUNT + b];
+                if (bin.count > 0)
+                {
+                    moAccumulateBin(chunkBins[dimension * MO_BVH_MAX_BIN_COUNT + b], bin.boundingBox, bin.count);
+                }
+            }
+        }
+    }
+
+    float bestCost = std::numeric_limits<float>::max();
+    std::uint32_t bestDimension = 0;
+    std::uint32_t bestBin = 0;
+    for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+    {
+        if (!(extent[dimension] > 0.f))
+        {
+            continue;
+        }
+        const MoBVHBin* bins = &chunkBins[dimension * MO_BVH_MAX_BIN_COUNT];
+
+        // sweep from the right, rightArea[b] and rightCount[b] describe bins [b, binCount)
+        float rightArea[MO_BVH_MAX_BIN_COUNT];
+        std::uint32_t rightCount[MO_BVH_MAX_BIN_COUNT];
+        MoBVHBin accumulated = {MoBBox(), 0};
+        for (std::uint32_t b = binCount - 1; b > 0; --b)
+        {
+            if (bins[b].count > 0)
+            {
+                moAccumulateBin(accumulated, bins[b].boundingBox, bins[b].count);
+            }
+            rightCount[b] = accumulated.count;
+            rightArea[b] = accumulated.count > 0 ? accumulated.boundingBox.surfaceArea() : 0.f;
+        }
+
+        // sweep from the left, splitting between bin b - 1 and bin b
+        accumulated = {MoBBox(), 0};
+        for (std::uint32_t b = 1; b < binCount; ++b)
+        {
+            if (bins[b - 1].count > 0)
+            {
+                moAccumulateBin(accumulated, bins[b - 1].boundingBox, bins[b - 1].count);
+            }
+            if (accumulated.count == 0 || rightCount[b] == 0)
+            {
+                continue;
+            }
+
+            float cost = accumulated.count * accumulated.boundingBox.surfaceArea() + rightCount[b] * rightArea[b];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestDimension = dimension;
+                bestBin = b;
+            }
+        }
+    }
+
+    // every centroid falls in the same bin, let the caller split the range in two
+    splitCost = bestCost;
+    if (bestCost == std::numeric_limits<float>::max())
+    {
+        return start;
+    }
+
+    return moPartition(builder, start, end, threadCount, [&](std::uint32_t index)
+    {
+        return moBinIndex(builder.pCentroids[index][bestDimension], boundingBoxCentroids.min[bestDimension], scale[bestDimension], binCount) < bestBin;
+    });
+}
+
+// spread the 21 lowest bits of value so that two zero bits separate each of them
+static std::uint64_t moExpandBits(std::uint64_t value)
+{
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffff;
+    value = (value | value << 16) & 0x1f0000ff0000ff;
+    value = (value | value << 8) & 0x100f00f00f00f00f;
+    value = (value | value << 4) & 0x10c30c30c30c30c3;
+    value = (value | value << 2) & 0x1249249249249249;
+    return value;
+}
+
+// interleave the centroids quantized to bitsPerAxis bits inside the centroid box
+static void moComputeMortonCodes(const MoBVHBuilder& builder, std::uint32_t count, std::uint32_t threadCount, const MoBBox& boundingBoxCentroids, std::uint32_t bitsPerAxis)
+{
+    const float cells = float(1u << bitsPerAxis);
+    const float3 extent = boundingBoxCentroids.max - boundingBoxCentroids.min;
+    const float3 scale(extent.x > 0.f ? cells / extent.x : 0.f,
+                       extent.y > 0.f ? cells / extent.y : 0.f,
+                       extent.z > 0.f ? cells / extent.z : 0.f);
+
+    moParallelFor(moPassThreadCount(threadCount, 0, count), count, [&](std::uint32_t begin, std::uint32_t end, std::uint32_t)
+    {
+        for (std::uint32_t i = begin; i < end; ++i)
+        {
+            std::uint64_t code = 0;
+            for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+            {
+                float cell = (builder.pCentroids[builder.pIndices[i]][dimension] - boundingBoxCentroids.min[dimension]) * scale[dimension];
+                std::uint64_t quantized = std::min(std::uint64_t(cell), std::uint64_t((1u << bitsPerAxis) - 1));
+                code |= moExpandBits(quantized) << (2 - dimension);
+            }
+            builder.pMortonCodes[i] = code;
+        }
+    });
+}
+
+// least significant digit radix sort of the Morton codes, carrying the triangle indices along
+static void moSortMortonCodes(const MoBVHBuilder& builder, std::uint32_t count, std::uint32_t bits)
+{
+    std::vector<std::uint64_t> scratchCodes(count);
+    std::uint64_t* codes = builder.pMortonCodes;
+    std::uint32_t* indices = builder.pIndices;
+    std::uint64_t* sortedCodes = scratchCodes.data();
+    std::uint32_t* sortedIndices = builder.pScratch;
+
+    for (std::uint32_t shift = 0; shift < bits; shift += 8)
+    {
+        std::uint32_t offsets[256] = {};
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            offsets[(codes[i] >> shift) & 0xff]++;
+        }
+        // every code shares this digit, the pass would not move anything
+        if (offsets[(codes[0] >> shift) & 0xff] == count)
+        {
+            continue;
+        }
+        for (std::uint32_t digit = 0, offset = 0; digit < 256; ++digit)
+        {
+            std::uint32_t digitCount = offsets[digit];
+            offsets[digit] = offset;
+            offset += digitCount;
+        }
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            std::uint32_t destination = offsets[(codes[i] >> shift) & 0xff]++;
+            sortedCodes[destination] = codes[i];
+            sortedIndices[destination] = indices[i];
+        }
+        std::swap(codes, sortedCodes);
+        std::swap(indices, sortedIndices);
+    }
+
+    if (codes != builder.pMortonCodes)
+    {
+        memcpy(builder.pMortonCodes, codes, count * sizeof(std::uint64_t));
+        memcpy(builder.pIndices, indices, count * sizeof(std::uint32_t));
+    }
+}
+
+// split sorted Morton codes where their highest differing bit flips, returns the first index of the right side
+static std::uint32_t moSplitMorton(const MoBVHBuilder& builder, std::uint32_t start, std::uint32_t end)
+{
+    std::uint64_t difference = builder.pMortonCodes[start] ^ builder.pMortonCodes[end - 1];
+    if (difference == 0)
+    {
+        return start;
+    }
+
+    std::uint64_t highestBit = difference;
+    highestBit |= highestBit >> 1;
+    highestBit |= highestBit >> 2;
+    highestBit |= highestBit >> 4;
+    highestBit |= highestBit >> 8;
+    highestBit |= highestBit >> 16;
+    highestBit |= highestBit >> 32;
+    highestBit ^= highestBit >> 1;
+
+    const std::uint64_t* pMid = std::partition_point(builder.pMortonCodes + start, builder.pMortonCodes + end, [&](std::uint64_t code)
+    {
+        return (code & highestBit) == 0;
+    });
+    return std::uint32_t(pMid - builder.pMortonCodes);
+}
+
+// returns true when [start, end) should be a leaf, otherwise partitions it and sets mid to the first index of the right side
+// nodes at depth MO_BVH_STACK_SIZE - 1 become leaves, whatever their size, so that traversals never run out of stack
+static bool moSplitRange(const MoBVHBuilder& builder, std::uint32_t start, std::uint32_t end, std::uint32_t depth, std::uint32_t threadCount, const MoBBox& boundingBox, const MoBBox& boundingBoxCentroids, MoBVHBin* pBins, std::uint32_t& mid)
+{
+    std::uint32_t count = end - start;
+    if (count <= 1 || depth + 1 >= MO_BVH_STACK_SIZE)
+    {
+        return true;
+    }
+
+    switch (builder.createInfo.buildMode)
+    {
+    case MO_BVH_BUILD_MODE_BINNED_SAH:
+    {
+        float splitCost;
+        mid = moSplitBinnedSAH(builder, start, end, threadCount, boundingBoxCentroids, pBins, splitCost);
+        // keep the range whole when intersecting every triangle is cheaper than traversing the split
+        float area = boundingBox.surfaceArea();
+        if (count <= builder.createInfo.maxLeafSize && count * area <= area + splitCost)
+        {
+            return true;
+        }
+        break;
+    }
+    case MO_BVH_BUILD_MODE_LBVH:
+        if (count <= builder.createInfo.maxLeafSize)
+        {
+            return true;
+        }
+        mid = moSplitMorton(builder, start, end);
+        break;
+    case MO_BVH_BUILD_MODE_MIDPOINT:
+    default:
+        if (count <= builder.createInfo.maxLeafSize)
+        {
+            return true;
+        }
+        mid = moSplitMidpoint(builder, start, end, threadCount, boundingBoxCentroids);
+        break;
+    }
+
+    if (mid == start || mid == end)
+    {
+        mid = start + (end-start) / 2;
+    }
+    return false;
+}
+
+// build the subtree over [start, end) rooted at depth on the calling thread, appending its nodes in depth first order to an empty array
+static void moBuildSubtree(const MoBVHBuilder& builder, std::uint32_t start, std::uint32_t end, std::uint32_t depth, const MoBVHSplitNode** ppSplitNodes, std::uint32_t* pSplitNodeCount)
+{
+    enum : std::uint32_t
+    {
+        Node_Untouched    = 0xffffffff,
+        Node_TouchedTwice = 0xfffffffd,
+        Node_Root         = 0xfffffffc,
+    };
+
+    std::uint32_t stackPtr = 0;
+
+    struct Entry
+    {
+        std::uint32_t parent;
+        std::uint32_t start;
+        std::uint32_t end;
+        std::uint32_t depth;
+    };
+    Entry* entries = {};
+    std::uint32_t entryCount = 0;
+    carray_resize(&entries, &entryCount, 1);
+    entries[stackPtr].start = start;
+    entries[stackPtr].end = end;
+    entries[stackPtr].parent = Node_Root;
+    entries[stackPtr].depth = depth;
+    stackPtr++;
+
+    std::uint32_t splitNodeCount = 0;
+    std::vector<MoBVHBin> bins(3 * MO_BVH_MAX_BIN_COUNT);
+
+    MoBVHSplitNode splitNode = {};
+    while (stackPtr > 0)
+    {
+        Entry &entry = entries[--stackPtr];
+        std::uint32_t start = entry.start;
+        std::uint32_t end = entry.end;
+        std::uint32_t depth = entry.depth;
+        std::uint32_t count = end - start;
+
+        splitNodeCount++;
+        splitNode.start = start;
+        splitNode.offset = Node_Untouched;
+        splitNode.count = 0;
+
+        // LBVH nodes are bounded bottom up once the tree is complete
+        MoBBox boundingBoxCentroids;
+        if (builder.createInfo.buildMode != MO_BVH_BUILD_MODE_LBVH)
+        {
+            moComputeBounds(builder, start, end, 1, splitNode.boundingBox, boundingBoxCentroids);
+        }
+
+        // we're at the leaf
+        std::uint32_t mid = start;
+        if (moSplitRange(builder, start, end, depth, 1, splitNode.boundingBox, boundingBoxCentroids, bins.data(), mid))
+        {
+            splitNode.offset = 0;
+            splitNode.count = count;
+        }
+        else
+        {
+            splitNode.start = 0;
+        }
+
+        carray_push_back(ppSplitNodes, pSplitNodeCount, splitNode);
+        if (entry.parent != Node_Root)
+        {
+            MoBVHSplitNode & splitNode = const_cast<MoBVHSplitNode*>(*ppSplitNodes)[entry.parent];
+            splitNode.offset--;
+            if (splitNode.offset == Node_TouchedTwice)
+            {
+                splitNode.offset = splitNodeCount - 1 - entry.parent;
+            }
+        }
+
+        if (splitNode.offset == 0)
+        {
+            continue;
+        }
+
+        // left
+        if (entryCount <= stackPtr)
+            carray_push_back(&entries, &entryCount, {});
+        entries[stackPtr].start = mid;
+        entries[stackPtr].end = end;
+        entries[stackPtr].parent = splitNodeCount - 1;
+        entries[stackPtr].depth = depth + 1;
+        stackPtr++;
+
+        // right
+        if (entryCount <= stackPtr)
+            carray_push_back(&entries, &entryCount, {});
+        entries[stackPtr].start = start;
+        entries[stackPtr].end = mid;
+        entries[stackPtr].parent = splitNodeCount - 1;
+        entries[stackPtr].depth = depth + 1;
+        stackPtr++;
+    }
+
+    carray_free(entries, &entryCount);
+}
+
+// split the top of the tree with every thread, then hand each half to a share of the threads proportional to its size
+static void moBuildSubtreeParallel(const MoBVHBuilder& builder, std::uint32_t start, std::uint32_t end, std::uint32_t depth, std::uint32_t threadCount, const MoBVHSplitNode** ppSplitNodes, std::uint32_t* pSplitNodeCount)
+{
+    if (threadCount <= 1 || end - start < MO_BVH_PARALLEL_TASK_SIZE)
+    {
+        moBuildSubtree(builder, start, end, depth, ppSplitNodes, pSplitNodeCount);
+        return;
+    }
+
+    MoBVHSplitNode splitNode = {};
+    MoBBox boundingBoxCentroids;
+    if (builder.createInfo.buildMode != MO_BVH_BUILD_MODE_LBVH)
+    {
+        moComputeBounds(builder, start, end, threadCount, splitNode.boundingBox, boundingBoxCentroids);
+    }
+
+    std::uint32_t mid = start;
+    std::vector<MoBVHBin> bins(3 * MO_BVH_MAX_BIN_COUNT);
+    if (moSplitRange(builder, start, end, depth, threadCount, splitNode.boundingBox, boundingBoxCentroids, bins.data(), mid))
+    {
+        splitNode.start = start;
+        splitNode.count = end - start;
+        carray_push_back(ppSplitNodes, pSplitNodeCount, splitNode);
+        return;
+    }
+
+    std::uint32_t leftThreadCount = std::uint32_t(std::uint64_t(threadCount) * (mid - start) / (end - start));
+    leftThreadCount = std::max(1u, std::min(leftThreadCount, threadCount - 1));
+
+    // children only reference each other through relative offsets and are relocated as is
+    const MoBVHSplitNode* pLeftNodes = nullptr;
+    const MoBVHSplitNode* pRightNodes = nullptr;
+    std::uint32_t leftNodeCount = 0;
+    std::uint32_t rightNodeCount = 0;
+    std::thread left([&]()
+    {
+        moBuildSubtreeParallel(builder, start, mid, depth + 1, leftThreadCount, &pLeftNodes, &leftNodeCount);
+    });
+    moBuildSubtreeParallel(builder, mid, end, depth + 1, threadCount - leftThreadCount, &pRightNodes, &rightNodeCount);
+    left.join();
+
+    splitNode.offset = 1 + leftNodeCount;
+    std::uint32_t first = *pSplitNodeCount;
+    carray_resize(ppSplitNodes, pSplitNodeCount, first + 1 + leftNodeCount + rightNodeCount);
+    const_cast<MoBVHSplitNode*>(*ppSplitNodes)[first] = splitNode;
+    carray_copy(*ppSplitNodes + first + 1, pLeftNodes, leftNodeCount);
+    carray_copy(*ppSplitNodes + first + 1 + leftNodeCount, pRightNodes, rightNodeCount);
+    carray_free(pLeftNodes, &leftNodeCount);
+    carray_free(pRightNodes, &rightNodeCount);
+}
+
+// MO_BVH_BUILD_MODE_SPATIAL_SPLITS, adapted from Martin Stich, Heiko Friedrich and Andreas Dietrich's "Spatial Splits in Bounding Volume Hierarchies"
+// spatial splits are only searched when the children of the best object split overlap by more than this fraction of the root's area
+#define MO_BVH_SPATIAL_SPLIT_ALPHA 1e-5f
+// below this depth nodes are split at the median of the best object split, and nodes reaching MO_BVH_STACK_SIZE - 1 become leaves
+#define MO_BVH_SPATIAL_SPLIT_MAX_DEPTH 48
+
+// a triangle, or the part of it left between the planes it was split at
+struct MoBVHReference
+{
+    MoBBox        boundingBox;
+    std::uint32_t index;
+};
+
+struct MoBVHSpatialBuilder
+{
+    const MoBVHBuilder*         pBuilder;
+    MoMesh                      mesh;
+    // a node's references are the last ones, they are replaced by its children's
+    std::vector<MoBVHReference> references;
+    // triangle of every reference in leaf order
+    std::vector<std::uint32_t>  leafIndices;
+    std::vector<float>          rightAreas;
+    // references that may still be added by spatial splits
+    std::uint32_t               duplicateBudget;
+    float                       minOverlap;
+};
+
+struct MoBVHSpatialSplit
+{
+    // unnormalized SAH cost of the two sides, as in moSplitBinnedSAH
+    float         cost;
+    std::uint32_t dimension;
+    bool          spatial;
+    // object splits: number of references going left once sorted along dimension
+    std::uint32_t leftCount;
+    // spatial splits: split plane along dimension
+    float         position;
+    // object splits: bounds of both sides
+    MoBBox        left;
+    MoBBox        right;
+};
+
+static float moSurfaceArea(const MoBVHBin& bin)
+{
+    return bin.count > 0 ? bin.boundingBox.surfaceArea() : 0.f;
+}
+
+// bounds of the reference's triangle on each side of the plane, a side without any of it has a count of 0
+static void moSplitReference(MoMesh mesh, const MoBVHReference& reference, std::uint32_t dimension, float position, MoBVHBin& left, MoBVHBin& right)
+{
+    left.count = 0;
+    right.count = 0;
+
+    const auto* face = &mesh->pIndices[reference.index * 3];
+    for (std::uint32_t i = 0; i < 3; ++i)
+    {
+        const float3& v0 = mesh->pVertices[face[i]];
+        const float3& v1 = mesh->pVertices[face[(i + 1) % 3]];
+        if (v0[dimension] <= position)
+        {
+            moAccumulateBin(left, MoBBox(v0), 1);
+        }
+        if (v0[dimension] >= position)
+        {
+            moAccumulateBin(right, MoBBox(v0), 1);
+        }
+        if ((v0[dimension] < position && v1[dimension] > position) || (v0[dimension] > position && v1[dimension] < position))
+        {
+            float3 crossing = v0 + (v1 - v0) * ((position - v0[dimension]) / (v1[dimension] - v0[dimension]));
+            crossing[dimension] = position;
+            moAccumulateBin(left, MoBBox(crossing), 1);
+            moAccumulateBin(right, MoBBox(crossing), 1);
+        }
+    }
+
+    // the reference may already be a clipped part of the triangle
+    for (MoBVHBin* pBin : {&left, &right})
+    {
+        MoBBox& boundingBox = pBin->boundingBox;
+        boundingBox.min = max(boundingBox.min, reference.boundingBox.min);
+        boundingBox.max = min(boundingBox.max, reference.boundingBox.max);
+        if (boundingBox.min.x > boundingBox.max.x || boundingBox.min.y > boundingBox.max.y || boundingBox.min.z > boundingBox.max.z)
+        {
+            pBin->count = 0;
+        }
+    }
+}
+
+static void moSortReferences(MoBVHReference* pReferences, std::uint32_t count, std::uint32_t dimension)
+{
+    std::sort(pReferences, pReferences + count, [dimension](const MoBVHReference& a, const MoBVHReference& b)
+    {
+        const float centroidA = a.boundingBox.min[dimension] + a.boundingBox.max[dimension];
+        const float centroidB = b.boundingBox.min[dimension] + b.boundingBox.max[dimension];
+        return centroidA < centroidB || (centroidA == centroidB && a.index < b.index);
+    });
+}
+
+// full sweep over the references sorted along each axis, leaves them sorted along the best one
+static void moFindObjectSplit(MoBVHSpatialBuilder& spatial, std::uint32_t count, MoBVHSpatialSplit& split)
+{
+    MoBVHReference* references = spatial.references.data() + spatial.references.size() - count;
+    std::vector<float>& rightAreas = spatial.rightAreas;
+    rightAreas.resize(count);
+
+    split.cost = std::numeric_limits<float>::max();
+    split.dimension = 0;
+    split.spatial = false;
+    split.leftCount = count / 2;
+    for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+    {
+        moSortReferences(references, count, dimension);
+
+        // rightAreas[i] bounds references [i, count)
+        MoBBox boundingBox = references[count - 1].boundingBox;
+        for (std::uint32_t i = count - 1; i > 0; --i)
+        {
+            boundingBox.expandToInclude(references[i].boundingBox);
+            rightAreas[i] = boundingBox.surfaceArea();
+        }
+
+        boundingBox = references[0].boundingBox;
+        for (std::uint32_t i = 1; i < count; ++i)
+        {
+            float cost = i * boundingBox.surfaceArea() + (count - i) * rightAreas[i];
+            if (cost < split.cost)
+            {
+                split.cost = cost;
+                split.dimension = dimension;
+                split.leftCount = i;
+            }
+            boundingBox.expandToInclude(references[i].boundingBox);
+        }
+    }
+
+    moSortReferences(references, count, split.dimension);
+    split.left = references[0].boundingBox;
+    for (std::uint32_t i = 1; i < split.leftCount; ++i)
+    {
+        split.left.expandToInclude(references[i].boundingBox);
+    }
+    split.right = references[split.leftCount].boundingBox;
+    for (std::uint32_t i = split.leftCount + 1; i < count; ++i)
+    {
+        split.right.expandToInclude(references[i].boundingBox);
+    }
+}
+
+// bins the parts of the references clipped to every bin they span, references entering a bin count on the left and leaving it on the right
+static void moFindSpatialSplit(const MoBVHSpatialBuilder& spatial, std::uint32_t count, const MoBBox& boundingBox, MoBVHSpatialSplit& split)
+{
+    const MoBVHReference* references = spatial.references.data() + spatial.references.size() - count;
+    const std::uint32_t binCount = spatial.pBuilder->createInfo.binCount;
+    const float3 extent = boundingBox.max - boundingBox.min;
+
+    split.cost = std::numeric_limits<float>::max();
+    split.spatial = true;
+    for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+    {
+        if (!(extent[dimension] > 0.f))
+        {
+            continue;
+        }
+        const float binSize = extent[dimension] / float(binCount);
+        const float scale = float(binCount) / extent[dimension];
+
+        MoBVHBin bins[MO_BVH_MAX_BIN_COUNT];
+        std::uint32_t entries[MO_BVH_MAX_BIN_COUNT];
+        std::uint32_t exits[MO_BVH_MAX_BIN_COUNT];
+        for (std::uint32_t b = 0; b < binCount; ++b)
+        {
+            bins[b].count = 0;
+            entries[b] = 0;
+            exits[b] = 0;
+        }
+
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            const std::uint32_t firstBin = moBinIndex(references[i].boundingBox.min[dimension], boundingBox.min[dimension], scale, binCount);
+            const std::uint32_t lastBin = moBinIndex(references[i].boundingBox.max[dimension], boundingBox.min[dimension], scale, binCount);
+            MoBVHReference part = references[i];
+            bool remaining = true;
+            for (std::uint32_t b = firstBin; b < lastBin && remaining; ++b)
+            {
+                MoBVHBin left, right;
+                moSplitReference(spatial.mesh, part, dimension, boundingBox.min[dimension] + binSize * float(b + 1), left, right);
+                if (left.count > 0)
+                {
+                    moAccumulateBin(bins[b], left.boundingBox, 1);
+                }
+                part.boundingBox = right.boundingBox;
+                remaining = right.count > 0;
+            }
+            if (remaining)
+            {
+                moAccumulateBin(bins[lastBin], part.boundingBox, 1);
+            }
+            ++entries[firstBin];
+            ++exits[lastBin];
+        }
+
+        // sweep from the right, rightArea[b] and rightCount[b] describe bins [b, binCount)
+        float rightArea[MO_BVH_MAX_BIN_COUNT];
+        std::uint32_t rightCount[MO_BVH_MAX_BIN_COUNT];
+        MoBVHBin accumulated = {MoBBox(), 0};
+        std::uint32_t exitCount = 0;
+        for (std::uint32_t b = binCount - 1; b > 0; --b)
+        {
+            if (bins[b].count > 0)
+            {
+                moAccumulateBin(accumulated, bins[b].boundingBox, 1);
+            }
+            exitCount += exits[b];
+            rightCount[b] = exitCount;
+            rightArea[b] = moSurfaceArea(accumulated);
+        }
+
+        // sweep from the left, splitting between bin b - 1 and bin b
+        accumulated = {MoBBox(), 0};
+        std::uint32_t entryCount = 0;
+        for (std::uint32_t b = 1; b < binCount; ++b)
+        {
+            if (bins[b - 1].count > 0)
+            {
+                moAccumulateBin(accumulated, bins[b - 1].boundingBox, 1);
+            }
+            entryCount += entries[b - 1];
+            if (entryCount == 0 || rightCount[b] == 0)
+            {
+                continue;
+            }
+
+            float cost = entryCount * moSurfaceArea(accumulated) + rightCount[b] * rightArea[b];
+            if (cost < split.cost)
+            {
+                split.cost = cost;
+                split.dimension = dimension;
+                split.position = boundingBox.min[dimension] + binSize * float(b);
+            }
+        }
+    }
+}
+
+// moves the node's references to either side of the plane, returns the number on the left
+// straddling references are split in two unless moving them whole to one side is cheaper, the right side grows by the copies
+static std::uint32_t moPerformSpatialSplit(MoBVHSpatialBuilder& spatial, std::uint32_t count, const MoBVHSpatialSplit& split)
+{
+    std::vector<MoBVHReference>& references = spatial.references;
+    const std::uint32_t dimension = split.dimension;
+    const float position = split.position;
+
+    // [leftStart, leftEnd) is left of the plane, [rightStart, size) right of it and straddling references are in between
+    const std::size_t leftStart = references.size() - count;
+    std::size_t leftEnd = leftStart;
+    std::size_t rightStart = references.size();
+    MoBVHBin leftBin = {MoBBox(), 0};
+    MoBVHBin rightBin = {MoBBox(), 0};
+    for (std::size_t i = leftEnd; i < rightStart;)
+    {
+        if (references[i].boundingBox.max[dimension] <= position)
+        {
+            moAccumulateBin(leftBin, references[i].boundingBox, 1);
+            std::swap(references[i++], references[leftEnd++]);
+        }
+        else if (references[i].boundingBox.min[dimension] >= position)
+        {
+            moAccumulateBin(rightBin, references[i].boundingBox, 1);
+            std::swap(references[i], references[--rightStart]);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    while (leftEnd < rightStart)
+    {
+        MoBVHBin left, right;
+        moSplitReference(spatial.mesh, references[leftEnd], dimension, position, left, right);
+
+        const float leftCount = float(leftEnd - leftStart);
+        const float rightCount = float(references.size() - rightStart);
+        MoBVHBin unsplitLeft = leftBin;
+        MoBVHBin unsplitRight = rightBin;
+        MoBVHBin duplicateLeft = leftBin;
+        MoBVHBin duplicateRight = rightBin;
+        moAccumulateBin(unsplitLeft, references[leftEnd].boundingBox, 1);
+        moAccumulateBin(unsplitRight, references[leftEnd].boundingBox, 1);
+        if (left.count > 0)
+        {
+            moAccumulateBin(duplicateLeft, left.boundingBox, 1);
+        }
+        if (right.count > 0)
+        {
+            moAccumulateBin(duplicateRight, right.boundingBox, 1);
+        }
+
+        const float unsplitLeftCost = moSurfaceArea(unsplitLeft) * (leftCount + 1.f) + moSurfaceArea(rightBin) * rightCount;
+        const float unsplitRightCost = moSurfaceArea(leftBin) * leftCount + moSurfaceArea(unsplitRight) * (rightCount + 1.f);
+        const float duplicateCost = left.count > 0 && right.count > 0
+            ? moSurfaceArea(duplicateLeft) * (leftCount + 1.f) + moSurfaceArea(duplicateRight) * (rightCount + 1.f)
+            : std::numeric_limits<float>::max();
+
+        if (unsplitLeftCost <= unsplitRightCost && unsplitLeftCost <= duplicateCost)
+        {
+            leftBin = unsplitLeft;
+            ++leftEnd;
+        }
+        else if (unsplitRightCost <= duplicateCost)
+        {
+            rightBin = unsplitRight;
+            std::swap(references[leftEnd], references[--rightStart]);
+        }
+        else
+        {
+            leftBin = duplicateLeft;
+            rightBin = duplicateRight;
+            MoBVHReference duplicate = {right.boundingBox, references[leftEnd].index};
+            references[leftEnd++].boundingBox = left.boundingBox;
+            references.push_back(duplicate);
+        }
+    }
+
+    return std::uint32_t(leftEnd - leftStart);
+}
+
+// build the node over the last count references, then its children depth first, consuming the references
+static void moBuildSpatialNode(MoBVHSpatialBuilder& spatial, std::uint32_t count, std::uint32_t depth, const MoBVHSplitNode** ppSplitNodes, std::uint32_t* pSplitNodeCount)
+{
+    std::vector<MoBVHReference>& references = spatial.references;
+    const std::size_t first = references.size() - count;
+
+    MoBVHSplitNode splitNode = {};
+    splitNode.boundingBox = references[first].boundingBox;
+    for (std::size_t i = first + 1; i < references.size(); ++i)
+    {
+        splitNode.boundingBox.expandToInclude(references[i].boundingBox);
+    }
+
+    MoBVHSpatialSplit split = {};
+    split.cost = std::numeric_limits<float>::max();
+    if (count > 1)
+    {
+        moFindObjectSplit(spatial, count, split);
+
+        const float3 overlapMin = max(split.left.min, split.right.min);
+        const float3 overlapMax = min(split.left.max, split.right.max);
+        const bool overlaps = overlapMin.x <= overlapMax.x && overlapMin.y <= overlapMax.y && overlapMin.z <= overlapMax.z;
+        if (overlaps && MoBBox(overlapMin, overlapMax).surfaceArea() > spatial.minOverlap
+            && depth < MO_BVH_SPATIAL_SPLIT_MAX_DEPTH && spatial.duplicateBudget >= count)
+        {
+            MoBVHSpatialSplit spatialSplit = {};
+            moFindSpatialSplit(spatial, count, splitNode.boundingBox, spatialSplit);
+            if (spatialSplit.cost < split.cost)
+            {
+                split = spatialSplit;
+            }
+        }
+    }
+
+    // keep the references whole when intersecting every triangle is cheaper than traversing the split
+    const float area = splitNode.boundingBox.surfaceArea();
+    if (count <= 1 || (count <= spatial.pBuilder->createInfo.maxLeafSize && count * area <= area + split.cost)
+        || depth + 1 >= MO_BVH_STACK_SIZE)
+    {
+        splitNode.start = std::uint32_t(spatial.leafIndices.size());
+        splitNode.count = count;
+        for (std::size_t i = first; i < references.size(); ++i)
+        {
+            spatial.leafIndices.push_back(references[i].index);
+        }
+        references.resize(first);
+        carray_push_back(ppSplitNodes, pSplitNodeCount, splitNode);
+        return;
+    }
+
+    std::uint32_t leftCount = split.leftCount;
+    if (split.spatial)
+    {
+        const std::size_t referenceCount = references.size();
+        leftCount = moPerformSpatialSplit(spatial, count, split);
+        spatial.duplicateBudget -= std::uint32_t(references.size() - referenceCount);
+
+        // every reference went whole to the same side, none were copied
+        if (leftCount == 0 || leftCount == references.size() - first)
+        {
+            moFindObjectSplit(spatial, count, split);
+            leftCount = split.leftCount;
+        }
+    }
+    else if (depth >= MO_BVH_SPATIAL_SPLIT_MAX_DEPTH)
+    {
+        leftCount = count / 2;
+    }
+    const std::uint32_t rightCount = std::uint32_t(references.size() - first) - leftCount;
+
+    // the left child is built first and takes its references from the end
+    std::rotate(references.begin() + first, references.begin() + first + leftCount, references.end());
+
+    const std::uint32_t index = *pSplitNodeCount;
+    carray_push_back(ppSplitNodes, pSplitNodeCount, splitNode);
+    moBuildSpatialNode(spatial, leftCount, depth + 1, ppSplitNodes, pSplitNodeCount);
+    const_cast<MoBVHSplitNode*>(*ppSplitNodes)[index].offset = *pSplitNodeCount - index;
+    moBuildSpatialNode(spatial, rightCount, depth + 1, ppSplitNodes, pSplitNodeCount);
+}
+
+// replaces the builder's indices with the triangle of every reference in leaf order, indexCount grows by the copies
+static void moBuildSpatialSplits(MoBVHBuilder& builder, std::uint32_t& indexCount, MoMesh mesh, const MoBVHSplitNode** ppSplitNodes, std::uint32_t* pSplitNodeCount)
+{
+    const std::uint32_t triangleCount = indexCount;
+    MoBVHSpatialBuilder spatial = {};
+    spatial.pBuilder = &builder;
+    spatial.mesh = mesh;
+    spatial.duplicateBudget = std::uint32_t(std::uint64_t(triangleCount) * builder.createInfo.spatialSplitBudget / 100);
+    spatial.references.reserve(triangleCount + spatial.duplicateBudget);
+    spatial.leafIndices.reserve(triangleCount + spatial.duplicateBudget);
+
+    MoBBox boundingBox = builder.pBoxes[0];
+    for (std::uint32_t i = 0; i < triangleCount; ++i)
+    {
+        spatial.references.push_back({builder.pBoxes[i], i});
+        boundingBox.expandToInclude(builder.pBoxes[i]);
+    }
+    spatial.minOverlap = MO_BVH_SPATIAL_SPLIT_ALPHA * boundingBox.surfaceArea();
+
+    moBuildSpatialNode(spatial, triangleCount, 0, ppSplitNodes, pSplitNodeCount);
+
+    const std::uint32_t* pLeafIndices = spatial.leafIndices.data();
+    carray_resize(&builder.pIndices, &indexCount, std::uint32_t(spatial.leafIndices.size()));
+    carray_copy(builder.pIndices, pLeafIndices, indexCount);
+}
+
+// the options moCreateBVH actually builds with, options the build mode ignores are cleared
+static MoBVHCreateInfo moResolveBVHCreateInfo(const MoBVHCreateInfo* pCreateInfo, std::uint32_t triangleCount)
+{
+    MoBVHCreateInfo createInfo = {};
+    if (pCreateInfo)
+    {
+        createInfo = *pCreateInfo;
+    }
+    if (createInfo.binCount == 0)
+    {
+        createInfo.binCount = MO_BVH_DEFAULT_BIN_COUNT;
+    }
+    createInfo.binCount = std::max(2u, std::min(createInfo.binCount, std::uint32_t(MO_BVH_MAX_BIN_COUNT)));
+    if (createInfo.maxLeafSize == 0)
+    {
+        createInfo.maxLeafSize = MO_BVH_DEFAULT_MAX_LEAF_SIZE;
+    }
+    if (createInfo.threadCount == 0)
+    {
+        createInfo.threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (createInfo.spatialSplitBudget == 0)
+    {
+        createInfo.spatialSplitBudget = MO_BVH_DEFAULT_SPATIAL_SPLIT_BUDGET;
+    }
+    // the mesh's indices have no room for the triangles' copies
+    if (createInfo.buildMode == MO_BVH_BUILD_MODE_SPATIAL_SPLITS && createInfo.triangleStorage == MO_BVH_TRIANGLE_STORAGE_INDEXED)
+    {
+        createInfo.buildMode = MO_BVH_BUILD_MODE_BINNED_SAH;
+    }
+    if (createInfo.buildMode != MO_BVH_BUILD_MODE_SPATIAL_SPLITS)
+    {
+        createInfo.spatialSplitBudget = 0;
+    }
+    if (createInfo.buildMode != MO_BVH_BUILD_MODE_LBVH)
+    {
+        createInfo.mortonCodeBits = 0;
+    }
+    else if (createInfo.mortonCodeBits == 0)
+    {
+        createInfo.mortonCodeBits = triangleCount > (1u << 20) ? 63 : 30;
+    }
+    else
+    {
+        createInfo.mortonCodeBits = createInfo.mortonCodeBits <= 30 ? 30 : 63;
+    }
+    return createInfo;
+}
+
+void moCreateBVH(MoMesh mesh, const MoBVHCreateInfo* pCreateInfo, MoBVH *pBVH)
+{
+    MoBVHBuilder builder = {};
+    builder.createInfo = moResolveBVHCreateInfo(pCreateInfo, mesh->indexCount / 3);
+    const MoBVHCreateInfo& createInfo = builder.createInfo;
+
+    MoBVH bvh = *pBVH = new MoBVH_T();
+    *bvh = {};
+    bvh->triangleFormat = createInfo.triangleFormat;
+    bvh->nodeFormat = createInfo.nodeFormat;
+    bvh->triangleStorage = createInfo.triangleStorage;
+
+    const std::uint32_t triangleCount = mesh->indexCount / 3;
+    std::uint32_t indexCount = 0;
+    std::uint32_t scratchCount = 0;
+    std::uint32_t boxCount = 0;
+    std::uint32_t centroidCount = 0;
+    carray_resize(&builder.pIndices, &indexCount, triangleCount);
+    carray_resize(&builder.pBoxes, &boxCount, triangleCount);
+    carray_resize(&builder.pCentroids, &centroidCount, triangleCount);
+    std::uint32_t mortonCodeCount = 0;
+    if (createInfo.threadCount > 1 || createInfo.buildMode == MO_BVH_BUILD_MODE_LBVH)
+    {
+        carray_resize(&builder.pScratch, &scratchCount, triangleCount);
+    }
+    if (createInfo.buildMode == MO_BVH_BUILD_MODE_LBVH)
+    {
+        carray_resize(&builder.pMortonCodes, &mortonCodeCount, triangleCount);
+    }
+
+    // per triangle bounds, computed once instead of at every level
+    moParallelFor(moPassThreadCount(createInfo.threadCount, 0, triangleCount), triangleCount, [&](std::uint32_t begin, std::uint32_t end, std::uint32_t)
+    {
+        for (std::uint32_t faceIdx = begin; faceIdx < end; ++faceIdx)
+        {
+            const auto* face = &mesh->pIndices[faceIdx*3];
+            MoTriangle triangle;
+            triangle.v0 = mesh->pVertices[face[0]];
+            triangle.v1 = mesh->pVertices[face[1]];
+            triangle.v2 = mesh->pVertices[face[2]];
+            builder.pIndices[faceIdx] = faceIdx;
+            const_cast<MoBBox*>(builder.pBoxes)[faceIdx] = triangle.getBoundingBox();
+            const_cast<float3*>(builder.pCentroids)[faceIdx] = triangle.getCentroid();
+        }
+    });
+
+    if (triangleCount > 0 && createInfo.buildMode == MO_BVH_BUILD_MODE_LBVH)
+    {
+        std::uint32_t bitsPerAxis = createInfo.mortonCodeBits <= 30 ? 10 : 21;
+
+        MoBBox boundingBox, boundingBoxCentroids;
+        moComputeBounds(builder, 0, triangleCount, createInfo.threadCount, boundingBox, boundingBoxCentroids);
+        moComputeMortonCodes(builder, triangleCount, createInfo.threadCount, boundingBoxCentroids, bitsPerAxis);
+        moSortMortonCodes(builder, triangleCount, bitsPerAxis * 3);
+    }
+
+    if (triangleCount > 0 && createInfo.buildMode == MO_BVH_BUILD_MODE_SPATIAL_SPLITS)
+    {
+        moBuildSpatialSplits(builder, indexCount, mesh, &bvh->pSplitNodes, &bvh->splitNodeCount);
+    }
+    else if (triangleCount > 0)
+    {
+        moBuildSubtreeParallel(builder, 0, triangleCount, 0, createInfo.threadCount, &bvh->pSplitNodes, &bvh->splitNodeCount);
+    }
+
+    // store triangles in leaf order so that every leaf covers a contiguous range, spatial splits store a triangle in every leaf it reaches
+    const std::uint32_t referenceCount = indexCount;
+    if (bvh->triangleStorage == MO_BVH_TRIANGLE_STORAGE_INDEXED)
+    {
+        bvh->triangleCount = referenceCount;
+        bvh->pVertices = mesh->pVertices;
+    }
+    else
+    {
+        carray_resize(&bvh->pTriangles, &bvh->triangleCount, referenceCount);
+    }
+    carray_resize(&bvh->pTriangleIndices, &bvh->triangleIndexCount, referenceCount * 3);
+    carray_resize(&bvh->pSourceTriangles, &bvh->sourceTriangleCount, referenceCount);
+    if (bvh->triangleFormat == MO_BVH_TRIANGLE_FORMAT_TRANSFORM)
+    {
+        carray_resize(&bvh->pTriangleTransforms, &bvh->triangleTransformCount, referenceCount);
+    }
+    moParallelFor(moPassThreadCount(createInfo.threadCount, 0, referenceCount), referenceCount, [&](std::uint32_t begin, std::uint32_t end, std::uint32_t)
+    {
+        for (std::uint32_t i = begin; i < end; ++i)
+        {
+            const auto* face = &mesh->pIndices[builder.pIndices[i]*3];
+            MoTriangle triangle;
+            triangle.v0 = mesh->pVertices[face[0]];
+            triangle.v1 = mesh->pVertices[face[1]];
+            triangle.v2 = mesh->pVertices[face[2]];
+            carray_copy(bvh->pTriangleIndices + i*3, face, 3);
+            const_cast<std::uint32_t&>(bvh->pSourceTriangles[i]) = builder.pIndices[i];
+            if (bvh->pTriangles)
+            {
+                const_cast<MoTriangle&>(bvh->pTriangles[i]) = triangle;
+            }
+            if (bvh->pTriangleTransforms)
+            {
+                const_cast<MoTriangleTransform&>(bvh->pTriangleTransforms[i]) = moComputeTriangleTransform(triangle);
+            }
+        }
+    });
+
+    // the mesh's own indices take the leaf order and are referenced instead of copied
+    if (bvh->triangleStorage == MO_BVH_TRIANGLE_STORAGE_INDEXED)
+    {
+        carray_copy(mesh->pIndices, bvh->pTriangleIndices, referenceCount * 3);
+        carray_free(bvh->pTriangleIndices, &bvh->triangleIndexCount);
+        bvh->pTriangleIndices = mesh->pIndices;
+        bvh->triangleIndexCount = referenceCount * 3;
+    }
+
+    if (createInfo.buildMode == MO_BVH_BUILD_MODE_LBVH)
+    {
+        std::uint32_t first, count;
+        moRefitSplitNodes(bvh, first, count);
+    }
+
+    moReorderSplitNodes(bvh);
+
+    if (bvh->splitNodeCount > 0)
+    {
+        std::uint32_t first, count;
+        moQuantizeSplitNodes(bvh, first, count);
+    }
+
+    carray_free(builder.pMortonCodes, &mortonCodeCount);
+    carray_free(builder.pScratch, &scratchCount);
+    carray_free(builder.pCentroids, &centroidCount);
+    carray_free(builder.pBoxes, &boxCount);
+    carray_free(builder.pIndices, &indexCount);
+}
+
+void moRefitBVH(MoBVH bvh, const float3* pVertices, MoBVHRefitInfo* pRefitInfo)
+{
+    MoBVHRefitInfo refitInfo = {};
+
+    std::uint32_t lastTriangle = 0;
+    refitInfo.firstTriangle = bvh->triangleCount;
+    if (bvh->triangleStorage == MO_BVH_TRIANGLE_STORAGE_INDEXED)
+    {
+        // nothing to compare the vertices against, only the transforms are diffed
+        bvh->pVertices = pVertices;
+        for (std::uint32_t i = 0; i < bvh->triangleTransformCount; ++i)
+        {
+            MoTriangleTransform transform = moComputeTriangleTransform(moGetBVHTriangle(bvh, i));
+            if (memcmp(&transform, &bvh->pTriangleTransforms[i], sizeof(transform)) != 0)
+            {
+                const_cast<MoTriangleTransform&>(bvh->pTriangleTransforms[i]) = transform;
+                refitInfo.firstTriangle = std::min(refitInfo.firstTriangle, i);
+                lastTriangle = i;
+            }
+        }
+    }
+    for (std::uint32_t i = 0; i < bvh->triangleCount && bvh->pTriangles; ++i)
+    {
+        const std::uint32_t* face = &bvh->pTriangleIndices[i*3];
+        MoTriangle& triangle = const_cast<MoTriangle&>(bvh->pTriangles[i]);
+        if (!moEqual(triangle.v0, pVertices[face[0]]) || !moEqual(triangle.v1, pVertices[face[1]]) || !moEqual(triangle.v2, pVertices[face[2]]))
+        {
+            triangle.v0 = pVertices[face[0]];
+            triangle.v1 = pVertices[face[1]];
+            triangle.v2 = pVertices[face[2]];
+            if (bvh->pTriangleTransforms)
+            {
+                const_cast<MoTriangleTransform&>(bvh->pTriangleTransforms[i]) = moComputeTriangleTransform(triangle);
+            }
+            refitInfo.firstTriangle = std::min(refitInfo.firstTriangle, i);
+            lastTriangle = i;
+        }
+    }
+
+    if (refitInfo.firstTriangle < bvh->triangleCount)
+    {
+        refitInfo.triangleCount = lastTriangle - refitInfo.firstTriangle + 1;
+    }
+    else
+    {
+        refitInfo.firstTriangle = 0;
+    }
+
+    if (refitInfo.triangleCount > 0 || (bvh->triangleStorage == MO_BVH_TRIANGLE_STORAGE_INDEXED && bvh->splitNodeCount > 0))
+    {
+        moRefitSplitNodes(bvh, refitInfo.firstSplitNode, refitInfo.splitNodeCount);
+
+        // a moved parent re-encodes its children, the range covers both node arrays
+        std::uint32_t firstQuantizedNode, quantizedNodeCount;
+        moQuantizeSplitNodes(bvh, firstQuantizedNode, quantizedNodeCount);
+        if (quantizedNodeCount > 0)
+        {
+            std::uint32_t last = refitInfo.splitNodeCount > 0 ? refitInfo.firstSplitNode + refitInfo.splitNodeCount : 0;
+            last = std::max(last, firstQuantizedNode + quantizedNodeCount);
+            refitInfo.firstSplitNode = refitInfo.splitNodeCount > 0 ? std::min(refitInfo.firstSplitNode, firstQuantizedNode) : firstQuantizedNode;
+            refitInfo.splitNodeCount = last - refitInfo.firstSplitNode;
+        }
+    }
+
+    if (pRefitInfo)
+    {
+        *pRefitInfo = refitInfo;
+    }
+}
+
+static void moUnmapBVH(MoBVH bvh);
+
+void moDestroyBVH(MoBVH bvh)
+{
+    if (bvh->pMapping)
+    {
+        moUnmapBVH(bvh);
+        delete bvh;
+        return;
+    }
+
     carray_free(bvh->pSplitNodes, &bvh->splitNodeCount);
     carray_free(bvh->pTriangles, &bvh->triangleCount);
+    if (bvh->triangleStorage != MO_BVH_TRIANGLE_STORAGE_INDEXED)
+    {
+        carray_free(bvh->pTriangleIndices, &bvh->triangleIndexCount);
+    }
+    carray_free(bvh->pSourceTriangles, &bvh->sourceTriangleCount);
+    carray_free(bvh->pTriangleTransforms, &bvh->triangleTransformCount);
+    std::uint32_t quantizedNodeCount = bvh->quantizedNodeCount;
+    carray_free(bvh->pQuantizedNodes8, &quantizedNodeCount);
+    carray_free(bvh->pQuantizedNodes16, &bvh->quantizedNodeCount);
     delete bvh;
 }
 
+void moGetBVHStats(MoBVH bvh, MoBVHStats* pStats)
+{
+    *pStats = {};
+    if (bvh->splitNodeCount == 0)
+    {
+        return;
+    }
+
+    // children always follow their parent in the array
+    std::vector<std::uint32_t> depths(bvh->splitNodeCount, 0);
+    const float rootArea = bvh->pSplitNodes[0].boundingBox.surfaceArea();
+    const float invRootArea = rootArea > 0.f ? 1.f / rootArea : 0.f;
+    float cost = 0.f, overlap = 0.f;
+    for (std::uint32_t index = 0; index < bvh->splitNodeCount; ++index)
+    {
+        const MoBVHSplitNode& node = bvh->pSplitNodes[index];
+        const float area = node.boundingBox.surfaceArea();
+        const std::uint32_t depth = depths[index];
+        if (node.offset == 0)
+        {
+            cost += area * (1.f + node.count);
+            pStats->leafCount++;
+            pStats->maxDepth = std::max(pStats->maxDepth, depth);
+            pStats->depthHistogram[std::min(depth, std::uint32_t(MO_BVH_STATS_MAX_DEPTH - 1))]++;
+            pStats->leafSizeHistogram[std::min(node.count, std::uint32_t(MO_BVH_STATS_MAX_LEAF_SIZE))]++;
+        }
+        else
+        {
+            cost += area;
+            pStats->splitNodeCount++;
+            depths[index + 1] = depth + 1;
+            depths[index + node.offset] = depth + 1;
+
+            const MoBBox& left = bvh->pSplitNodes[index + 1].boundingBox;
+            const MoBBox& right = bvh->pSplitNodes[index + node.offset].boundingBox;
+            const float3 overlapMin = max(left.min, right.min);
+            const float3 overlapMax = min(left.max, right.max);
+            if (overlapMin.x <= overlapMax.x && overlapMin.y <= overlapMax.y && overlapMin.z <= overlapMax.z)
+            {
+                overlap += MoBBox(overlapMin, overlapMax).surfaceArea();
+            }
+        }
+    }
+    pStats->sahCost = cost * invRootArea;
+    pStats->overlap = overlap * invRootArea;
+
+    if (bvh->pMapping)
+    {
+        pStats->memorySize = bvh->mappingSize;
+        return;
+    }
+    pStats->memorySize = sizeof(MoBVH_T)
+                       + bvh->splitNodeCount * sizeof(MoBVHSplitNode)
+                       + bvh->triangleCount * (bvh->pTriangles ? sizeof(MoTriangle) : 0)
+                       + bvh->sourceTriangleCount * sizeof(std::uint32_t)
+                       + bvh->triangleTransformCount * sizeof(MoTriangleTransform)
+                       + bvh->quantizedNodeCount * (bvh->pQuantizedNodes8 ? sizeof(MoBVHQuantizedNode8) : 0)
+                       + bvh->quantizedNodeCount * (bvh->pQuantizedNodes16 ? sizeof(MoBVHQuantizedNode16) : 0);
+    if (bvh->triangleStorage != MO_BVH_TRIANGLE_STORAGE_INDEXED)
+    {
+        pStats->memorySize += bvh->triangleIndexCount * sizeof(std::uint32_t);
+    }
+}
+
+#define MO_BVH_CACHE_MAGIC 0x4842564d // "MVBH"
+#define MO_BVH_CACHE_VERSION 2
+
+// followed by the arrays of MoBVH_T, each aligned to 16 bytes
+typedef struct MoBVHCacheHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t sourceHash;
+    std::uint32_t triangleFormat;
+    std::uint32_t nodeFormat;
+    std::uint32_t triangleStorage;
+    std::uint32_t triangleCount;
+    std::uint32_t splitNodeCount;
+    std::uint32_t triangleIndexCount;
+    std::uint32_t sourceTriangleCount;
+    std::uint32_t triangleTransformCount;
+    std::uint32_t quantizedNodeCount;
+} MoBVHCacheHeader;
+
+// word at a time FNV-1a, then a final avalanche, good enough to tell sources apart
+static std::uint64_t moHash(std::uint64_t hash, const void* pData, std::size_t size)
+{
+    const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+    for (; size >= sizeof(std::uint64_t); size -= sizeof(std::uint64_t), pBytes += sizeof(std::uint64_t))
+    {
+        std::uint64_t word;
+        memcpy(&word, pBytes, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    for (; size > 0; --size, ++pBytes)
+    {
+        hash = (hash ^ *pBytes) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::uint64_t moHashBVHSource(MoMesh mesh, const MoBVHCreateInfo* pCreateInfo)
+{
+    // the resolved options, so that leaving one at 0 and spelling out its default share a cache file
+    const MoBVHCreateInfo createInfo = moResolveBVHCreateInfo(pCreateInfo, mesh->indexCount / 3);
+
+    // threadCount is left out, it changes the build time and not the tree
+    const std::uint32_t options[] = {MO_BVH_CACHE_VERSION, createInfo.buildMode, createInfo.binCount, createInfo.maxLeafSize, createInfo.mortonCodeBits,
+                                     createInfo.triangleFormat, createInfo.nodeFormat, createInfo.triangleStorage, createInfo.spatialSplitBudget,
+                                     mesh->indexCount, mesh->vertexCount};
+    std::uint64_t hash = moHash(0xcbf29ce484222325ull, options, sizeof(options));
+    hash = moHash(hash, mesh->pIndices, mesh->indexCount * sizeof(std::uint32_t));
+    hash = moHash(hash, mesh->pVertices, mesh->vertexCount * sizeof(float3));
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// offsets of the arrays following the header
+typedef struct MoBVHCacheLayout {
+    std::size_t splitNodes;
+    std::size_t triangles;
+    std::size_t triangleIndices;
+    std::size_t sourceTriangles;
+    std::size_t triangleTransforms;
+    std::size_t quantizedNodes;
+    std::size_t size;
+} MoBVHCacheLayout;
+
+static std::size_t moAppend(std::size_t& offset, std::size_t size)
+{
+    std::size_t start = (offset + 15) & ~std::size_t(15);
+    offset = start + size;
+    return start;
+}
+
+static MoBVHCacheLayout moCacheLayout(const MoBVHCacheHeader& header)
+{
+    const std::size_t quantizedNodeSize = header.nodeFormat == MO_BVH_NODE_FORMAT_QUANTIZED_16 ? sizeof(MoBVHQuantizedNode16) : sizeof(MoBVHQuantizedNode8);
+    MoBVHCacheLayout layout = {};
+    std::size_t offset = sizeof(MoBVHCacheHeader);
+    layout.splitNodes = moAppend(offset, header.splitNodeCount * sizeof(MoBVHSplitNode));
+    layout.triangles = moAppend(offset, header.triangleStorage == MO_BVH_TRIANGLE_STORAGE_INDEXED ? 0 : header.triangleCount * sizeof(MoTriangle));
+    layout.triangleIndices = moAppend(offset, header.triangleIndexCount * sizeof(std::uint32_t));
+    layout.sourceTriangles = moAppend(offset, header.sourceTriangleCount * sizeof(std::uint32_t));
+    layout.triangleTransforms = moAppend(offset, header.triangleTransformCount * sizeof(MoTriangleTransform));
+    layout.quantizedNodes = moAppend(offset, header.quantizedNodeCount * quantizedNodeSize);
+    layout.size = offset;
+    return layout;
+}
+
+static bool moWrite(FILE* pFile, std::size_t offset, const void* pData, std::size_t size)
+{
+    static const char padding[16] = {};
+    long position = ftell(pFile);
+    if (position < 0 || std::size_t(position) > offset || offset - std::size_t(position) > sizeof(padding))
+    {
+        return false;
+    }
+    std::size_t paddingSize = offset - std::size_t(position);
+    return fwrite(padding, 1, paddingSize, pFile) == paddingSize && (size == 0 || fwrite(pData, 1, size, pFile) == size);
+}
+
+bool moSaveBVH(MoBVH bvh, std::uint64_t sourceHash, const char* pPath)
+{
+    MoBVHCacheHeader header = {};
+    header.magic = MO_BVH_CACHE_MAGIC;
+    header.version = MO_BVH_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.triangleFormat = bvh->triangleFormat;
+    header.nodeFormat = bvh->nodeFormat;
+    header.triangleStorage = bvh->triangleStorage;
+    header.triangleCount = bvh->triangleCount;
+    header.splitNodeCount = bvh->splitNodeCount;
+    header.triangleIndexCount = bvh->triangleIndexCount;
+    header.sourceTriangleCount = bvh->sourceTriangleCount;
+    header.triangleTransformCount = bvh->triangleTransformCount;
+    header.quantizedNodeCount = bvh->quantizedNodeCount;
+    const MoBVHCacheLayout layout = moCacheLayout(header);
+    const void* pQuantizedNodes = bvh->pQuantizedNodes16 ? static_cast<const void*>(bvh->pQuantizedNodes16) : static_cast<const void*>(bvh->pQuantizedNodes8);
+
+    // written aside and renamed so that a live mapping of the previous file keeps its pages
+    char temporaryPath[4096];
+    if (snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", pPath) >= int(sizeof(temporaryPath)))
+    {
+        return false;
+    }
+    FILE* pFile = fopen(temporaryPath, "wb");
+    if (pFile == nullptr)
+    {
+        return false;
+    }
+    bool written = moWrite(pFile, 0, &header, sizeof(header))
+        && moWrite(pFile, layout.splitNodes, bvh->pSplitNodes, header.splitNodeCount * sizeof(MoBVHSplitNode))
+        && moWrite(pFile, layout.triangles, bvh->pTriangles, bvh->pTriangles ? header.triangleCount * sizeof(MoTriangle) : 0)
+        && moWrite(pFile, layout.triangleIndices, bvh->pTriangleIndices, header.triangleIndexCount * sizeof(std::uint32_t))
+        && moWrite(pFile, layout.sourceTriangles, bvh->pSourceTriangles, header.sourceTriangleCount * sizeof(std::uint32_t))
+        && moWrite(pFile, layout.triangleTransforms, bvh->pTriangleTransforms, header.triangleTransformCount * sizeof(MoTriangleTransform))
+        && moWrite(pFile, layout.quantizedNodes, pQuantizedNodes, layout.size - layout.quantizedNodes);
+    written = fclose(pFile) == 0 && written;
+#if defined(_WIN32)
+    written = written && MoveFileExA(temporaryPath, pPath, MOVEFILE_REPLACE_EXISTING);
+#else
+    written = written && rename(temporaryPath, pPath) == 0;
+#endif
+    if (!written)
+    {
+        remove(temporaryPath);
+    }
+    return written;
+}
+
+// read only file, mapped copy on write so that moRefitBVH can update it in memory
+static const void* moMapFile(const char* pPath, std::size_t& size)
+{
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(pPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr) : nullptr;
+    void* pData = mapping ? MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+    if (mapping)
+    {
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    size = pData ? std::size_t(fileSize.QuadPart) : 0;
+    return pData;
+#else
+    int file = open(pPath, O_RDONLY);
+    if (file < 0)
+    {
+        return nullptr;
+    }
+    struct stat fileStat;
+    void* pData = fstat(file, &fileStat) == 0 && fileStat.st_size > 0 ? mmap(nullptr, std::size_t(fileStat.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0) : MAP_FAILED;
+    close(file);
+    size = pData != MAP_FAILED ? std::size_t(fileStat.st_size) : 0;
+    return pData != MAP_FAILED ? pData : nullptr;
+#endif
+}
+
+static void moUnmapFile(const void* pData, std::size_t size)
+{
+#if defined(_WIN32)
+    (void)size;
+    UnmapViewOfFile(pData);
+#else
+    munmap(const_cast<void*>(pData), size);
+#endif
+}
+
+static void moUnmapBVH(MoBVH bvh)
+{
+    moUnmapFile(bvh->pMapping, bvh->mappingSize);
+    bvh->pMapping = nullptr;
+    bvh->mappingSize = 0;
+}
+
+template<typename T>
+static const T* moMappedArray(const void* pMapping, std::size_t offset, std::uint32_t count)
+{
+    return count > 0 ? reinterpret_cast<const T*>(static_cast<const char*>(pMapping) + offset) : nullptr;
+}
+
+// every offset and range of a loaded cache is used to index without checks, a damaged file must not get that far
+template<typename T>
+static bool moValidateCachedQuantizedNodes(const MoBVHSplitNode* pSplitNodes, const T* pQuantizedNodes, std::uint32_t nodeCount)
+{
+    for (std::uint32_t i = 0; i < nodeCount; ++i)
+    {
+        const std::uint32_t index = pSplitNodes[i].count != 0 ? pSplitNodes[i].start : pSplitNodes[i].offset;
+        if (pQuantizedNodes[i].index != index || pQuantizedNodes[i].count != pSplitNodes[i].count)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool moValidateCachedBVH(const MoBVHCacheHeader& header, const MoBVHCacheLayout& layout, const void* pMapping, MoMesh mesh)
+{
+    if (header.triangleFormat > MO_BVH_TRIANGLE_FORMAT_TRANSFORM
+        || header.nodeFormat > MO_BVH_NODE_FORMAT_QUANTIZED_8
+        || header.triangleStorage > MO_BVH_TRIANGLE_STORAGE_INDEXED
+        || header.triangleTransformCount != (header.triangleFormat == MO_BVH_TRIANGLE_FORMAT_TRANSFORM ? header.triangleCount : 0)
+        || header.quantizedNodeCount != (header.nodeFormat != MO_BVH_NODE_FORMAT_FLOAT ? header.splitNodeCount : 0)
+        || (header.splitNodeCount == 0) != (header.triangleCount == 0))
+    {
+        return false;
+    }
+
+    // the nodes are laid out depth first, the left child next and the right child right after the left subtree
+    const MoBVHSplitNode* pSplitNodes = moMappedArray<MoBVHSplitNode>(pMapping, layout.splitNodes, header.splitNodeCount);
+    std::uint32_t traversal[MO_BVH_STACK_SIZE];
+    std::uint32_t depths[MO_BVH_STACK_SIZE];
+    std::uint32_t stackSize = 0;
+    std::uint32_t next = 0;
+    std::uint32_t depth = 0;
+    while (next < header.splitNodeCount)
+    {
+        const MoBVHSplitNode& node = pSplitNodes[next];
+        if (node.count != 0)
+        {
+            if (std::uint64_t(node.start) + node.count > header.triangleCount)
+            {
+                return false;
+            }
+            ++next;
+            if (stackSize == 0)
+            {
+                break;
+            }
+            --stackSize;
+            if (traversal[stackSize] != next)
+            {
+                return false;
+            }
+            depth = depths[stackSize];
+        }
+        else
+        {
+            if (node.offset < 2 || std::uint64_t(next) + node.offset >= header.splitNodeCount || depth + 1 >= MO_BVH_STACK_SIZE)
+            {
+                return false;
+            }
+            traversal[stackSize] = next + node.offset;
+            depths[stackSize] = ++depth;
+            ++stackSize;
+            ++next;
+        }
+    }
+    if (next != header.splitNodeCount || stackSize != 0)
+    {
+        return false;
+    }
+    if (header.nodeFormat == MO_BVH_NODE_FORMAT_QUANTIZED_16
+        && !moValidateCachedQuantizedNodes(pSplitNodes, moMappedArray<MoBVHQuantizedNode16>(pMapping, layout.quantizedNodes, header.quantizedNodeCount), header.quantizedNodeCount))
+    {
+        return false;
+    }
+    if (header.nodeFormat == MO_BVH_NODE_FORMAT_QUANTIZED_8
+        && !moValidateCachedQuantizedNodes(pSplitNodes, moMappedArray<MoBVHQuantizedNode8>(pMapping, layout.quantizedNodes, header.quantizedNodeCount), header.quantizedNodeCount))
+    {
+        return false;
+    }
+
+    const std::uint32_t* pTriangleIndices = moMappedArray<std::uint32_t>(pMapping, layout.triangleIndices, header.triangleIndexCount);
+    for (std::uint32_t i = 0; i < header.triangleIndexCount; ++i)
+    {
+        if (pTriangleIndices[i] >= mesh->vertexCount)
+        {
+            return false;
+        }
+    }
+    const std::uint32_t* pSourceTriangles = moMappedArray<std::uint32_t>(pMapping, layout.sourceTriangles, header.sourceTriangleCount);
+    for (std::uint32_t i = 0; i < header.sourceTriangleCount; ++i)
+    {
+        if (pSourceTriangles[i] >= mesh->indexCount / 3)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool moLoadBVH(MoMesh mesh, std::uint64_t sourceHash, const char* pPath, MoBVH* pBVH)
+{
+    std::size_t size = 0;
+    const void* pMapping = moMapFile(pPath, size);
+    if (pMapping == nullptr)
+    {
+        return false;
+    }
+
+    MoBVHCacheHeader header = {};
+    if (size >= sizeof(header))
+    {
+        memcpy(&header, pMapping, sizeof(header));
+    }
+    const MoBVHCacheLayout layout = moCacheLayout(header);
+    if (size < sizeof(header)
+        || header.magic != MO_BVH_CACHE_MAGIC
+        || header.version != MO_BVH_CACHE_VERSION
+        || header.sourceHash != sourceHash
+        || header.triangleIndexCount != std::uint64_t(header.triangleCount) * 3
+        || header.sourceTriangleCount != header.triangleCount
+        || (header.triangleStorage == MO_BVH_TRIANGLE_STORAGE_INDEXED && header.triangleIndexCount > mesh->indexCount)
+        || layout.size > size
+        || !moValidateCachedBVH(header, layout, pMapping, mesh))
+    {
+        moUnmapFile(pMapping, size);
+        return false;
+    }
+
+    MoBVH bvh = *pBVH = new MoBVH_T();
+    *bvh = {};
+    bvh->pMapping = pMapping;
+    bvh->mappingSize = size;
+    bvh->triangleFormat = MoBVHTriangleFormat(header.triangleFormat);
+    bvh->nodeFormat = MoBVHNodeFormat(header.nodeFormat);
+    bvh->triangleStorage = MoBVHTriangleStorage(header.triangleStorage);
+    bvh->triangleCount = header.triangleCount;
+    bvh->splitNodeCount = header.splitNodeCount;
+    bvh->triangleIndexCount = header.triangleIndexCount;
+    bvh->sourceTriangleCount = header.sourceTriangleCount;
+    bvh->triangleTransformCount = header.triangleTransformCount;
+    bvh->quantizedNodeCount = header.quantizedNodeCount;
+    bvh->pSplitNodes = moMappedArray<MoBVHSplitNode>(pMapping, layout.splitNodes, header.splitNodeCount);
+    bvh->pTriangleIndices = moMappedArray<std::uint32_t>(pMapping, layout.triangleIndices, header.triangleIndexCount);
+    bvh->pSourceTriangles = moMappedArray<std::uint32_t>(pMapping, layout.sourceTriangles, header.sourceTriangleCount);
+    bvh->pTriangleTransforms = moMappedArray<MoTriangleTransform>(pMapping, layout.triangleTransforms, header.triangleTransformCount);
+    if (bvh->nodeFormat == MO_BVH_NODE_FORMAT_QUANTIZED_16)
+    {
+        bvh->pQuantizedNodes16 = moMappedArray<MoBVHQuantizedNode16>(pMapping, layout.quantizedNodes, header.quantizedNodeCount);
+    }
+    else if (bvh->nodeFormat == MO_BVH_NODE_FORMAT_QUANTIZED_8)
+    {
+        bvh->pQuantizedNodes8 = moMappedArray<MoBVHQuantizedNode8>(pMapping, layout.quantizedNodes, header.quantizedNodeCount);
+    }
+
+    if (bvh->triangleStorage == MO_BVH_TRIANGLE_STORAGE_INDEXED)
+    {
+        // same reordering as moCreateBVH, the mapped indices are only read once
+        carray_copy(mesh->pIndices, bvh->pTriangleIndices, bvh->triangleIndexCount);
+        bvh->pTriangleIndices = mesh->pIndices;
+        bvh->pVertices = mesh->pVertices;
+    }
+    else
+    {
+        bvh->pTriangles = moMappedArray<MoTriangle>(pMapping, layout.triangles, header.triangleCount);
+    }
+    return true;
+}
+
+#define MO_BVH_BATCH_TASK_SIZE 256
+
+// octant of the direction, then the origin inside the root bounds, then the direction, interleaved per axis
+static std::uint64_t moRayMortonCode(const MoRay& ray, const MoBBox& boundingBox)
+{
+    std::uint64_t originCode = 0;
+    std::uint64_t directionCode = 0;
+    std::uint64_t octant = 0;
+    float3 extent = boundingBox.max - boundingBox.min;
+    for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+    {
+        float origin = extent[dimension] > 0.f ? (ray.origin[dimension] - boundingBox.min[dimension]) / extent[dimension] : 0.f;
+        float direction = ray.direction[dimension] / std::max(length(ray.direction), std::numeric_limits<float>::min());
+        std::uint64_t quantizedOrigin = std::uint64_t(std::min(std::max(origin * 1024.f, 0.f), 1023.f));
+        std::uint64_t quantizedDirection = std::uint64_t(std::min(std::max((direction * 0.5f + 0.5f) * 128.f, 0.f), 127.f));
+        originCode |= moExpandBits(quantizedOrigin) << (2 - dimension);
+        directionCode |= moExpandBits(quantizedDirection) << (2 - dimension);
+        octant |= std::uint64_t(ray.direction[dimension] < 0.f) << (2 - dimension);
+    }
+    return octant << 51 | originCode << 21 | directionCode;
+}
+
+// passes of the batch queries, on the caller's pool when there is one and the pass is worth more than the calling thread
+template<typename Function>
+static void moParallelFor(const MoBVHBatchInfo& batchInfo, std::uint32_t threadCount, std::uint32_t count, const Function& function)
+{
+    if (batchInfo.workerPool && threadCount > 1)
+    {
+        moParallelFor(batchInfo.workerPool, count, function);
+        return;
+    }
+    moParallelFor(threadCount, count, function);
+}
+
+std::uint32_t moIntersectBVHBatch(MoBVH bvh, const MoRay* pRays, std::uint32_t rayCount, MoIntersectResult* pIntersections, const MoBVHBatchInfo* pBatchInfo)
+{
+    MoBVHBatchInfo batchInfo = {};
+    if (pBatchInfo)
+    {
+        batchInfo = *pBatchInfo;
+    }
+    if (batchInfo.workerPool)
+    {
+        batchInfo.threadCount = std::uint32_t(batchInfo.workerPool->threads.size()) + 1;
+    }
+    if (batchInfo.threadCount == 0)
+    {
+        batchInfo.threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (rayCount == 0)
+    {
+        return 0;
+    }
+
+    std::vector<std::uint32_t> order;
+    if (batchInfo.sortRays && bvh->splitNodeCount != 0)
+    {
+        std::vector<std::uint64_t> codes(rayCount);
+        std::vector<std::uint32_t> scratch(rayCount);
+        order.resize(rayCount);
+        const MoBBox& boundingBox = bvh->pSplitNodes[0].boundingBox;
+        moParallelFor(batchInfo, rayCount < MO_BVH_PARALLEL_PASS_SIZE ? 1 : batchInfo.threadCount, rayCount, [&](std::uint32_t begin, std::uint32_t end, std::uint32_t)
+        {
+            for (std::uint32_t i = begin; i < end; ++i)
+            {
+                codes[i] = moRayMortonCode(pRays[i], boundingBox);
+                order[i] = i;
+            }
+        });
+
+        MoBVHBuilder builder = {};
+        builder.pMortonCodes = codes.data();
+        builder.pIndices = order.data();
+        builder.pScratch = scratch.data();
+        moSortMortonCodes(builder, rayCount, 54);
+    }
+
+    // rays are handed out in small tasks so that threads tracing cheap rays take on more of them
+    std::atomic<std::uint32_t> next(0);
+    std::atomic<std::uint32_t> hitCount(0);
+    std::uint32_t taskCount = (rayCount + MO_BVH_BATCH_TASK_SIZE - 1) / MO_BVH_BATCH_TASK_SIZE;
+    moParallelFor(batchInfo, batchInfo.threadCount, taskCount, [&](std::uint32_t, std::uint32_t, std::uint32_t)
+    {
+        std::uint32_t hits = 0;
+        for (std::uint32_t task = next++; task < taskCount; task = next++)
+        {
+            std::uint32_t end = std::min(rayCount, (task + 1) * MO_BVH_BATCH_TASK_SIZE);
+            for (std::uint32_t i = task * MO_BVH_BATCH_TASK_SIZE; i < end; ++i)
+            {
+                std::uint32_t ray = order.empty() ? i : order[i];
+                hits += moIntersectBVH(bvh, pRays[ray], pIntersections[ray], batchInfo.backfaceCulling);
+            }
+        }
+        hitCount += hits;
+    });
+    return hitCount;
+}
+
+// closest point of the triangle to point as barycentric coordinates, by Voronoi region
+// from Christer Ericson's "Real-Time Collision Detection" 5.1.5
+static float3 moClosestPointTriangle(const float3& point, const MoTriangle& triangle)
+{
+    const float3 ab = triangle.v1 - triangle.v0;
+    const float3 ac = triangle.v2 - triangle.v0;
+    const float3 ap = point - triangle.v0;
+    const float d1 = dot(ab, ap);
+    const float d2 = dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f)
+    {
+        return {1.f, 0.f, 0.f};
+    }
+
+    const float3 bp = point - triangle.v1;
+    const float d3 = dot(ab, bp);
+    const float d4 = dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3)
+    {
+        return {0.f, 1.f, 0.f};
+    }
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+    {
+        const float v = d1 / (d1 - d3);
+        return {1.f - v, v, 0.f};
+    }
+
+    const float3 cp = point - triangle.v2;
+    const float d5 = dot(ab, cp);
+    const float d6 = dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6)
+    {
+        return {0.f, 0.f, 1.f};
+    }
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+    {
+        const float w = d2 / (d2 - d6);
+        return {1.f - w, 0.f, w};
+    }
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+    {
+        const float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return {0.f, 1.f - w, w};
+    }
+
+    // inside the face, a degenerate triangle always ends in one of the regions above
+    const float denominator = 1.f / (va + vb + vc);
+    const float v = vb * denominator;
+    const float w = vc * denominator;
+    return {1.f - v - w, v, w};
+}
+
+static float moDistanceSquared(const float3& point, const MoBBox& boundingBox)
+{
+    const float3 delta = max(max(boundingBox.min - point, point - boundingBox.max), float3(0.f, 0.f, 0.f));
+    return dot(delta, delta);
+}
+
+struct MoClosestPointEntry
+{
+    float distanceSquared;
+    std::uint32_t index;
+    bool operator<(const MoClosestPointEntry& other) const { return distanceSquared > other.distanceSquared; }
+};
+
+// best first, nodes are visited by increasing distance to their bounds until the nearest one is farther than the best triangle
+static bool moClosestPoint(MoBVH bvh, const float3& point, float maxDistance, MoIntersectResult& result, std::vector<MoClosestPointEntry>& queue)
+{
+    float bestSquared = maxDistance * maxDistance;
+    bool found = false;
+    queue.clear();
+    if (bvh->splitNodeCount > 0)
+    {
+        queue.push_back({moDistanceSquared(point, bvh->pSplitNodes[0].boundingBox), 0});
+    }
+
+    while (!queue.empty() && queue.front().distanceSquared <= bestSquared)
+    {
+        std::pop_heap(queue.begin(), queue.end());
+        const MoBVHSplitNode& node = bvh->pSplitNodes[queue.back().index];
+        const std::uint32_t index = queue.back().index;
+        queue.pop_back();
+
+        if (node.offset == 0)
+        {
+            for (std::uint32_t i = node.start; i < node.start + node.count; ++i)
+            {
+                const MoTriangle triangle = moGetBVHTriangle(bvh, i);
+                const float3 barycentric = moClosestPointTriangle(point, triangle);
+                const float3 delta = triangle.v0 * barycentric.x + triangle.v1 * barycentric.y + triangle.v2 * barycentric.z - point;
+                const float distanceSquared = dot(delta, delta);
+                if (distanceSquared <= bestSquared)
+                {
+                    bestSquared = distanceSquared;
+                    found = true;
+                    moSetIntersectTriangle(bvh, i, result);
+                    result.barycentric = barycentric;
+                }
+            }
+            continue;
+        }
+
+        for (std::uint32_t child : {index + 1, index + node.offset})
+        {
+            const float distanceSquared = moDistanceSquared(point, bvh->pSplitNodes[child].boundingBox);
+            if (distanceSquared <= bestSquared)
+            {
+                queue.push_back({distanceSquared, child});
+                std::push_heap(queue.begin(), queue.end());
+            }
+        }
+    }
+
+    result.distance = found ? std::sqrt(bestSquared) : std::numeric_limits<float>::max();
+    return found;
+}
+
+bool moClosestPointBVH(MoBVH bvh, const float3& point, float maxDistance, MoIntersectResult& result)
+{
+    std::vector<MoClosestPointEntry> queue;
+    queue.reserve(64);
+    return moClosestPoint(bvh, point, maxDistance, result, queue);
+}
+
+std::uint32_t moClosestPointBVHBatch(MoBVH bvh, const float3* pPoints, std::uint32_t pointCount, float maxDistance, MoIntersectResult* pResults, const MoBVHBatchInfo* pBatchInfo)
+{
+    MoBVHBatchInfo batchInfo = {};
+    if (pBatchInfo)
+    {
+        batchInfo = *pBatchInfo;
+    }
+    if (batchInfo.workerPool)
+    {
+        batchInfo.threadCount = std::uint32_t(batchInfo.workerPool->threads.size()) + 1;
+    }
+    if (batchInfo.threadCount == 0)
+    {
+        batchInfo.threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (pointCount == 0)
+    {
+        return 0;
+    }
+
+    std::vector<std::uint32_t> order;
+    if (batchInfo.sortRays)
+    {
+        MoBBox boundingBox(pPoints[0]);
+        for (std::uint32_t i = 1; i < pointCount; ++i)
+        {
+            boundingBox.expandToInclude(pPoints[i]);
+        }
+
+        std::vector<std::uint64_t> codes(pointCount);
+        std::vector<std::uint32_t> scratch(pointCount);
+        order.resize(pointCount);
+        for (std::uint32_t i = 0; i < pointCount; ++i)
+        {
+            order[i] = i;
+        }
+
+        MoBVHBuilder builder = {};
+        builder.pCentroids = pPoints;
+        builder.pMortonCodes = codes.data();
+        builder.pIndices = order.data();
+        builder.pScratch = scratch.data();
+        // a pool's threads are kept for the queries, a cheap pass runs on the calling thread rather than starting threads
+        moComputeMortonCodes(builder, pointCount, batchInfo.workerPool ? 1 : batchInfo.threadCount, boundingBox, 10);
+        moSortMortonCodes(builder, pointCount, 30);
+    }
+
+    std::atomic<std::uint32_t> next(0);
+    std::atomic<std::uint32_t> foundCount(0);
+    std::uint32_t taskCount = (pointCount + MO_BVH_BATCH_TASK_SIZE - 1) / MO_BVH_BATCH_TASK_SIZE;
+    moParallelFor(batchInfo, batchInfo.threadCount, taskCount, [&](std::uint32_t, std::uint32_t, std::uint32_t)
+    {
+        std::vector<MoClosestPointEntry> queue;
+        queue.reserve(64);
+        std::uint32_t found = 0;
+        for (std::uint32_t task = next++; task < taskCount; task = next++)
+        {
+            std::uint32_t end = std::min(pointCount, (task + 1) * MO_BVH_BATCH_TASK_SIZE);
+            for (std::uint32_t i = task * MO_BVH_BATCH_TASK_SIZE; i < end; ++i)
+            {
+                std::uint32_t point = order.empty() ? i : order[i];
+                found += moClosestPoint(bvh, pPoints[point], maxDistance, pResults[point], queue);
+            }
+        }
+        foundCount += found;
+    });
+    return foundCount;
+}
+
+static float moSaturate(float x)
+{
+    return std::min(std::max(x, 0.f), 1.f);
+}
+
+// closest points of the segments p1q1 and p2q2, returns their squared distance
+// from Christer Ericson's "Real-Time Collision Detection" 5.1.9
+static float moClosestPointsSegmentSegment(const float3& p1, const float3& q1, const float3& p2, const float3& q2, float3& c1, float3& c2)
+{
+    const float3 d1 = q1 - p1;
+    const float3 d2 = q2 - p2;
+    const float3 r = p1 - p2;
+    const float a = dot(d1, d1);
+    const float e = dot(d2, d2);
+    const float f = dot(d2, r);
+    const float epsilon = std::numeric_limits<float>::min();
+
+    float s = 0.f, t = 0.f;
+    if (a <= epsilon && e > epsilon)
+    {
+        t = moSaturate(f / e);
+    }
+    else if (a > epsilon)
+    {
+        const float c = dot(d1, r);
+        if (e <= epsilon)
+        {
+            s = moSaturate(-c / a);
+        }
+        else
+        {
+            const float b = dot(d1, d2);
+            const float denominator = a * e - b * b;
+            s = denominator != 0.f ? moSaturate((b * f - c * e) / denominator) : 0.f;
+            t = (b * s + f) / e;
+            if (t < 0.f)
+            {
+                t = 0.f;
+                s = moSaturate(-c / a);
+            }
+            else if (t > 1.f)
+            {
+                t = 1.f;
+                s = moSaturate((b - c) / a);
+            }
+        }
+    }
+
+    c1 = p1 + d1 * s;
+    c2 = p2 + d2 * t;
+    return dot(c1 - c2, c1 - c2);
+}
+
+static bool moInsideTriangle(const float3& point, const MoTriangle& triangle, const float3& normal)
+{
+    return dot(cross(triangle.v1 - triangle.v0, point - triangle.v0), normal) >= 0.f
+        && dot(cross(triangle.v2 - triangle.v1, point - triangle.v1), normal) >= 0.f
+        && dot(cross(triangle.v0 - triangle.v2, point - triangle.v2), normal) >= 0.f;
+}
+
+// closest points of the segment p0p1 and the triangle, returns their squared distance
+static float moClosestPointsSegmentTriangle(const float3& p0, const float3& p1, const MoTriangle& triangle, float3& onSegment, float3& onTriangle)
+{
+    const float3 normal = cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+    const float d0 = dot(p0 - triangle.v0, normal);
+    const float d1 = dot(p1 - triangle.v0, normal);
+    if (d0 * d1 <= 0.f && d0 != d1)
+    {
+        const float3 crossing = p0 + (p1 - p0) * (d0 / (d0 - d1));
+        if (moInsideTriangle(crossing, triangle, normal))
+        {
+            onSegment = crossing;
+            onTriangle = crossing;
+            return 0.f;
+        }
+    }
+
+    // otherwise one of the segment's ends or one of the triangle's edges is involved
+    float distanceSquared = std::numeric_limits<float>::max();
+    for (const float3& end : {p0, p1})
+    {
+        const float3 barycentric = moClosestPointTriangle(end, triangle);
+        const float3 point = triangle.v0 * barycentric.x + triangle.v1 * barycentric.y + triangle.v2 * barycentric.z;
+        const float candidate = dot(point - end, point - end);
+        if (candidate < distanceSquared)
+        {
+            distanceSquared = candidate;
+            onSegment = end;
+            onTriangle = point;
+        }
+    }
+
+    const float3 vertices[3] = {triangle.v0, triangle.v1, triangle.v2};
+    for (std::uint32_t i = 0; i < 3; ++i)
+    {
+        float3 c1, c2;
+        const float candidate = moClosestPointsSegmentSegment(p0, p1, vertices[i], vertices[(i + 1) % 3], c1, c2);
+        if (candidate < distanceSquared)
+        {
+            distanceSquared = candidate;
+            onSegment = c1;
+            onTriangle = c2;
+        }
+    }
+    return distanceSquared;
+}
+
+// closest point of the triangle to the capsule's segment and the normal pushing the capsule out of it, returns their distance
+static float moCapsuleContact(const float3& p0, const float3& p1, const MoTriangle& triangle, float3& position, float3& normal)
+{
+    float3 onSegment;
+    const float distance = std::sqrt(moClosestPointsSegmentTriangle(p0, p1, triangle, onSegment, position));
+    if (distance > 0.f)
+    {
+        normal = (onSegment - position) / distance;
+        return distance;
+    }
+
+    // the segment crosses the triangle, out toward the side of its middle
+    const float3 faceNormal = cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+    const float faceNormalLength = length(faceNormal);
+    normal = faceNormalLength > 0.f ? faceNormal / faceNormalLength : float3(0.f, 0.f, 0.f);
+    if (dot(normal, (p0 + p1) * 0.5f - triangle.v0) < 0.f)
+    {
+        normal = -normal;
+    }
+    return 0.f;
+}
+
+// the sweeps below are point against primitive, they lower t to the first contact and assume no contact at the start
+static bool moSweepPointSphere(const float3& origin, const float3& direction, const float3& center, float radius, float& t)
+{
+    const float3 m = origin - center;
+    const float b = dot(m, direction);
+    const float c = dot(m, m) - radius * radius;
+    const float discriminant = b * b - c;
+    if (b >= 0.f || discriminant < 0.f)
+    {
+        return false;
+    }
+
+    const float hit = std::max(0.f, -b - std::sqrt(discriminant));
+    if (hit > t)
+    {
+        return false;
+    }
+    t = hit;
+    return true;
+}
+
+// side of the cylinder around p0p1, its ends are spheres
+static bool moSweepPointCylinder(const float3& origin, const float3& direction, const float3& p0, const float3& p1, float radius, float& t)
+{
+    const float3 axis = p1 - p0;
+    const float axisSquared = dot(axis, axis);
+    if (axisSquared <= std::numeric_limits<float>::min())
+    {
+        return false;
+    }
+
+    const float3 m = origin - p0;
+    const float3 mPerpendicular = m - axis * (dot(m, axis) / axisSquared);
+    const float3 directionPerpendicular = direction - axis * (dot(direction, axis) / axisSquared);
+    const float a = dot(directionPerpendicular, directionPerpendicular);
+    const float b = dot(mPerpendicular, directionPerpendicular);
+    const float c = dot(mPerpendicular, mPerpendicular) - radius * radius;
+    const float discriminant = b * b - a * c;
+    if (a <= std::numeric_limits<float>::min() || b >= 0.f || discriminant < 0.f)
+    {
+        return false;
+    }
+
+    const float hit = std::max(0.f, (-b - std::sqrt(discriminant)) / a);
+    const float s = dot(m + direction * hit, axis);
+    if (hit > t || s < 0.f || s > axisSquared)
+    {
+        return false;
+    }
+    t = hit;
+    return true;
+}
+
+// the triangle's face offset by radius toward the origin
+static bool moSweepPointFace(const float3& origin, const float3& direction, const MoTriangle& triangle, const float3& normal, float radius, float& t)
+{
+    const float distance = dot(origin - triangle.v0, normal);
+    const float side = distance >= 0.f ? 1.f : -1.f;
+    const float approach = -dot(direction, normal) * side;
+    if (approach <= 0.f)
+    {
+        return false;
+    }
+
+    const float hit = std::max(0.f, (distance * side - radius) / approach);
+    const float3 point = origin + direction * hit;
+    if (hit > t || !moInsideTriangle(point - normal * dot(point - triangle.v0, normal), triangle, normal))
+    {
+        return false;
+    }
+    t = hit;
+    return true;
+}
+
+// the segment p0p1 moving along direction against the edge e0e1, contacts between both interiors only
+static bool moSweepSegmentEdge(const float3& p0, const float3& p1, const float3& direction, const float3& e0, const float3& e1, float radius, float& t)
+{
+    const float3 axis = p1 - p0;
+    const float3 edge = e1 - e0;
+    const float aa = dot(axis, axis);
+    const float ee = dot(edge, edge);
+    const float ea = dot(edge, axis);
+    const float determinant = ea * ea - ee * aa;
+    float3 normal = cross(axis, edge);
+    const float normalSquared = dot(normal, normal);
+    // parallel segments touch at an end first
+    if (normalSquared <= 1e-12f * aa * ee || determinant == 0.f)
+    {
+        return false;
+    }
+    normal = normal / std::sqrt(normalSquared);
+
+    const float3 w = p0 - e0;
+    const float distance = dot(w, normal);
+    const float side = distance >= 0.f ? 1.f : -1.f;
+    const float approach = -dot(direction, normal) * side;
+    if (approach <= 0.f)
+    {
+        return false;
+    }
+
+    const float hit = std::max(0.f, (distance * side - radius) / approach);
+    if (hit > t)
+    {
+        return false;
+    }
+
+    // in the plane of both segments, the offset between the touching points is u * edge - s * axis
+    float3 offset = w + direction * hit;
+    offset -= normal * dot(offset, normal);
+    const float oe = dot(offset, edge);
+    const float oa = dot(offset, axis);
+    const float u = (ea * oa - aa * oe) / determinant;
+    const float s = (ee * oa - ea * oe) / determinant;
+    if (u < 0.f || u > 1.f || s < 0.f || s > 1.f)
+    {
+        return false;
+    }
+    t = hit;
+    return true;
+}
+
+// first contact within [0, t] of the capsule moving along direction, by the pairs of features that can touch first
+static bool moSweepCapsuleTriangle(const MoCapsule& capsule, const float3& direction, const MoTriangle& triangle, float& t)
+{
+    float3 onSegment, onTriangle;
+    if (moClosestPointsSegmentTriangle(capsule.p0, capsule.p1, triangle, onSegment, onTriangle) <= capsule.radius * capsule.radius)
+    {
+        t = 0.f;
+        return true;
+    }
+
+    bool hit = false;
+    const float3 vertices[3] = {triangle.v0, triangle.v1, triangle.v2};
+    const float3 faceNormal = cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+    const float faceNormalLength = length(faceNormal);
+    const std::uint32_t endCount = length2(capsule.p1 - capsule.p0) > 0.f ? 2 : 1;
+    for (std::uint32_t end = 0; end < endCount; ++end)
+    {
+        const float3& origin = end == 0 ? capsule.p0 : capsule.p1;
+        if (faceNormalLength > 0.f)
+        {
+            hit |= moSweepPointFace(origin, direction, triangle, faceNormal / faceNormalLength, capsule.radius, t);
+        }
+        for (std::uint32_t i = 0; i < 3; ++i)
+        {
+            hit |= moSweepPointSphere(origin, direction, vertices[i], capsule.radius, t);
+            hit |= moSweepPointCylinder(origin, direction, vertices[i], vertices[(i + 1) % 3], capsule.radius, t);
+        }
+    }
+    for (std::uint32_t i = 0; i < 3; ++i)
+    {
+        hit |= moSweepPointCylinder(vertices[i], -direction, capsule.p0, capsule.p1, capsule.radius, t);
+        hit |= moSweepSegmentEdge(capsule.p0, capsule.p1, direction, vertices[i], vertices[(i + 1) % 3], capsule.radius, t);
+    }
+    return hit;
+}
+
+bool moCapsuleCastBVH(MoBVH bvh, const MoCapsule& capsule, const float3& direction, float maxDistance, MoSweepResult& result)
+{
+    if (bvh->splitNodeCount == 0)
+    {
+        return false;
+    }
+
+    // boxes grown by the capsule's bounds around p0 are hit by the ray from p0 wherever the capsule overlaps them
+    const float3 radius(capsule.radius, capsule.radius, capsule.radius);
+    const float3 lower = min(capsule.p0, capsule.p1) - radius - capsule.p0;
+    const float3 upper = max(capsule.p0, capsule.p1) + radius - capsule.p0;
+    const MoRay ray(capsule.p0, direction);
+
+    float distance = maxDistance;
+    std::uint32_t triangleIndex = 0;
+    bool found = false;
+
+    float bbhits[4];
+    std::uint32_t closer, other;
+
+    struct Traversal
+    {
+        std::uint32_t index;
+        float distance;
+    };
+    Traversal traversal[MO_BVH_STACK_SIZE];
+    std::int32_t stackPtr = 0;
+
+    traversal[stackPtr].index = 0;
+    traversal[stackPtr].distance = std::numeric_limits<float>::lowest();
+
+    while (stackPtr >= 0 && distance > 0.f)
+    {
+        std::uint32_t index = traversal[stackPtr].index;
+        float near = traversal[stackPtr].distance;
+        stackPtr--;
+        const MoBVHSplitNode& node = bvh->pSplitNodes[index];
+
+        if (near > distance)
+        {
+            continue;
+        }
+
+        if (node.offset == 0)
+        {
+            for (std::uint32_t i = node.start; i < node.start + node.count; ++i)
+            {
+                const MoTriangle triangle = moGetBVHTriangle(bvh, i);
+                const MoBBox boundingBox = triangle.getBoundingBox();
+                if (MoBBox(boundingBox.min - upper, boundingBox.max - lower).intersect(ray, bbhits[0], bbhits[1])
+                    && bbhits[1] >= 0.f && bbhits[0] <= distance
+                    && moSweepCapsuleTriangle(capsule, direction, triangle, distance))
+                {
+                    triangleIndex = i;
+                    found = true;
+                }
+            }
+        }
+        else
+        {
+            MO_BVH_CHECK_STACK(traversal, stackPtr, 2);
+            const MoBBox& leftBox = bvh->pSplitNodes[index + 1].boundingBox;
+            const MoBBox& rightBox = bvh->pSplitNodes[index + node.offset].boundingBox;
+            bool hitLeft = MoBBox(leftBox.min - upper, leftBox.max - lower).intersect(ray, bbhits[0], bbhits[1]) && bbhits[1] >= 0.f;
+            bool hitRight = MoBBox(rightBox.min - upper, rightBox.max - lower).intersect(ray, bbhits[2], bbhits[3]) && bbhits[3] >= 0.f;
+
+            if (hitLeft && hitRight)
+            {
+                closer = index + 1;
+                other = index + node.offset;
+
+                if (bbhits[2] < bbhits[0])
+                {
+                    std::swap(bbhits[0], bbhits[2]);
+                    std::swap(closer, other);
+                }
+
+                ++stackPtr;
+                traversal[stackPtr] = Traversal{other, bbhits[2]};
+                ++stackPtr;
+                traversal[stackPtr] = Traversal{closer, bbhits[0]};
+            }
+            else if (hitLeft)
+            {
+                ++stackPtr;
+                traversal[stackPtr] = Traversal{index + 1, bbhits[0]};
+            }
+            else if (hitRight)
+            {
+                ++stackPtr;
+                traversal[stackPtr] = Traversal{index + node.offset, bbhits[2]};
+            }
+        }
+    }
+
+    if (!found)
+    {
+        return false;
+    }
+
+    const float3 offset = direction * distance;
+    moCapsuleContact(capsule.p0 + offset, capsule.p1 + offset, moGetBVHTriangle(bvh, triangleIndex), result.position, result.normal);
+    moSetIntersectTriangle(bvh, triangleIndex, result);
+    result.distance = distance;
+    return true;
+}
+
+bool moSphereCastBVH(MoBVH bvh, const float3& center, float radius, const float3& direction, float maxDistance, MoSweepResult& result)
+{
+    return moCapsuleCastBVH(bvh, MoCapsule{center, center, radius}, direction, maxDistance, result);
+}
+
+static bool moOverlaps(const MoBBox& a, const MoBBox& b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x
+        && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+std::uint32_t moOverlapCapsuleBVH(MoBVH bvh, const MoCapsule& capsule, MoContact* pContacts, std::uint32_t contactCapacity)
+{
+    if (bvh->splitNodeCount == 0)
+    {
+        return 0;
+    }
+
+    const float3 radius(capsule.radius, capsule.radius, capsule.radius);
+    const MoBBox capsuleBox(min(capsule.p0, capsule.p1) - radius, max(capsule.p0, capsule.p1) + radius);
+    std::uint32_t contactCount = 0;
+    // sorted mesh triangles already counted, spatial splits store a triangle in every leaf it reaches
+    std::vector<std::uint32_t> sourceTriangles;
+
+    std::uint32_t traversal[MO_BVH_STACK_SIZE];
+    std::int32_t stackPtr = 0;
+    traversal[stackPtr] = 0;
+
+    while (stackPtr >= 0)
+    {
+        std::uint32_t index = traversal[stackPtr];
+        stackPtr--;
+        const MoBVHSplitNode& node = bvh->pSplitNodes[index];
+
+        if (!moOverlaps(node.boundingBox, capsuleBox))
+        {
+            continue;
+        }
+
+        if (node.offset == 0)
+        {
+            for (std::uint32_t i = node.start; i < node.start + node.count; ++i)
+            {
+                const MoTriangle triangle = moGetBVHTriangle(bvh, i);
+                if (!moOverlaps(triangle.getBoundingBox(), capsuleBox))
+                {
+                    continue;
+                }
+
+                float3 position, normal;
+                const float distance = moCapsuleContact(capsule.p0, capsule.p1, triangle, position, normal);
+                if (distance > capsule.radius)
+                {
+                    continue;
+                }
+                const std::uint32_t sourceTriangle = bvh->pSourceTriangles[i];
+                const auto it = std::lower_bound(sourceTriangles.begin(), sourceTriangles.end(), sourceTriangle);
+                if (it != sourceTriangles.end() && *it == sourceTriangle)
+                {
+                    continue;
+                }
+                sourceTriangles.insert(it, sourceTriangle);
+
+                if (contactCount < contactCapacity)
+                {
+                    MoContact& contact = pContacts[contactCount];
+                    moSetIntersectTriangle(bvh, i, contact);
+                    contact.position = position;
+                    contact.normal = normal;
+                    contact.depth = capsule.radius - distance;
+                }
+                ++contactCount;
+            }
+        }
+        else
+        {
+            MO_BVH_CHECK_STACK(traversal, stackPtr, 2);
+            ++stackPtr;
+            traversal[stackPtr] = index + node.offset;
+            ++stackPtr;
+            traversal[stackPtr] = index + 1;
+        }
+    }
+    return contactCount;
+}
+
+// open the inner child with the largest surface area until Width children are gathered
+template<std::uint32_t Width>
+static std::uint32_t moCollapseBVH(MoBVH bvh, std::uint32_t index, const MoBVHWideNode<Width>** ppNodes, std::uint32_t* pNodeCount)
+{
+    const MoBVHSplitNode* pSplitNodes = bvh->pSplitNodes;
+
+    std::uint32_t children[Width];
+    std::uint32_t childCount = 0;
+    if (pSplitNodes[index].offset == 0)
+    {
+        children[childCount++] = index;
+    }
+    else
+    {
+        children[childCount++] = index + 1;
+        children[childCount++] = index + pSplitNodes[index].offset;
+    }
+    while (childCount < Width)
+    {
+        std::uint32_t largest = childCount;
+        float largestArea = -1.f;
+        for (std::uint32_t i = 0; i < childCount; ++i)
+        {
+            const MoBVHSplitNode& child = pSplitNodes[children[i]];
+            if (child.offset != 0 && child.boundingBox.surfaceArea() > largestArea)
+            {
+                largest = i;
+                largestArea = child.boundingBox.surfaceArea();
+            }
+        }
+        if (largest == childCount)
+        {
+            break;
+        }
+        std::uint32_t opened = children[largest];
+        children[largest] = opened + 1;
+        children[childCount++] = opened + pSplitNodes[opened].offset;
+    }
+
+    MoBVHWideNode<Width> node = {};
+    node.childCount = childCount;
+    std::uint32_t nodeIndex = *pNodeCount;
+    carray_push_back(ppNodes, pNodeCount, node);
+
+    for (std::uint32_t i = 0; i < childCount; ++i)
+    {
+        const MoBVHSplitNode& child = pSplitNodes[children[i]];
+        for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+        {
+            node.boundingBoxes[dimension][i] = child.boundingBox.min[dimension];
+            node.boundingBoxes[3 + dimension][i] = child.boundingBox.max[dimension];
+        }
+        if (child.offset == 0)
+        {
+            node.child[i] = child.start;
+            node.count[i] = child.count;
+        }
+        else
+        {
+            // recursion may grow the array, node is a copy written back once complete
+            node.child[i] = moCollapseBVH<Width>(bvh, children[i], ppNodes, pNodeCount);
+            node.count[i] = 0;
+        }
+    }
+    const_cast<MoBVHWideNode<Width>*>(*ppNodes)[nodeIndex] = node;
+    return nodeIndex;
+}
+
+// slab test of every child at once, returns a bit per child hit no further than tFar and writes their entry distances
+template<std::uint32_t Width>
+static std::uint32_t moIntersectChildren(const MoBVHWideNode<Width>& node, const MoRay& ray, float tFar, float* tNear)
+{
+    std::uint32_t mask = 0;
+#if defined(MO_BVH_AVX)
+    if constexpr (Width == 8)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 farthest = _mm256_set1_ps(tFar);
+        __m256 nearest = zero;
+        __m256 farther = farthest;
+        for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+        {
+            const __m256 origin = _mm256_set1_ps(ray.origin[dimension]);
+            const __m256 oneOverDirection = _mm256_set1_ps(ray.oneOverDirection[dimension]);
+            __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.boundingBoxes[dimension]), origin), oneOverDirection);
+            __m256 t2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.boundingBoxes[3 + dimension]), origin), oneOverDirection);
+            nearest = _mm256_max_ps(nearest, _mm256_min_ps(t1, t2));
+            farther = _mm256_min_ps(farther, _mm256_max_ps(t1, t2));
+        }
+        mask = std::uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(nearest, _mm256_mul_ps(farther, _mm256_set1_ps(MO_BVH_SLAB_SCALE)), _CMP_LE_OQ)));
+        _mm256_storeu_ps(tNear, nearest);
+        return mask & ((1u << node.childCount) - 1);
+    }
+#endif
+#if defined(MO_BVH_SSE)
+    const __m128 farthest = _mm_set1_ps(tFar);
+    for (std::uint32_t lane = 0; lane < Width; lane += 4)
+    {
+        __m128 nearest = _mm_setzero_ps();
+        __m128 farther = farthest;
+        for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+        {
+            const __m128 origin = _mm_set1_ps(ray.origin[dimension]);
+            const __m128 oneOverDirection = _mm_set1_ps(ray.oneOverDirection[dimension]);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.boundingBoxes[dimension][lane]), origin), oneOverDirection);
+            __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.boundingBoxes[3 + dimension][lane]), origin), oneOverDirection);
+            nearest = _mm_max_ps(nearest, _mm_min_ps(t1, t2));
+            farther = _mm_min_ps(farther, _mm_max_ps(t1, t2));
+        }
+        mask |= std::uint32_t(_mm_movemask_ps(_mm_cmple_ps(nearest, _mm_mul_ps(farther, _mm_set1_ps(MO_BVH_SLAB_SCALE))))) << lane;
+        _mm_storeu_ps(&tNear[lane], nearest);
+    }
+#else
+    for (std::uint32_t lane = 0; lane < Width; ++lane)
+    {
+        float nearest = 0.f;
+        float farther = tFar;
+        for (std::uint32_t dimension = 0; dimension < 3; ++dimension)
+        {
+            float t1 = (node.boundingBoxes[dimension][lane] - ray.origin[dimension]) * ray.oneOverDirection[dimension];
+            float t2 = (node.boundingBoxes[3 + dimension][lane] - ray.origin[dimension]) * ray.oneOverDirection[dimension];
+            nearest = std::max(nearest, std::min(t1, t2));
+            farther = std::min(farther, std::max(t1, t2));
+        }
+        mask |= std::uint32_t(nearest <= farther * MO_BVH_SLAB_SCALE) << lane;
+        tNear[lane] = nearest;
+    }
+#endif
+    return mask & ((1u << node.childCount) - 1);
+}
+
+template<std::uint32_t Width>
+static bool moIntersectBVHWide(MoBVHWide bvhWide, const MoBVHWideNode<Width>* pNodes, const MoRay& ray, MoIntersectResult& intersection, bool backfaceCulling)
+{
+    intersection.distance = std::numeric_limits<float>::max();
+    if (bvhWide->nodeCount == 0)
+    {
+        return false;
+    }
+
+    // Working set
+    struct Traversal
+    {
+        std::uint32_t index;
+        float distance;
+    };
+    Traversal traversal[MO_BVH_STACK_SIZE * Width];
+    std::int32_t stackPtr = 0;
+
+    traversal[stackPtr].index = 0;
+    traversal[stackPtr].distance = std::numeric_limits<float>::lowest();
+
+    MoTriangleTest test;
+    moInitTriangleTest(test, bvhWide->bvh, ray, backfaceCulling);
+
+    while (stackPtr >= 0)
+    {
+        std::uint32_t index = traversal[stackPtr].index;
+        float near = traversal[stackPtr].distance;
+        stackPtr--;
+
+        if (near > intersection.distance)
+        {
+            continue;
+        }
+
+        const MoBVHWideNode<Width>& node = pNodes[index];
+        float tNear[Width];
+        std::uint32_t mask = moIntersectChildren(node, ray, intersection.distance, tNear);
+
+        // leaves are intersected right away, inner children are sorted far to near
+        Traversal hits[Width];
+        std::uint32_t hitCount = 0;
+        for (std::uint32_t lane = 0; lane < Width; ++lane)
+        {
+            if ((mask & (1u << lane)) == 0)
+            {
+                continue;
+            }
+            if (node.count[lane] == 0)
+            {
+                std::uint32_t i = hitCount++;
+                for (; i > 0 && hits[i - 1].distance < tNear[lane]; --i)
+                {
+                    hits[i] = hits[i - 1];
+                }
+                hits[i] = Traversal{node.child[lane], tNear[lane]};
+                continue;
+            }
+            for (std::uint32_t i = node.child[lane]; i < node.child[lane] + node.count[lane]; ++i)
+            {
+                float t, u, v;
+                if (moIntersectTriangle(test, i, t, u, v) && t < intersection.distance)
+                {
+                    moSetIntersectTriangle(bvhWide->bvh, i, intersection);
+                    intersection.barycentric = {1.f - u - v, u, v};
+                    intersection.distance = t;
+                }
+            }
+        }
+        MO_BVH_CHECK_STACK(traversal, stackPtr, hitCount);
+        for (std::uint32_t i = 0; i < hitCount; ++i)
+        {
+            traversal[++stackPtr] = hits[i];
+        }
+    }
+
+    return intersection.distance < std::numeric_limits<float>::max();
+}
+
+void moCreateBVHWide(MoBVH bvh, std::uint32_t width, MoBVHWide* pBVHWide)
+{
+    MoBVHWide bvhWide = *pBVHWide = new MoBVHWide_T();
+    *bvhWide = {};
+
+    bvhWide->bvh = bvh;
+    bvhWide->width = width <= 4 ? 4 : 8;
+    if (bvh->splitNodeCount == 0)
+    {
+        return;
+    }
+
+    if (bvhWide->width == 4)
+    {
+        moCollapseBVH<4>(bvh, 0, &bvhWide->pNodes4, &bvhWide->nodeCount);
+    }
+    else
+    {
+        moCollapseBVH<8>(bvh, 0, &bvhWide->pNodes8, &bvhWide->nodeCount);
+    }
+}
+
+bool moIntersectBVHWide(MoBVHWide bvhWide, const MoRay& ray, MoIntersectResult& intersection, bool backfaceCulling)
+{
+    if (bvhWide->width == 4)
+    {
+        return moIntersectBVHWide<4>(bvhWide, bvhWide->pNodes4, ray, intersection, backfaceCulling);
+    }
+    return moIntersectBVHWide<8>(bvhWide, bvhWide->pNodes8, ray, intersection, backfaceCulling);
+}
+
+void moDestroyBVHWide(MoBVHWide bvhWide)
+{
+    std::uint32_t nodeCount = bvhWide->nodeCount;
+    carray_free(bvhWide->pNodes4, &nodeCount);
+    carray_free(bvhWide->pNodes8, &bvhWide->nodeCount);
+    delete bvhWide;
+}
+
+// world bounds of the instance's root bounds
+static MoBBox moInstanceBoundingBox(const MoBVHInstance& instance)
+{
+    const MoBBox& boundingBox = instance.bvh->pSplitNodes[0].boundingBox;
+    MoBBox worldBoundingBox(mul(instance.model, float4(boundingBox.min, 1.f)).xyz());
+    for (std::uint32_t corner = 1; corner < 8; ++corner)
+    {
+        float3 point((corner & 1) ? boundingBox.max.x : boundingBox.min.x,
+                     (corner & 2) ? boundingBox.max.y : boundingBox.min.y,
+                     (corner & 4) ? boundingBox.max.z : boundingBox.min.z);
+        worldBoundingBox.expandToInclude(mul(instance.model, float4(point, 1.f)).xyz());
+    }
+    return worldBoundingBox;
+}
+
+// recompute every node's bounds from the instances, children always follow their parent in the array
+static void moRefitTopLevelSplitNodes(MoTopLevelBVH topLevelBVH)
+{
+    MoBVHSplitNode* pSplitNodes = const_cast<MoBVHSplitNode*>(topLevelBVH->pSplitNodes);
+    for (std::uint32_t index = topLevelBVH->splitNodeCount; index-- > 0;)
+    {
+        MoBVHSplitNode& node = pSplitNodes[index];
+        if (node.offset == 0)
+        {
+            node.boundingBox = moInstanceBoundingBox(topLevelBVH->pInstances[node.start]);
+            for (std::uint32_t i = node.start + 1; i < node.start + node.count; ++i)
+            {
+                node.boundingBox.expandToInclude(moInstanceBoundingBox(topLevelBVH->pInstances[i]));
+            }
+        }
+        else
+        {
+            node.boundingBox = pSplitNodes[index + 1].boundingBox;
+            node.boundingBox.expandToInclude(pSplitNodes[index + node.offset].boundingBox);
+        }
+    }
+}
+
+void moCreateTopLevelBVH(const MoBVHInstance* pInstances, std::uint32_t instanceCount, MoTopLevelBVH* pTopLevelBVH)
+{
+    MoTopLevelBVH topLevelBVH = *pTopLevelBVH = new MoTopLevelBVH_T();
+    *topLevelBVH = {};
+
+    // binned SAH over the instances' world bounds, one instance per leaf so that each is culled on its own
+    MoBVHBuilder builder = {};
+    builder.createInfo.buildMode = MO_BVH_BUILD_MODE_BINNED_SAH;
+    builder.createInfo.binCount = MO_BVH_DEFAULT_BIN_COUNT;
+    builder.createInfo.maxLeafSize = 1;
+    builder.createInfo.threadCount = 1;
+
+    std::uint32_t indexCount = 0;
+    std::uint32_t boxCount = 0;
+    std::uint32_t centroidCount = 0;
+    for (std::uint32_t i = 0; i < instanceCount; ++i)
+    {
+        if (pInstances[i].bvh && pInstances[i].bvh->splitNodeCount > 0)
+        {
+            MoBBox boundingBox = moInstanceBoundingBox(pInstances[i]);
+            carray_push_back(&builder.pBoxes, &boxCount, boundingBox);
+            carray_push_back(&builder.pCentroids, &centroidCount, (boundingBox.min + boundingBox.max) * 0.5f);
+            carray_push_back(&topLevelBVH->pInstanceIndices, &topLevelBVH->instanceIndexCount, i);
+        }
+    }
+
+    const std::uint32_t count = topLevelBVH->instanceIndexCount;
+    carray_resize(&builder.pIndices, &indexCount, count);
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        builder.pIndices[i] = i;
+    }
+    if (count > 0)
+    {
+        moBuildSubtree(builder, 0, count, 0, &topLevelBVH->pSplitNodes, &topLevelBVH->splitNodeCount);
+    }
+
+    // instances in leaf order, pInstanceIndices maps them back to the caller's order
+    std::vector<std::uint32_t> instanceIndices(topLevelBVH->pInstanceIndices, topLevelBVH->pInstanceIndices + count);
+    carray_resize(&topLevelBVH->pInstances, &topLevelBVH->instanceCount, count);
+    carray_resize(&topLevelBVH->pInverseModels, &topLevelBVH->inverseModelCount, count);
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        std::uint32_t instanceIndex = instanceIndices[builder.pIndices[i]];
+        const_cast<std::uint32_t*>(topLevelBVH->pInstanceIndices)[i] = instanceIndex;
+        const_cast<MoBVHInstance*>(topLevelBVH->pInstances)[i] = pInstances[instanceIndex];
+        const_cast<float4x4*>(topLevelBVH->pInverseModels)[i] = inverse(pInstances[instanceIndex].model);
+    }
+
+    carray_free(builder.pCentroids, &centroidCount);
+    carray_free(builder.pBoxes, &boxCount);
+    carray_free(builder.pIndices, &indexCount);
+}
+
+bool moIntersectTopLevelBVH(MoTopLevelBVH topLevelBVH, const MoRay& ray, MoIntersectResult& intersection, std::uint32_t& instanceIndex, bool backfaceCulling)
+{
+    intersection.distance = std::numeric_limits<float>::max();
+    if (topLevelBVH->splitNodeCount == 0)
+    {
+        return false;
+    }
+
+    // Working set
+    struct Traversal
+    {
+        std::uint32_t index;
+        float distance;
+    };
+    Traversal traversal[MO_BVH_STACK_SIZE];
+    std::int32_t stackPtr = 0;
+
+    traversal[stackPtr].index = 0;
+    traversal[stackPtr].distance = std::numeric_limits<float>::lowest();
+
+    float bbhits[4];
+    while (stackPtr >= 0)
+    {
+        std::uint32_t index = traversal[stackPtr].index;
+        float near = traversal[stackPtr].distance;
+        stackPtr--;
+        const MoBVHSplitNode& node = topLevelBVH->pSplitNodes[index];
+
+        if (near > intersection.distance)
+        {
+            continue;
+        }
+
+        if (node.offset == 0)
+        {
+            for (std::uint32_t i = node.start; i < node.start + node.count; ++i)
+            {
+                // the direction is not normalized so that distances along both rays match
+                const float4x4& inverseModel = topLevelBVH->pInverseModels[i];
+                MoRay objectRay(mul(inverseModel, float4(ray.origin, 1.f)).xyz(), mul(inverseModel, float4(ray.direction, 0.f)).xyz());
+                float distance = intersection.distance;
+                moIntersectNodes(topLevelBVH->pInstances[i].bvh, objectRay, intersection, backfaceCulling);
+                if (intersection.distance < distance)
+                {
+                    instanceIndex = topLevelBVH->pInstanceIndices[i];
+                }
+            }
+            continue;
+        }
+
+        MO_BVH_CHECK_STACK(traversal, stackPtr, 2);
+        Traversal left = {index + 1, 0.f};
+        Traversal right = {index + node.offset, 0.f};
+        bool hitLeft = topLevelBVH->pSplitNodes[left.index].boundingBox.intersect(ray, bbhits[0], bbhits[1]);
+        bool hitRight = topLevelBVH->pSplitNodes[right.index].boundingBox.intersect(ray, bbhits[2], bbhits[3]);
+        left.distance = bbhits[0];
+        right.distance = bbhits[2];
+
+        if (hitLeft && hitRight)
+        {
+            if (right.distance < left.distance)
+            {
+                std::swap(left, right);
+            }
+            traversal[++stackPtr] = right;
+            traversal[++stackPtr] = left;
+        }
+        else if (hitLeft)
+        {
+            traversal[++stackPtr] = left;
+        }
+        else if (hitRight)
+        {
+            traversal[++stackPtr] = right;
+        }
+    }
+    return intersection.distance < std::numeric_limits<float>::max();
+}
+
+void moRefitTopLevelBVH(MoTopLevelBVH topLevelBVH, const float4x4* pModels)
+{
+    for (std::uint32_t i = 0; i < topLevelBVH->instanceCount; ++i)
+    {
+        const float4x4& model = pModels[topLevelBVH->pInstanceIndices[i]];
+        const_cast<MoBVHInstance*>(topLevelBVH->pInstances)[i].model = model;
+        const_cast<float4x4*>(topLevelBVH->pInverseModels)[i] = inverse(model);
+    }
+    moRefitTopLevelSplitNodes(topLevelBVH);
+}
+
+void moDestroyTopLevelBVH(MoTopLevelBVH topLevelBVH)
+{
+    carray_free(topLevelBVH->pSplitNodes, &topLevelBVH->splitNodeCount);
+    carray_free(topLevelBVH->pInstances, &topLevelBVH->instanceCount);
+    carray_free(topLevelBVH->pInverseModels, &topLevelBVH->inverseModelCount);
+    carray_free(topLevelBVH->pInstanceIndices, &topLevelBVH->instanceIndexCount);
+    delete topLevelBVH;
+}
+
+// adapted from Erin Catto's b2DynamicTree in Box2D, using surface areas instead of perimeters
+void moCreateDynamicBVH(const MoDynamicBVHCreateInfo* pCreateInfo, MoDynamicBVH* pDynamicBVH)
+{
+    MoDynamicBVHCreateInfo createInfo = {};
+    if (pCreateInfo)
+    {
+        createInfo = *pCreateInfo;
+    }
+    if (createInfo.margin == 0.f)
+    {
+        createInfo.margin = MO_DYNAMIC_BVH_DEFAULT_MARGIN;
+    }
+
+    MoDynamicBVH dynamicBVH = *pDynamicBVH = new MoDynamicBVH_T();
+    *dynamicBVH = {};
+    dynamicBVH->root = MO_DYNAMIC_BVH_NULL;
+    dynamicBVH->freeNode = MO_DYNAMIC_BVH_NULL;
+    dynamicBVH->margin = createInfo.margin;
+}
+
+static MoBBox moUnion(const MoBBox& a, const MoBBox& b)
+{
+    MoBBox boundingBox = a;
+    boundingBox.expandToInclude(b);
+    return boundingBox;
+}
+
+// nodes are recycled through the free list, growing the array invalidates references to its nodes
+static std::uint32_t moAllocateDynamicNode(MoDynamicBVH dynamicBVH)
+{
+    std::uint32_t index = dynamicBVH->freeNode;
+    if (index == MO_DYNAMIC_BVH_NULL)
+    {
+        index = dynamicBVH->nodeCount;
+        carray_push_back(&dynamicBVH->pNodes, &dynamicBVH->nodeCount, MoDynamicBVHNode{});
+    }
+    else
+    {
+        dynamicBVH->freeNode = dynamicBVH->pNodes[index].parent;
+    }
+
+    MoDynamicBVHNode& node = const_cast<MoDynamicBVHNode&>(dynamicBVH->pNodes[index]);
+    node.parent = MO_DYNAMIC_BVH_NULL;
+    node.left = MO_DYNAMIC_BVH_NULL;
+    node.right = MO_DYNAMIC_BVH_NULL;
+    node.height = 0;
+    return index;
+}
+
+static void moFreeDynamicNode(MoDynamicBVH dynamicBVH, std::uint32_t index)
+{
+    MoDynamicBVHNode& node = const_cast<MoDynamicBVHNode&>(dynamicBVH->pNodes[index]);
+    node.parent = dynamicBVH->freeNode;
+    node.height = -1;
+    dynamicBVH->freeNode = index;
+}
+
+static void moReplaceDynamicChild(MoDynamicBVH dynamicBVH, std::uint32_t parent, std::uint32_t child, std::uint32_t replacement)
+{
+    if (parent == MO_DYNAMIC_BVH_NULL)
+    {
+        dynamicBVH->root = replacement;
+        return;
+    }
+
+    MoDynamicBVHNode& node = const_cast<MoDynamicBVHNode&>(dynamicBVH->pNodes[parent]);
+    if (node.left == child)
+    {
+        node.left = replacement;
+    }
+    else
+    {
+        node.right = replacement;
+    }
+}
+
+// rotates the taller grandchild up when the children's heights differ by more than one, returns the node now at a's place
+static std::uint32_t moBalanceDynamicNode(MoDynamicBVH dynamicBVH, std::uint32_t ia)
+{
+    MoDynamicBVHNode* pNodes = const_cast<MoDynamicBVHNode*>(dynamicBVH->pNodes);
+    MoDynamicBVHNode& a = pNodes[ia];
+    if (a.height < 2)
+    {
+        return ia;
+    }
+
+    const std::uint32_t ib = a.left;
+    const std::uint32_t ic = a.right;
+    MoDynamicBVHNode& b = pNodes[ib];
+    MoDynamicBVHNode& c = pNodes[ic];
+    const std::int32_t balance = c.height - b.height;
+
+    // rotate c up
+    if (balance > 1)
+    {
+        const std::uint32_t iF = c.left;
+        const std::uint32_t iG = c.right;
+        MoDynamicBVHNode& f = pNodes[iF];
+        MoDynamicBVHNode& g = pNodes[iG];
+
+        c.left = ia;
+        c.parent = a.parent;
+        a.parent = ic;
+        moReplaceDynamicChild(dynamicBVH, c.parent, ia, ic);
+
+        // the taller of c's children stays with c, the other goes to a
+        const bool keepF = f.height > g.height;
+        const std::uint32_t iKept = keepF ? iF : iG;
+        const std::uint32_t iMoved = keepF ? iG : iF;
+        MoDynamicBVHNode& kept = pNodes[iKept];
+        MoDynamicBVHNode& moved = pNodes[iMoved];
+        c.right = iKept;
+        a.right = iMoved;
+        moved.parent = ia;
+        a.boundingBox = moUnion(b.boundingBox, moved.boundingBox);
+        c.boundingBox = moUnion(a.boundingBox, kept.boundingBox);
+        a.height = 1 + std::max(b.height, moved.height);
+        c.height = 1 + std::max(a.height, kept.height);
+        return ic;
+    }
+
+    // rotate b up
+    if (balance < -1)
+    {
+        const std::uint32_t iD = b.left;
+        const std::uint32_t iE = b.right;
+        MoDynamicBVHNode& d = pNodes[iD];
+        MoDynamicBVHNode& e = pNodes[iE];
+
+        b.left = ia;
+        b.parent = a.parent;
+        a.parent = ib;
+        moReplaceDynamicChild(dynamicBVH, b.parent, ia, ib);
+
+        const bool keepD = d.height > e.height;
+        const std::uint32_t iKept = keepD ? iD : iE;
+        const std::uint32_t iMoved = keepD ? iE : iD;
+        MoDynamicBVHNode& kept = pNodes[iKept];
+        MoDynamicBVHNode& moved = pNodes[iMoved];
+        b.right = iKept;
+        a.left = iMoved;
+        moved.parent = ia;
+        a.boundingBox = moUnion(c.boundingBox, moved.boundingBox);
+        b.boundingBox = moUnion(a.boundingBox, kept.boundingBox);
+        a.height = 1 + std::max(c.height, moved.height);
+        b.height = 1 + std::max(a.height, kept.height);
+        return ib;
+    }
+
+    return ia;
+}
+
+// balance and refit every ancestor from index up to the root
+static void moRefitDynamicAncestors(MoDynamicBVH dynamicBVH, std::uint32_t index)
+{
+    MoDynamicBVHNode* pNodes = const_cast<MoDynamicBVHNode*>(dynamicBVH->pNodes);
+    while (index != MO_DYNAMIC_BVH_NULL)
+    {
+        index = moBalanceDynamicNode(dynamicBVH, index);
+
+        MoDynamicBVHNode& node = pNodes[index];
+        const MoDynamicBVHNode& left = pNodes[node.left];
+        const MoDynamicBVHNode& right = pNodes[node.right];
+        node.height = 1 + std::max(left.height, right.height);
+        node.boundingBox = moUnion(left.boundingBox, right.boundingBox);
+        index = node.parent;
+    }
+}
+
+// descends toward the sibling that grows the tree's surface area the least, then pairs the leaf with it under a new node
+static void moInsertDynamicLeaf(MoDynamicBVH dynamicBVH, std::uint32_t leaf)
+{
+    if (dynamicBVH->root == MO_DYNAMIC_BVH_NULL)
+    {
+        dynamicBVH->root = leaf;
+        const_cast<MoDynamicBVHNode&>(dynamicBVH->pNodes[leaf]).parent = MO_DYNAMIC_BVH_NULL;
+        return;
+    }
+
+    const MoBBox leafBox = dynamicBVH->pNodes[leaf].boundingBox;
+    std::uint32_t sibling = dynamicBVH->root;
+    while (dynamicBVH->pNodes[sibling].left != MO_DYNAMIC_BVH_NULL)
+    {
+        const MoDynamicBVHNode& node = dynamicBVH->pNodes[sibling];
+        const float area = node.boundingBox.surfaceArea();
+        const float combinedArea = moUnion(node.boundingBox, leafBox).surfaceArea();
+
+        // pairing with this node creates a parent as large as both, descending grows this node instead
+        const float cost = 2.f * combinedArea;
+        const float inheritanceCost = 2.f * (combinedArea - area);
+
+        float childCosts[2];
+        const std::uint32_t children[2] = {node.left, node.right};
+        for (std::uint32_t i = 0; i < 2; ++i)
+        {
+            const MoDynamicBVHNode& child = dynamicBVH->pNodes[children[i]];
+            const float childArea = moUnion(child.boundingBox, leafBox).surfaceArea();
+            childCosts[i] = inheritanceCost + (child.left == MO_DYNAMIC_BVH_NULL ? childArea : childArea - child.boundingBox.surfaceArea());
+        }
+
+        if (cost < childCosts[0] && cost < childCosts[1])
+        {
+            break;
+        }
+        sibling = childCosts[0] < childCosts[1] ? children[0] : children[1];
+    }
+
+    const std::uint32_t parent = moAllocateDynamicNode(dynamicBVH);
+    MoDynamicBVHNode* pNodes = const_cast<MoDynamicBVHNode*>(dynamicBVH->pNodes);
+    const std::uint32_t oldParent = pNodes[sibling].parent;
+    pNodes[parent].parent = oldParent;
+    pNodes[parent].left = sibling;
+    pNodes[parent].right = leaf;
+    pNodes[parent].boundingBox = moUnion(leafBox, pNodes[sibling].boundingBox);
+    pNodes[parent].height = pNodes[sibling].height + 1;
+    moReplaceDynamicChild(dynamicBVH, oldParent, sibling, parent);
+    pNodes[sibling].parent = parent;
+    pNodes[leaf].parent = parent;
+
+    // the new parent pairs a leaf with a subtree of any height, it is the first node that may need a rotation
+    moRefitDynamicAncestors(dynamicBVH, parent);
+}
+
+// the leaf's parent is freed and its sibling takes the parent's place
+static void moRemoveDynamicLeaf(MoDynamicBVH dynamicBVH, std::uint32_t leaf)
+{
+    if (leaf == dynamicBVH->root)
+    {
+        dynamicBVH->root = MO_DYNAMIC_BVH_NULL;
+        return;
+    }
+
+    MoDynamicBVHNode* pNodes = const_cast<MoDynamicBVHNode*>(dynamicBVH->pNodes);
+    const std::uint32_t parent = pNodes[leaf].parent;
+    const std::uint32_t grandParent = pNodes[parent].parent;
+    const std::uint32_t sibling = pNodes[parent].left == leaf ? pNodes[parent].right : pNodes[parent].left;
+
+    moReplaceDynamicChild(dynamicBVH, grandParent, parent, sibling);
+    pNodes[sibling].parent = grandParent;
+    moFreeDynamicNode(dynamicBVH, parent);
+
+    moRefitDynamicAncestors(dynamicBVH, grandParent);
+}
+
+static MoBBox moGrow(const MoBBox& boundingBox, float margin)
+{
+    const float3 extent(margin, margin, margin);
+    return MoBBox(boundingBox.min - extent, boundingBox.max + extent);
+}
+
+std::uint32_t moInsertDynamicBVH(MoDynamicBVH dynamicBVH, const MoBBox& boundingBox)
+{
+    const std::uint32_t leaf = moAllocateDynamicNode(dynamicBVH);
+    const_cast<MoDynamicBVHNode&>(dynamicBVH->pNodes[leaf]).boundingBox = moGrow(boundingBox, dynamicBVH->margin);
+    moInsertDynamicLeaf(dynamicBVH, leaf);
+    ++dynamicBVH->objectCount;
+    return leaf;
+}
+
+void moRemoveDynamicBVH(MoDynamicBVH dynamicBVH, std::uint32_t object)
+{
+    moRemoveDynamicLeaf(dynamicBVH, object);
+    moFreeDynamicNode(dynamicBVH, object);
+    --dynamicBVH->objectCount;
+}
+
+bool moUpdateDynamicBVH(MoDynamicBVH dynamicBVH, std::uint32_t object, const MoBBox& boundingBox)
+{
+    const MoBBox& grown = dynamicBVH->pNodes[object].boundingBox;
+    if (grown.min.x <= boundingBox.min.x && grown.min.y <= boundingBox.min.y && grown.min.z <= boundingBox.min.z
+        && grown.max.x >= boundingBox.max.x && grown.max.y >= boundingBox.max.y && grown.max.z >= boundingBox.max.z)
+    {
+        return false;
+    }
+
+    moRemoveDynamicLeaf(dynamicBVH, object);
+    const_cast<MoDynamicBVHNode&>(dynamicBVH->pNodes[object]).boundingBox = moGrow(boundingBox, dynamicBVH->margin);
+    moInsertDynamicLeaf(dynamicBVH, object);
+    return true;
+}
+
+bool moIntersectDynamicBVH(MoDynamicBVH dynamicBVH, const MoRay& ray, MoIntersectResult& intersection, std::uint32_t& object, MoIntersectObjectFunction intersectObject, void* pUserData)
+{
+    intersection.distance = std::numeric_limits<float>::max();
+    if (dynamicBVH->root == MO_DYNAMIC_BVH_NULL)
+    {
+        return false;
+    }
+
+    // Working set
+    struct Traversal
+    {
+        std::uint32_t index;
+        float distance;
+    };
+    Traversal traversal[MO_BVH_STACK_SIZE];
+    std::int32_t stackPtr = 0;
+
+    float bbhits[4];
+    if (!dynamicBVH->pNodes[dynamicBVH->root].boundingBox.intersect(ray, bbhits[0], bbhits[1]) || bbhits[1] < 0.f)
+    {
+        return false;
+    }
+    traversal[stackPtr].index = dynamicBVH->root;
+    traversal[stackPtr].distance = bbhits[0];
+
+    bool hit = false;
+    while (stackPtr >= 0)
+    {
+        std::uint32_t index = traversal[stackPtr].index;
+        float near = traversal[stackPtr].distance;
+        stackPtr--;
+        const MoDynamicBVHNode& node = dynamicBVH->pNodes[index];
+
+        if (near > intersection.distance)
+        {
+            continue;
+        }
+
+        if (node.left == MO_DYNAMIC_BVH_NULL)
+        {
+            if (intersectObject(index, ray, intersection, pUserData))
+            {
+                object = index;
+                hit = true;
+            }
+            continue;
+        }
+
+        MO_BVH_CHECK_STACK(traversal, stackPtr, 2);
+        std::uint32_t closer = node.left;
+        std::uint32_t other = node.right;
+        bool hitLeft = dynamicBVH->pNodes[closer].boundingBox.intersect(ray, bbhits[0], bbhits[1]) && bbhits[1] >= 0.f;
+        bool hitRight = dynamicBVH->pNodes[other].boundingBox.intersect(ray, bbhits[2], bbhits[3]) && bbhits[3] >= 0.f;
+        if (hitLeft && hitRight)
+        {
+            if (bbhits[2] < bbhits[0])
+            {
+                std::swap(bbhits[0], bbhits[2]);
+                std::swap(closer, other);
+            }
+
+            ++stackPtr;
+            traversal[stackPtr] = Traversal{other, bbhits[2]};
+            ++stackPtr;
+            traversal[stackPtr] = Traversal{closer, bbhits[0]};
+        }
+        else if (hitLeft)
+        {
+            ++stackPtr;
+            traversal[stackPtr] = Traversal{closer, bbhits[0]};
+        }
+        else if (hitRight)
+        {
+            ++stackPtr;
+            traversal[stackPtr] = Traversal{other, bbhits[2]};
+        }
+    }
+    return hit;
+}
+
+std::uint32_t moOverlapDynamicBVH(MoDynamicBVH dynamicBVH, const MoBBox& boundingBox, std::uint32_t* pObjects, std::uint32_t objectCapacity)
+{
+    if (dynamicBVH->root == MO_DYNAMIC_BVH_NULL)
+    {
+        return 0;
+    }
+
+    std::uint32_t objectCount = 0;
+    std::uint32_t traversal[MO_BVH_STACK_SIZE];
+    std::int32_t stackPtr = 0;
+    traversal[stackPtr] = dynamicBVH->root;
+
+    while (stackPtr >= 0)
+    {
+        std::uint32_t index = traversal[stackPtr];
+        stackPtr--;
+        const MoDynamicBVHNode& node = dynamicBVH->pNodes[index];
+
+        if (!moOverlaps(node.boundingBox, boundingBox))
+        {
+            continue;
+        }
+
+        if (node.left == MO_DYNAMIC_BVH_NULL)
+        {
+            if (objectCount < objectCapacity)
+            {
+                pObjects[objectCount] = index;
+            }
+            ++objectCount;
+            continue;
+        }
+
+        MO_BVH_CHECK_STACK(traversal, stackPtr, 2);
+        ++stackPtr;
+        traversal[stackPtr] = node.right;
+        ++stackPtr;
+        traversal[stackPtr] = node.left;
+    }
+    return objectCount;
+}
+
+void moDestroyDynamicBVH(MoDynamicBVH dynamicBVH)
+{
+    carray_free(dynamicBVH->pNodes, &dynamicBVH->nodeCount);
+    delete dynamicBVH;
+}
+
 /*
 ------------------------------------------------------------------------------
 This software is available under 2 licenses -- choose whichever you prefer.
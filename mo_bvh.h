@@ -1,6 +1,7 @@
 #pragma once
 
 #include <linalg.h>
+#include <cstddef>
 #include <iosfwd>
 
 class MoRay
@@ -25,6 +26,7 @@ public:
     MoBBox(const linalg::aliases::float3& point);
 
     std::uint32_t longestSide() const;
+    float surfaceArea() const;
     bool intersect(const MoRay& ray, float& t_near, float& t_far) const;
     void expandToInclude(const linalg::aliases::float3& point);
     void expandToInclude(const MoBBox& box);
@@ -53,35 +55,424 @@ struct MoTriangle
     alignas(16) linalg::aliases::float3 v2;
 };
 
+// maps a triangle onto the unit triangle, rows of the inverse of [edge1 edge2 normal v0]
+struct MoTriangleTransform
+{
+    alignas(16) linalg::aliases::float4 m0;
+    alignas(16) linalg::aliases::float4 m1;
+    alignas(16) linalg::aliases::float4 m2;
+};
+
+typedef enum MoBVHTriangleFormat {
+    // three vertices, Möller–Trumbore test with a fixed epsilon
+    MO_BVH_TRIANGLE_FORMAT_VERTICES   = 0,
+    // three vertices, watertight test that loses no hits along edges shared by two triangles
+    MO_BVH_TRIANGLE_FORMAT_WATERTIGHT = 1,
+    // a precomputed MoTriangleTransform per triangle as well, fewest instructions per test
+    MO_BVH_TRIANGLE_FORMAT_TRANSFORM  = 2,
+    MO_BVH_TRIANGLE_FORMAT_MAX_ENUM   = 0x7FFFFFFF
+} MoBVHTriangleFormat;
+
+typedef enum MoBVHTriangleStorage {
+    // a MoTriangle copy of every triangle in pTriangles
+    MO_BVH_TRIANGLE_STORAGE_COPY     = 0,
+    // no pTriangles, the mesh's indices are reordered in leaf order and referenced with its vertices
+    MO_BVH_TRIANGLE_STORAGE_INDEXED  = 1,
+    MO_BVH_TRIANGLE_STORAGE_MAX_ENUM = 0x7FFFFFFF
+} MoBVHTriangleStorage;
+
 struct MoBVHSplitNode
 {
     MoBBox        boundingBox;
+    // leaves: first triangle of the range, 0 otherwise
     std::uint32_t start;
+    // offset to the right child, the left child is always next, 0 for leaves
     std::uint32_t offset;
+    // leaves: number of triangles in the range, 0 otherwise
+    std::uint32_t count;
+};
+
+typedef enum MoBVHNodeFormat {
+    // MoBVHSplitNode only, float bounds
+    MO_BVH_NODE_FORMAT_FLOAT        = 0,
+    // MoBVHQuantizedNode16 as well, bounds quantized to 16 bits inside the parent's
+    MO_BVH_NODE_FORMAT_QUANTIZED_16 = 1,
+    // MoBVHQuantizedNode8 as well, bounds quantized to 8 bits inside the parent's
+    MO_BVH_NODE_FORMAT_QUANTIZED_8  = 2,
+    MO_BVH_NODE_FORMAT_MAX_ENUM     = 0x7FFFFFFF
+} MoBVHNodeFormat;
+
+// pSplitNodes with bounds quantized inside the parent's dequantized bounds, rounded outwards
+// the root is quantized inside pSplitNodes[0].boundingBox
+template<typename T>
+struct MoBVHQuantizedNode
+{
+    T             min[3];
+    T             max[3];
+    // leaves: first triangle of the range, otherwise offset to the right child
+    std::uint32_t index;
+    // leaves: number of triangles in the range, 0 otherwise
+    std::uint32_t count;
 };
+typedef MoBVHQuantizedNode<std::uint8_t> MoBVHQuantizedNode8;
+typedef MoBVHQuantizedNode<std::uint16_t> MoBVHQuantizedNode16;
 
 typedef struct MoBVH_T
 {
+    // MO_BVH_TRIANGLE_STORAGE_COPY only, triangleCount is set for both storages
     const MoTriangle*     pTriangles;
     std::uint32_t         triangleCount;
     const MoBVHSplitNode* pSplitNodes;
     std::uint32_t         splitNodeCount;
+    // three source vertex indices per triangle, in pTriangles order
+    // MO_BVH_TRIANGLE_STORAGE_INDEXED: the mesh's pIndices, not owned
+    const std::uint32_t*  pTriangleIndices;
+    std::uint32_t         triangleIndexCount;
+    // mesh triangle every triangle was built from, in pTriangles order, spatial splits build several triangles from one
+    const std::uint32_t*  pSourceTriangles;
+    std::uint32_t         sourceTriangleCount;
+    MoBVHTriangleStorage  triangleStorage;
+    // MO_BVH_TRIANGLE_STORAGE_INDEXED only, the vertices given to moCreateBVH or the last moRefitBVH, not owned
+    const linalg::aliases::float3* pVertices;
+    MoBVHTriangleFormat   triangleFormat;
+    // MO_BVH_TRIANGLE_FORMAT_TRANSFORM only, in pTriangles order
+    const MoTriangleTransform* pTriangleTransforms;
+    std::uint32_t         triangleTransformCount;
+    // nodes traversed by moIntersectBVH, pQuantizedNodes8 or pQuantizedNodes16 are in pSplitNodes order
+    MoBVHNodeFormat       nodeFormat;
+    const MoBVHQuantizedNode8*  pQuantizedNodes8;
+    const MoBVHQuantizedNode16* pQuantizedNodes16;
+    std::uint32_t         quantizedNodeCount;
+    // moLoadBVH only, the arrays above point into this copy on write mapping of the cache file
+    const void*           pMapping;
+    std::size_t           mappingSize;
 }* MoBVH;
 
 struct MoIntersectResult
 {
+    // MO_BVH_TRIANGLE_STORAGE_COPY only, nullptr otherwise
     const MoTriangle* pTriangle;
+    // in pTriangleIndices order, see moGetBVHTriangle
+    std::uint32_t triangleIndex;
+    // in the order of the mesh indices given to moCreateBVH, see pSourceTriangles
+    std::uint32_t sourceTriangleIndex;
     linalg::aliases::float3 barycentric;
     float distance;
 };
 
+typedef enum MoBVHBuildMode {
+    // binned surface area heuristic, better trees for a slower build
+    MO_BVH_BUILD_MODE_BINNED_SAH     = 0,
+    // split at the middle of the longest side
+    MO_BVH_BUILD_MODE_MIDPOINT       = 1,
+    // split sorted Morton codes of the centroids, lowest quality but linear time, meant for frequent rebuilds
+    MO_BVH_BUILD_MODE_LBVH           = 2,
+    // binned surface area heuristic that also splits triangles straddling a plane, the best trees and the slowest build
+    // a triangle can be stored in several leaves, up to spatialSplitBudget extra copies, so triangleCount can exceed the mesh's
+    // and a hit's triangleIndex names one copy, its sourceTriangleIndex the mesh triangle
+    // builds on the calling thread, MO_BVH_TRIANGLE_STORAGE_INDEXED falls back to MO_BVH_BUILD_MODE_BINNED_SAH
+    MO_BVH_BUILD_MODE_SPATIAL_SPLITS = 3,
+    MO_BVH_BUILD_MODE_MAX_ENUM       = 0x7FFFFFFF
+} MoBVHBuildMode;
+
+#define MO_BVH_DEFAULT_BIN_COUNT 16
+#define MO_BVH_MAX_BIN_COUNT 64
+#define MO_BVH_DEFAULT_MAX_LEAF_SIZE 4
+#define MO_BVH_DEFAULT_SPATIAL_SPLIT_BUDGET 30
+
+typedef struct MoBVHCreateInfo {
+    MoBVHBuildMode buildMode;
+    // number of buckets per axis used by MO_BVH_BUILD_MODE_BINNED_SAH and MO_BVH_BUILD_MODE_SPATIAL_SPLITS, 0 means MO_BVH_DEFAULT_BIN_COUNT
+    std::uint32_t  binCount;
+    // largest number of triangles a leaf may hold, 0 means MO_BVH_DEFAULT_MAX_LEAF_SIZE
+    std::uint32_t  maxLeafSize;
+    // threads used to build, 0 means std::thread::hardware_concurrency() and 1 builds on the calling thread
+    std::uint32_t  threadCount;
+    // Morton code size used by MO_BVH_BUILD_MODE_LBVH, 30 or 63 bits, 0 picks 63 above a million triangles
+    std::uint32_t  mortonCodeBits;
+    // triangle test used by the traversal, MO_BVH_TRIANGLE_FORMAT_TRANSFORM also stores pTriangleTransforms
+    MoBVHTriangleFormat triangleFormat;
+    // MO_BVH_NODE_FORMAT_QUANTIZED_* also stores quantized nodes, the ones uploaded to the GPU
+    MoBVHNodeFormat     nodeFormat;
+    // MO_BVH_TRIANGLE_STORAGE_INDEXED reorders the mesh's pIndices, which must outlive the BVH along with its pVertices
+    MoBVHTriangleStorage triangleStorage;
+    // MO_BVH_BUILD_MODE_SPATIAL_SPLITS only, triangle copies allowed in percent of the triangle count, 0 means MO_BVH_DEFAULT_SPATIAL_SPLIT_BUDGET
+    std::uint32_t       spatialSplitBudget;
+} MoBVHCreateInfo;
+
+// entries of the traversal stacks, here and in raytrace.h, a tree deeper than MO_BVH_STACK_SIZE - 1 levels overflows them
+#define MO_BVH_STACK_SIZE 64
+
 bool moRayTriangleIntersect(const MoRay& ray, const MoTriangle& triangle, float &t, float &u, float &v, bool backfaceCulling = false);
+bool moRayTriangleIntersect(const MoRay& ray, const MoTriangleTransform& transform, float &t, float &u, float &v, bool backfaceCulling = false);
+bool moRayTriangleIntersectWatertight(const MoRay& ray, const MoTriangle& triangle, float &t, float &u, float &v, bool backfaceCulling = false);
+// triangle at index in pTriangleIndices order, for either triangle storage
+MoTriangle moGetBVHTriangle(MoBVH bvh, std::uint32_t index);
 bool moIntersectBVH(MoBVH bvh, const MoRay& ray, MoIntersectResult& intersection, bool backfaceCulling = false);
+// any hit between tMin and tMax, cheaper than moIntersectBVH for shadow and line of sight tests
+bool moOccludedBVH(MoBVH bvh, const MoRay& ray, float tMax, float tMin = 0.f, bool backfaceCulling = false);
+
+#define MO_BVH_STATS_MAX_DEPTH 64
+#define MO_BVH_STATS_MAX_LEAF_SIZE 16
+
+typedef struct MoBVHStats {
+    // SAH cost relative to the root's surface area, visiting a node and testing a triangle cost 1 each
+    float         sahCost;
+    // surface area of the intersection of every inner node's children relative to the root's, 0 for disjoint children
+    float         overlap;
+    std::uint32_t splitNodeCount;
+    std::uint32_t leafCount;
+    std::uint32_t maxDepth;
+    // leaves per depth, the last entry counts the deeper ones as well
+    std::uint32_t depthHistogram[MO_BVH_STATS_MAX_DEPTH];
+    // leaves per triangle count, the last entry counts the larger ones as well
+    std::uint32_t leafSizeHistogram[MO_BVH_STATS_MAX_LEAF_SIZE + 1];
+    // owned by the BVH or mapped from its cache file, the borrowed vertices and indices of MO_BVH_TRIANGLE_STORAGE_INDEXED are left out
+    std::size_t   memorySize;
+} MoBVHStats;
+
+void moGetBVHStats(MoBVH bvh, MoBVHStats* pStats);
+
+// work done by moIntersectBVH on the calling thread, counted only when mo_bvh.cpp is compiled with MO_BVH_TRAVERSAL_STATS
+typedef struct MoBVHTraversalStats {
+    std::uint64_t queryCount;
+    std::uint64_t nodesVisited;
+    std::uint64_t boxTests;
+    std::uint64_t triangleTests;
+    // deepest the traversal stack got out of its MO_BVH_STACK_SIZE entries
+    std::uint32_t stackHighWater;
+} MoBVHTraversalStats;
+
+// counters of the calling thread since its last reset, all zero without MO_BVH_TRAVERSAL_STATS
+MoBVHTraversalStats moGetBVHTraversalStats();
+void moResetBVHTraversalStats();
+// adds the counters of another thread to pTotal
+void moAccumulateBVHTraversalStats(const MoBVHTraversalStats& stats, MoBVHTraversalStats* pTotal);
+
+#define MO_RAY_PACKET_MAX_SIZE 16
+// up to 16 coherent rays stored per component, rays whose bit is cleared in activeMask are skipped
+typedef struct MoRayPacket {
+    float         originX[MO_RAY_PACKET_MAX_SIZE];
+    float         originY[MO_RAY_PACKET_MAX_SIZE];
+    float         originZ[MO_RAY_PACKET_MAX_SIZE];
+    float         directionX[MO_RAY_PACKET_MAX_SIZE];
+    float         directionY[MO_RAY_PACKET_MAX_SIZE];
+    float         directionZ[MO_RAY_PACKET_MAX_SIZE];
+    std::uint32_t rayCount;
+    std::uint32_t activeMask;
+} MoRayPacket;
+
+// closest hit of every active ray, the packet shares node fetches until too few of its rays remain and then continues ray by ray
+// pIntersections holds rayCount results, returns a bit per ray that hit
+std::uint32_t moIntersectBVHPacket(MoBVH bvh, const MoRayPacket& packet, MoIntersectResult* pIntersections, bool backfaceCulling = false);
 
 typedef struct MoMesh_T* MoMesh;
-void moCreateBVH(MoMesh mesh, MoBVH *pBVH);
+// build a BVH over the mesh's triangles, pCreateInfo may be null to use the defaults
+void moCreateBVH(MoMesh mesh, const MoBVHCreateInfo* pCreateInfo, MoBVH *pBVH);
+// ranges of pTriangles, pTriangleTransforms, pSplitNodes and quantized nodes modified by moRefitBVH, counts are 0 when nothing changed
+typedef struct MoBVHRefitInfo {
+    std::uint32_t firstTriangle;
+    std::uint32_t triangleCount;
+    std::uint32_t firstSplitNode;
+    std::uint32_t splitNodeCount;
+} MoBVHRefitInfo;
+
+// threads kept waiting between batches, so that a batch does not start and join its own
+typedef struct MoBVHWorkerPool_T* MoBVHWorkerPool;
+
+// threadCount counts the calling thread, 0 means std::thread::hardware_concurrency()
+void moCreateBVHWorkerPool(std::uint32_t threadCount, MoBVHWorkerPool* pWorkerPool);
+void moDestroyBVHWorkerPool(MoBVHWorkerPool workerPool);
+
+typedef struct MoBVHBatchInfo {
+    // threads used to trace, 0 means std::thread::hardware_concurrency() and 1 traces on the calling thread
+    std::uint32_t threadCount;
+    // optional, traces on the pool's threads instead of starting threadCount threads, which is then ignored, one batch at a time per pool
+    MoBVHWorkerPool workerPool;
+    // trace the rays ordered by a Morton code of their origin and direction so that consecutive rays visit the same nodes
+    bool          sortRays;
+    bool          backfaceCulling;
+} MoBVHBatchInfo;
+
+// closest hit of every ray written to pIntersections in the order of pRays, pBatchInfo may be null to use the defaults
+// returns the number of rays that hit
+std::uint32_t moIntersectBVHBatch(MoBVH bvh, const MoRay* pRays, std::uint32_t rayCount, MoIntersectResult* pIntersections, const MoBVHBatchInfo* pBatchInfo = nullptr);
+
+// nearest point of the surface within maxDistance, barycentric locates it on the triangle and distance is the euclidean distance to it
+bool moClosestPointBVH(MoBVH bvh, const linalg::aliases::float3& point, float maxDistance, MoIntersectResult& result);
+// moClosestPointBVH of every point written to pResults in the order of pPoints, sortRays orders the points along a Morton curve
+// returns the number of points with a surface within maxDistance
+std::uint32_t moClosestPointBVHBatch(MoBVH bvh, const linalg::aliases::float3* pPoints, std::uint32_t pointCount, float maxDistance, MoIntersectResult* pResults, const MoBVHBatchInfo* pBatchInfo = nullptr);
+
+// segment from p0 to p1 inflated by radius, a sphere when both ends are equal
+typedef struct MoCapsule {
+    linalg::aliases::float3 p0;
+    linalg::aliases::float3 p1;
+    float                   radius;
+} MoCapsule;
+
+struct MoSweepResult
+{
+    // MO_BVH_TRIANGLE_STORAGE_COPY only, nullptr otherwise
+    const MoTriangle* pTriangle;
+    // in pTriangleIndices order, see moGetBVHTriangle
+    std::uint32_t triangleIndex;
+    // in the order of the mesh indices given to moCreateBVH, see pSourceTriangles
+    std::uint32_t sourceTriangleIndex;
+    // contact point on the triangle, the normal points from it toward the shape
+    linalg::aliases::float3 position;
+    linalg::aliases::float3 normal;
+    // travelled along the direction until the first contact, 0 when the shape starts overlapping the mesh
+    float distance;
+};
+
+struct MoContact
+{
+    // MO_BVH_TRIANGLE_STORAGE_COPY only, nullptr otherwise
+    const MoTriangle* pTriangle;
+    // in pTriangleIndices order, see moGetBVHTriangle
+    std::uint32_t triangleIndex;
+    // in the order of the mesh indices given to moCreateBVH, see pSourceTriangles
+    std::uint32_t sourceTriangleIndex;
+    // closest point of the triangle, the normal points from it toward the shape
+    linalg::aliases::float3 position;
+    linalg::aliases::float3 normal;
+    // distance to move the shape along normal to resolve the contact
+    float depth;
+};
+
+// first contact of the shape moving along direction within maxDistance, direction must be normalized
+// both sides of the triangles collide
+bool moSphereCastBVH(MoBVH bvh, const linalg::aliases::float3& center, float radius, const linalg::aliases::float3& direction, float maxDistance, MoSweepResult& result);
+bool moCapsuleCastBVH(MoBVH bvh, const MoCapsule& capsule, const linalg::aliases::float3& direction, float maxDistance, MoSweepResult& result);
+// every mesh triangle touching the capsule, once even when spatial splits copied it
+// up to contactCapacity are written to pContacts, returns the number of triangles touching it
+std::uint32_t moOverlapCapsuleBVH(MoBVH bvh, const MoCapsule& capsule, MoContact* pContacts, std::uint32_t contactCapacity);
+
+// update the triangles and node bounds after the source vertices moved, the topology is kept as is
+// MO_BVH_TRIANGLE_STORAGE_INDEXED keeps no copy to compare against, so every node is refit and pVertices is referenced from then on
+void moRefitBVH(MoBVH bvh, const linalg::aliases::float3* pVertices, MoBVHRefitInfo* pRefitInfo = nullptr);
 void moDestroyBVH(MoBVH bvh);
 
+// content hash of the mesh's indices and vertices and of the build options, computed before moCreateBVH reorders anything
+std::uint64_t moHashBVHSource(MoMesh mesh, const MoBVHCreateInfo* pCreateInfo);
+// write the BVH to a cache file stamped with sourceHash, returns false when the file cannot be written
+bool moSaveBVH(MoBVH bvh, std::uint64_t sourceHash, const char* pPath);
+// memory map a cache file written by moSaveBVH instead of building, returns false when it is missing, truncated or stamped with another hash
+// MO_BVH_TRIANGLE_STORAGE_INDEXED reorders the mesh's pIndices as moCreateBVH would
+bool moLoadBVH(MoMesh mesh, std::uint64_t sourceHash, const char* pPath, MoBVH* pBVH);
+
+// up to Width children per node, bounds are stored per axis so that every child is tested at once
+template<std::uint32_t Width>
+struct MoBVHWideNode
+{
+    // min x, y, z then max x, y, z of every child
+    float         boundingBoxes[6][Width];
+    // leaves: first triangle of the range, otherwise index of the child node
+    std::uint32_t child[Width];
+    // leaves: number of triangles in the range, 0 otherwise
+    std::uint32_t count[Width];
+    // children are packed at the front
+    std::uint32_t childCount;
+};
+typedef MoBVHWideNode<4> MoBVH4Node;
+typedef MoBVHWideNode<8> MoBVH8Node;
+
+typedef struct MoBVHWide_T
+{
+    // triangles are shared with the binary BVH it was collapsed from
+    MoBVH             bvh;
+    std::uint32_t     width;
+    // pNodes4 when width is 4, pNodes8 when width is 8
+    const MoBVH4Node* pNodes4;
+    const MoBVH8Node* pNodes8;
+    std::uint32_t     nodeCount;
+}* MoBVHWide;
+
+// collapse a binary BVH into a 4 or 8 wide BVH for SIMD traversal on the CPU, the binary BVH must outlive it
+// the binary layout remains the one uploaded to the GPU, collapse again after moRefitBVH
+void moCreateBVHWide(MoBVH bvh, std::uint32_t width, MoBVHWide* pBVHWide);
+bool moIntersectBVHWide(MoBVHWide bvhWide, const MoRay& ray, MoIntersectResult& intersection, bool backfaceCulling = false);
+void moDestroyBVHWide(MoBVHWide bvhWide);
+
+typedef struct MoBVHInstance {
+    // object to world transform, affine
+    linalg::aliases::float4x4 model;
+    MoBVH                     bvh;
+} MoBVHInstance;
+
+// BVH over instances of bottom level BVHs, rays are transformed into each instance's object space
+typedef struct MoTopLevelBVH_T
+{
+    // leaves cover ranges of pInstances
+    const MoBVHSplitNode*      pSplitNodes;
+    std::uint32_t              splitNodeCount;
+    // instances with triangles, in leaf order
+    const MoBVHInstance*       pInstances;
+    std::uint32_t              instanceCount;
+    // world to object transforms, in pInstances order
+    const linalg::aliases::float4x4* pInverseModels;
+    std::uint32_t              inverseModelCount;
+    // index of every instance in the array given to moCreateTopLevelBVH
+    const std::uint32_t*       pInstanceIndices;
+    std::uint32_t              instanceIndexCount;
+}* MoTopLevelBVH;
+
+// instances without triangles are left out, the array may be freed after the call
+void moCreateTopLevelBVH(const MoBVHInstance* pInstances, std::uint32_t instanceCount, MoTopLevelBVH* pTopLevelBVH);
+// closest hit of every instance, distance is along the world ray and instanceIndex is the index given to moCreateTopLevelBVH
+bool moIntersectTopLevelBVH(MoTopLevelBVH topLevelBVH, const MoRay& ray, MoIntersectResult& intersection, std::uint32_t& instanceIndex, bool backfaceCulling = false);
+// update the transforms and node bounds after instances moved or their BVHs were refit, pModels in the order given to moCreateTopLevelBVH
+void moRefitTopLevelBVH(MoTopLevelBVH topLevelBVH, const linalg::aliases::float4x4* pModels);
+void moDestroyTopLevelBVH(MoTopLevelBVH topLevelBVH);
+
+#define MO_DYNAMIC_BVH_NULL 0xffffffff
+#define MO_DYNAMIC_BVH_DEFAULT_MARGIN 0.1f
+
+// leaves are allocated once per object and keep their index until removed, inner nodes move during rotations
+typedef struct MoDynamicBVHNode {
+    // leaves: the object's bounds grown by the margin
+    MoBBox        boundingBox;
+    // MO_DYNAMIC_BVH_NULL for the root, next free node for free nodes
+    std::uint32_t parent;
+    // MO_DYNAMIC_BVH_NULL for leaves
+    std::uint32_t left;
+    std::uint32_t right;
+    // 0 for leaves, -1 for free nodes
+    std::int32_t  height;
+} MoDynamicBVHNode;
+
+// objects added, moved and removed one at a time, the tree is kept height balanced with rotations
+typedef struct MoDynamicBVH_T
+{
+    const MoDynamicBVHNode* pNodes;
+    std::uint32_t           nodeCount;
+    std::uint32_t           root;
+    std::uint32_t           freeNode;
+    std::uint32_t           objectCount;
+    float                   margin;
+}* MoDynamicBVH;
+
+typedef struct MoDynamicBVHCreateInfo {
+    // added to every side of the objects' bounds so that small moves leave the tree untouched, 0 means MO_DYNAMIC_BVH_DEFAULT_MARGIN
+    float margin;
+} MoDynamicBVHCreateInfo;
+
+// traces the ray against the object, on a hit closer than intersection.distance it lowers it and returns true
+typedef bool (*MoIntersectObjectFunction)(std::uint32_t object, const MoRay& ray, MoIntersectResult& intersection, void* pUserData);
+
+void moCreateDynamicBVH(const MoDynamicBVHCreateInfo* pCreateInfo, MoDynamicBVH* pDynamicBVH);
+// returns the object's handle, the index of its leaf
+std::uint32_t moInsertDynamicBVH(MoDynamicBVH dynamicBVH, const MoBBox& boundingBox);
+void moRemoveDynamicBVH(MoDynamicBVH dynamicBVH, std::uint32_t object);
+// reinserts the object only when its bounds left its grown bounds, returns true when the tree changed
+bool moUpdateDynamicBVH(MoDynamicBVH dynamicBVH, std::uint32_t object, const MoBBox& boundingBox);
+// closest hit of the objects whose grown bounds the ray enters, object is set to the one hit
+bool moIntersectDynamicBVH(MoDynamicBVH dynamicBVH, const MoRay& ray, MoIntersectResult& intersection, std::uint32_t& object, MoIntersectObjectFunction intersectObject, void* pUserData);
+// objects whose grown bounds overlap boundingBox, up to objectCapacity are written to pObjects, returns the number of them
+std::uint32_t moOverlapDynamicBVH(MoDynamicBVH dynamicBVH, const MoBBox& boundingBox, std::uint32_t* pObjects, std::uint32_t objectCapacity);
+void moDestroyDynamicBVH(MoDynamicBVH dynamicBVH);
+
 /*
 ------------------------------------------------------------------------------
 This software is available under 2 licenses -- choose whichever you prefer.
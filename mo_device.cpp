@@ -92,6 +92,10 @@ void moCreateDevice(MoDeviceCreateInfo *pCreateInfo, MoDevice *pDevice)
         err = vkEnumeratePhysicalDevices(pCreateInfo->instance, &count, gpus.data());
         pCreateInfo->pCheckVkResultFn(err);
         device->physicalDevice = gpus[0];
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device->physicalDevice, &properties);
+        device->nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
     }
 
     {
@@ -158,6 +162,21 @@ void moCreateDevice(MoDeviceCreateInfo *pCreateInfo, MoDevice *pDevice)
         pCreateInfo->pCheckVkResultFn(err);
     }
 
+    {
+        VkCommandPoolCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        info.queueFamilyIndex = device->queueFamily;
+        err = vkCreateCommandPool(device->device, &info, VK_NULL_HANDLE, &device->uploadCommandPool);
+        pCreateInfo->pCheckVkResultFn(err);
+    }
+    {
+        VkFenceCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        err = vkCreateFence(device->device, &info, VK_NULL_HANDLE, &device->uploadFence);
+        pCreateInfo->pCheckVkResultFn(err);
+    }
+
     if (pCreateInfo->surface != VK_NULL_HANDLE)
     {
         // Check for WSI support
@@ -210,6 +229,9 @@ void moCreateDevice(MoDeviceCreateInfo *pCreateInfo, MoDevice *pDevice)
 
 void moDestroyDevice(MoDevice device)
 {
+    moFreeMemoryBlocks();
+    vkDestroyFence(device->device, device->uploadFence, VK_NULL_HANDLE);
+    vkDestroyCommandPool(device->device, device->uploadCommandPool, VK_NULL_HANDLE);
     vkDestroyDescriptorPool(device->device, device->descriptorPool, VK_NULL_HANDLE);
     vkDestroyDevice(device->device, VK_NULL_HANDLE);
     delete device;
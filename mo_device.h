@@ -26,7 +26,11 @@ typedef struct MoDevice_T {
     uint32_t         queueFamily;
     VkQueue          queue;
     VkDescriptorPool descriptorPool;
+    // upload batches, see moBeginUploadBatch, one batch is submitted at a time
+    VkCommandPool    uploadCommandPool;
+    VkFence          uploadFence;
     VkDeviceSize     memoryAlignment;
+    VkDeviceSize     nonCoherentAtomSize;
     void           (*pCheckVkResultFn)(VkResult err);
 }* MoDevice;
 
@@ -6,33 +6,158 @@
 #include "mo_dispatch.h"
 #include "mo_swapchain.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <vector>
 
 using namespace linalg;
 using namespace linalg::aliases;
 
 extern MoDevice g_Device;
 
+// the quantized nodes follow the root bounds they are relative to, see moLoadBVHSplitNode in raytrace.h
+static VkDeviceSize moBVHNodesSize(MoBVH bvh)
+{
+    if (bvh->pQuantizedNodes16)
+    {
+        return sizeof(MoBBox) + sizeof(MoBVHQuantizedNode16) * bvh->quantizedNodeCount;
+    }
+    if (bvh->pQuantizedNodes8)
+    {
+        return sizeof(MoBBox) + sizeof(MoBVHQuantizedNode8) * bvh->quantizedNodeCount;
+    }
+    return sizeof(MoBVHSplitNode) * bvh->splitNodeCount;
+}
+
+// round to the nearest half float, denormals kept and overflow saturating to infinity
+static std::uint16_t moPackHalf(float value)
+{
+    std::uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const std::uint32_t sign = (bits >> 16) & 0x8000;
+    const std::int32_t exponent = std::int32_t((bits >> 23) & 0xFF) - 127 + 15;
+    std::uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            return std::uint16_t(sign);
+        }
+        mantissa = (mantissa | 0x800000) >> (1 - exponent);
+        return std::uint16_t(sign | ((mantissa + 0x1000) >> 13));
+    }
+    if (exponent >= 31)
+    {
+        // NaN stays NaN
+        return std::uint16_t(sign | 0x7C00 | (((bits >> 23) & 0xFF) == 0xFF && mantissa ? 0x200 : 0));
+    }
+    return std::uint16_t(sign | ((std::uint32_t(exponent) << 10) + ((mantissa + 0x1000) >> 13)));
+}
+
+static void moPackSnorm(const float3 & value, std::int8_t packed[4])
+{
+    for (std::uint32_t i = 0; i < 3; ++i)
+    {
+        packed[i] = std::int8_t(std::lround(std::min(std::max(value[i], -1.0f), 1.0f) * 127.0f));
+    }
+    packed[3] = 0;
+}
+
+static void moUploadBVHNodes(MoUploadBatch batch, MoMesh mesh, std::uint32_t firstNode, std::uint32_t nodeCount)
+{
+    const MoBVH bvh = mesh->bvh;
+    if (bvh->pQuantizedNodes16)
+    {
+        moUploadBuffer(batch, mesh->bvhNodesBuffer, 0, sizeof(MoBBox), &bvh->pSplitNodes[0].boundingBox);
+        moUploadBuffer(batch, mesh->bvhNodesBuffer,
+                       sizeof(MoBBox) + sizeof(MoBVHQuantizedNode16) * firstNode,
+                       sizeof(MoBVHQuantizedNode16) * nodeCount,
+                       &bvh->pQuantizedNodes16[firstNode]);
+    }
+    else if (bvh->pQuantizedNodes8)
+    {
+        moUploadBuffer(batch, mesh->bvhNodesBuffer, 0, sizeof(MoBBox), &bvh->pSplitNodes[0].boundingBox);
+        moUploadBuffer(batch, mesh->bvhNodesBuffer,
+                       sizeof(MoBBox) + sizeof(MoBVHQuantizedNode8) * firstNode,
+                       sizeof(MoBVHQuantizedNode8) * nodeCount,
+                       &bvh->pQuantizedNodes8[firstNode]);
+    }
+    else
+    {
+        moUploadBuffer(batch, mesh->bvhNodesBuffer,
+                       sizeof(MoBVHSplitNode) * firstNode,
+                       sizeof(MoBVHSplitNode) * nodeCount,
+                       &bvh->pSplitNodes[firstNode]);
+    }
+}
+
 void moCreateMesh(const MoMeshCreateInfo *pCreateInfo, MoMesh *pMesh)
 {
     MoMesh mesh = *pMesh = new MoMesh_T();
     *mesh = {};
 
+    // every buffer is filled by one submission
+    MoUploadBatch batch;
+    moBeginUploadBatch(&batch);
+
     // runtime
+    mesh->vertexLayout = pCreateInfo->vertexLayout;
     mesh->indexBufferSize = pCreateInfo->indexCount;
     const VkDeviceSize index_size = pCreateInfo->indexCount * sizeof(uint32_t);
-    moCreateBuffer(&mesh->verticesBuffer, pCreateInfo->vertexCount * sizeof(float3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    moCreateBuffer(&mesh->textureCoordsBuffer, pCreateInfo->vertexCount * sizeof(float2), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    moCreateBuffer(&mesh->normalsBuffer, pCreateInfo->vertexCount * sizeof(float3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    moCreateBuffer(&mesh->tangentsBuffer, pCreateInfo->vertexCount * sizeof(float3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    moCreateBuffer(&mesh->bitangentsBuffer, pCreateInfo->vertexCount * sizeof(float3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    moCreateBuffer(&mesh->indexBuffer, index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-    moUploadBuffer(mesh->verticesBuffer, pCreateInfo->vertexCount * sizeof(float3), pCreateInfo->pVertices);
-    moUploadBuffer(mesh->textureCoordsBuffer, pCreateInfo->vertexCount * sizeof(float2), pCreateInfo->pTextureCoords);
-    moUploadBuffer(mesh->normalsBuffer, pCreateInfo->vertexCount * sizeof(float3), pCreateInfo->pNormals);
-    moUploadBuffer(mesh->tangentsBuffer, pCreateInfo->vertexCount * sizeof(float3), pCreateInfo->pTangents);
-    moUploadBuffer(mesh->bitangentsBuffer, pCreateInfo->vertexCount * sizeof(float3), pCreateInfo->pBitangents);
-    moUploadBuffer(mesh->indexBuffer, index_size, pCreateInfo->pIndices);
+    switch (mesh->vertexLayout)
+    {
+    case MO_VERTEX_LAYOUT_INTERLEAVED:
+    {
+        carray_resize(&mesh->pInterleavedVertices, &mesh->interleavedVertexCount, pCreateInfo->vertexCount);
+        MoVertex* vertices = const_cast<MoVertex*>(mesh->pInterleavedVertices);
+        for (uint32_t i = 0; i < pCreateInfo->vertexCount; ++i)
+        {
+            vertices[i].position = pCreateInfo->pVertices[i];
+            vertices[i].textureCoords = pCreateInfo->pTextureCoords[i];
+            vertices[i].normal = pCreateInfo->pNormals[i];
+            vertices[i].tangent = pCreateInfo->pTangents[i];
+            vertices[i].bitangent = pCreateInfo->pBitangents[i];
+        }
+        moCreateBuffer(&mesh->verticesBuffer, pCreateInfo->vertexCount * sizeof(MoVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pCreateInfo->memoryPlacement);
+        moUploadBuffer(batch, mesh->verticesBuffer, 0, pCreateInfo->vertexCount * sizeof(MoVertex), vertices);
+        break;
+    }
+    case MO_VERTEX_LAYOUT_PACKED:
+    {
+        std::vector<MoPackedVertexAttributes> attributes(pCreateInfo->vertexCount);
+        for (uint32_t i = 0; i < pCreateInfo->vertexCount; ++i)
+        {
+            attributes[i].textureCoords[0] = moPackHalf(pCreateInfo->pTextureCoords[i].x);
+            attributes[i].textureCoords[1] = moPackHalf(pCreateInfo->pTextureCoords[i].y);
+            moPackSnorm(pCreateInfo->pNormals[i], attributes[i].normal);
+            moPackSnorm(pCreateInfo->pTangents[i], attributes[i].tangent);
+            moPackSnorm(pCreateInfo->pBitangents[i], attributes[i].bitangent);
+        }
+        // vertices and indices are also the triangles traversed with MO_BVH_TRIANGLE_STORAGE_INDEXED
+        moCreateBuffer(&mesh->verticesBuffer, pCreateInfo->vertexCount * sizeof(float3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, pCreateInfo->memoryPlacement);
+        moCreateBuffer(&mesh->attributesBuffer, pCreateInfo->vertexCount * sizeof(MoPackedVertexAttributes), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pCreateInfo->memoryPlacement);
+        moUploadBuffer(batch, mesh->verticesBuffer, 0, pCreateInfo->vertexCount * sizeof(float3), pCreateInfo->pVertices);
+        moUploadBuffer(batch, mesh->attributesBuffer, 0, pCreateInfo->vertexCount * sizeof(MoPackedVertexAttributes), attributes.data());
+        break;
+    }
+    default:
+        // vertices and indices are also the triangles traversed with MO_BVH_TRIANGLE_STORAGE_INDEXED
+        moCreateBuffer(&mesh->verticesBuffer, pCreateInfo->vertexCount * sizeof(float3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, pCreateInfo->memoryPlacement);
+        moCreateBuffer(&mesh->textureCoordsBuffer, pCreateInfo->vertexCount * sizeof(float2), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pCreateInfo->memoryPlacement);
+        moCreateBuffer(&mesh->normalsBuffer, pCreateInfo->vertexCount * sizeof(float3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pCreateInfo->memoryPlacement);
+        moCreateBuffer(&mesh->tangentsBuffer, pCreateInfo->vertexCount * sizeof(float3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pCreateInfo->memoryPlacement);
+        moCreateBuffer(&mesh->bitangentsBuffer, pCreateInfo->vertexCount * sizeof(float3), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, pCreateInfo->memoryPlacement);
+        moUploadBuffer(batch, mesh->verticesBuffer, 0, pCreateInfo->vertexCount * sizeof(float3), pCreateInfo->pVertices);
+        moUploadBuffer(batch, mesh->textureCoordsBuffer, 0, pCreateInfo->vertexCount * sizeof(float2), pCreateInfo->pTextureCoords);
+        moUploadBuffer(batch, mesh->normalsBuffer, 0, pCreateInfo->vertexCount * sizeof(float3), pCreateInfo->pNormals);
+        moUploadBuffer(batch, mesh->tangentsBuffer, 0, pCreateInfo->vertexCount * sizeof(float3), pCreateInfo->pTangents);
+        moUploadBuffer(batch, mesh->bitangentsBuffer, 0, pCreateInfo->vertexCount * sizeof(float3), pCreateInfo->pBitangents);
+        break;
+    }
+    moCreateBuffer(&mesh->indexBuffer, index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, pCreateInfo->memoryPlacement);
 
     // source
     carray_resize(&mesh->pIndices, &mesh->indexCount, pCreateInfo->indexCount);
@@ -41,16 +166,39 @@ void moCreateMesh(const MoMeshCreateInfo *pCreateInfo, MoMesh *pMesh)
     carray_copy(mesh->pVertices, pCreateInfo->pVertices, pCreateInfo->vertexCount);
 
     // feature
-    moCreateBVH(mesh, &mesh->bvh);
+    if (pCreateInfo->pBVHCachePath)
+    {
+        std::uint64_t sourceHash = moHashBVHSource(mesh, pCreateInfo->pBVHCreateInfo);
+        if (!moLoadBVH(mesh, sourceHash, pCreateInfo->pBVHCachePath, &mesh->bvh))
+        {
+            moCreateBVH(mesh, pCreateInfo->pBVHCreateInfo, &mesh->bvh);
+            moSaveBVH(mesh->bvh, sourceHash, pCreateInfo->pBVHCachePath);
+        }
+    }
+    else
+    {
+        moCreateBVH(mesh, pCreateInfo->pBVHCreateInfo, &mesh->bvh);
+    }
+    // after the build, MO_BVH_TRIANGLE_STORAGE_INDEXED reorders pIndices
+    moUploadBuffer(batch, mesh->indexBuffer, 0, index_size, mesh->pIndices);
     if (mesh->bvh && mesh->bvh->splitNodeCount)
     {
-        VkDeviceSize objectsSize = sizeof(MoTriangle) * mesh->bvh->triangleCount;
-        moCreateBuffer(&mesh->bvhObjectBuffer, objectsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-        moUploadBuffer(mesh->bvhObjectBuffer, objectsSize, mesh->bvh->pTriangles);
+        if (mesh->bvh->pTriangles)
+        {
+            VkDeviceSize objectsSize = sizeof(MoTriangle) * mesh->bvh->triangleCount;
+            moCreateBuffer(&mesh->bvhObjectBuffer, objectsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, pCreateInfo->memoryPlacement);
+            moUploadBuffer(batch, mesh->bvhObjectBuffer, 0, objectsSize, mesh->bvh->pTriangles);
+        }
+        else if (mesh->vertexLayout == MO_VERTEX_LAYOUT_INTERLEAVED)
+        {
+            // MO_BVH_TRIANGLE_STORAGE_INDEXED reads float3 positions, not the interleaved stream
+            VkDeviceSize positionsSize = sizeof(float3) * mesh->vertexCount;
+            moCreateBuffer(&mesh->bvhObjectBuffer, positionsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, pCreateInfo->memoryPlacement);
+            moUploadBuffer(batch, mesh->bvhObjectBuffer, 0, positionsSize, mesh->pVertices);
+        }
 
-        VkDeviceSize nodesSize = sizeof(MoBVHSplitNode) * mesh->bvh->splitNodeCount;
-        moCreateBuffer(&mesh->bvhNodesBuffer, nodesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-        moUploadBuffer(mesh->bvhNodesBuffer, nodesSize, mesh->bvh->pSplitNodes);
+        moCreateBuffer(&mesh->bvhNodesBuffer, moBVHNodesSize(mesh->bvh), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, pCreateInfo->memoryPlacement);
+        moUploadBVHNodes(batch, mesh, 0, mesh->bvh->splitNodeCount);
     }
     else
     {
@@ -58,17 +206,34 @@ void moCreateMesh(const MoMeshCreateInfo *pCreateInfo, MoMesh *pMesh)
         VkDeviceSize size = sizeof(data);
 
         moCreateBuffer(&mesh->bvhObjectBuffer, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-        moUploadBuffer(mesh->bvhObjectBuffer, size, &data);
+        moUploadBuffer(batch, mesh->bvhObjectBuffer, 0, size, &data);
 
         moCreateBuffer(&mesh->bvhNodesBuffer, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-        moUploadBuffer(mesh->bvhNodesBuffer, size, &data);
+        moUploadBuffer(batch, mesh->bvhNodesBuffer, 0, size, &data);
+    }
+    if (mesh->bvh && mesh->bvh->triangleTransformCount)
+    {
+        VkDeviceSize transformsSize = sizeof(MoTriangleTransform) * mesh->bvh->triangleTransformCount;
+        moCreateBuffer(&mesh->bvhTransformsBuffer, transformsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, pCreateInfo->memoryPlacement);
+        moUploadBuffer(batch, mesh->bvhTransformsBuffer, 0, transformsSize, mesh->bvh->pTriangleTransforms);
     }
+    else
+    {
+        uint32_t data[4] = {};
+        VkDeviceSize size = sizeof(data);
+
+        moCreateBuffer(&mesh->bvhTransformsBuffer, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        moUploadBuffer(batch, mesh->bvhTransformsBuffer, 0, size, &data);
+    }
+    moEndUploadBatch(batch);
 
     moDispatchMeshCreated(mesh);
 }
 
 void moRegisterMesh(MoPipelineLayout pipeline, MoMesh mesh)
 {
+    assert(mesh->vertexLayout == pipeline->vertexLayout && "the pipeline layout's pipelines bind other vertex streams");
+
     MoMeshRegistration registration = {};
     registration.pipelineLayout = pipeline->pipelineLayout;
 
@@ -82,16 +247,23 @@ void moRegisterMesh(MoPipelineLayout pipeline, MoMesh mesh)
         g_Device->pCheckVkResultFn(err);
     }
 
-    VkDescriptorBufferInfo desc_buffer[2] = {};
-    desc_buffer[0].buffer = mesh->bvhObjectBuffer->buffer;
+    VkDescriptorBufferInfo desc_buffer[4] = {};
+    MoDeviceBuffer objectBuffer = mesh->bvhObjectBuffer ? mesh->bvhObjectBuffer : mesh->verticesBuffer;
+    desc_buffer[0].buffer = objectBuffer->buffer;
     desc_buffer[0].offset = 0;
-    desc_buffer[0].range = mesh->bvhObjectBuffer->size;
+    desc_buffer[0].range = objectBuffer->size;
     desc_buffer[1].buffer = mesh->bvhNodesBuffer->buffer;
     desc_buffer[1].offset = 0;
     desc_buffer[1].range = mesh->bvhNodesBuffer->size;
+    desc_buffer[2].buffer = mesh->bvhTransformsBuffer->buffer;
+    desc_buffer[2].offset = 0;
+    desc_buffer[2].range = mesh->bvhTransformsBuffer->size;
+    desc_buffer[3].buffer = mesh->indexBuffer->buffer;
+    desc_buffer[3].offset = 0;
+    desc_buffer[3].range = mesh->indexBuffer->size;
 
-    VkWriteDescriptorSet write_desc[2] = {};
-    for (uint32_t i = 0; i < 2; ++i)
+    VkWriteDescriptorSet write_desc[4] = {};
+    for (uint32_t i = 0; i < 4; ++i)
     {
         write_desc[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         write_desc[i].dstSet = registration.descriptorSet;
@@ -101,11 +273,65 @@ void moRegisterMesh(MoPipelineLayout pipeline, MoMesh mesh)
         write_desc[i].descriptorCount = 1;
         write_desc[i].pBufferInfo = &desc_buffer[i];
     }
-    vkUpdateDescriptorSets(g_Device->device, 2, write_desc, 0, nullptr);
+    vkUpdateDescriptorSets(g_Device->device, 4, write_desc, 0, nullptr);
 
     carray_push_back(&mesh->pRegistrations, &mesh->registrationCount, registration);
 }
 
+void moRefitMesh(MoMesh mesh, const float3 *pVertices)
+{
+    MoUploadBatch batch;
+    moBeginUploadBatch(&batch);
+
+    if (mesh->vertexLayout == MO_VERTEX_LAYOUT_INTERLEAVED)
+    {
+        MoVertex* vertices = const_cast<MoVertex*>(mesh->pInterleavedVertices);
+        for (uint32_t i = 0; i < mesh->interleavedVertexCount; ++i)
+        {
+            vertices[i].position = pVertices[i];
+        }
+        moUploadBuffer(batch, mesh->verticesBuffer, 0, mesh->interleavedVertexCount * sizeof(MoVertex), vertices);
+        if (mesh->bvh && mesh->bvh->splitNodeCount && !mesh->bvh->pTriangles)
+        {
+            moUploadBuffer(batch, mesh->bvhObjectBuffer, 0, mesh->vertexCount * sizeof(float3), pVertices);
+        }
+    }
+    else
+    {
+        moUploadBuffer(batch, mesh->verticesBuffer, 0, mesh->vertexCount * sizeof(float3), pVertices);
+    }
+    carray_copy(mesh->pVertices, pVertices, mesh->vertexCount);
+
+    if (mesh->bvh && mesh->bvh->splitNodeCount)
+    {
+        MoBVHRefitInfo refitInfo = {};
+        moRefitBVH(mesh->bvh, mesh->pVertices, &refitInfo);
+        if (refitInfo.triangleCount)
+        {
+            // MO_BVH_TRIANGLE_STORAGE_INDEXED reads the vertex buffer uploaded above
+            if (mesh->bvh->pTriangles)
+            {
+                moUploadBuffer(batch, mesh->bvhObjectBuffer,
+                               sizeof(MoTriangle) * refitInfo.firstTriangle,
+                               sizeof(MoTriangle) * refitInfo.triangleCount,
+                               &mesh->bvh->pTriangles[refitInfo.firstTriangle]);
+            }
+            if (mesh->bvh->triangleTransformCount)
+            {
+                moUploadBuffer(batch, mesh->bvhTransformsBuffer,
+                               sizeof(MoTriangleTransform) * refitInfo.firstTriangle,
+                               sizeof(MoTriangleTransform) * refitInfo.triangleCount,
+                               &mesh->bvh->pTriangleTransforms[refitInfo.firstTriangle]);
+            }
+        }
+        if (refitInfo.splitNodeCount)
+        {
+            moUploadBVHNodes(batch, mesh, refitInfo.firstSplitNode, refitInfo.splitNodeCount);
+        }
+    }
+    moEndUploadBatch(batch);
+}
+
 void moDestroyMesh(MoMesh mesh)
 {
     vkQueueWaitIdle(g_Device->queue);
@@ -114,17 +340,29 @@ void moDestroyMesh(MoMesh mesh)
 
     // runtime
     moDeleteBuffer(mesh->verticesBuffer);
-    moDeleteBuffer(mesh->textureCoordsBuffer);
-    moDeleteBuffer(mesh->normalsBuffer);
-    moDeleteBuffer(mesh->tangentsBuffer);
-    moDeleteBuffer(mesh->bitangentsBuffer);
+    if (mesh->vertexLayout == MO_VERTEX_LAYOUT_SEPARATE)
+    {
+        moDeleteBuffer(mesh->textureCoordsBuffer);
+        moDeleteBuffer(mesh->normalsBuffer);
+        moDeleteBuffer(mesh->tangentsBuffer);
+        moDeleteBuffer(mesh->bitangentsBuffer);
+    }
+    if (mesh->attributesBuffer)
+    {
+        moDeleteBuffer(mesh->attributesBuffer);
+    }
     moDeleteBuffer(mesh->indexBuffer);
-    moDeleteBuffer(mesh->bvhObjectBuffer);
+    if (mesh->bvhObjectBuffer)
+    {
+        moDeleteBuffer(mesh->bvhObjectBuffer);
+    }
     moDeleteBuffer(mesh->bvhNodesBuffer);
+    moDeleteBuffer(mesh->bvhTransformsBuffer);
 
     // source
     carray_free(mesh->pIndices, &mesh->indexCount);
     carray_free(mesh->pVertices, &mesh->vertexCount);
+    carray_free(mesh->pInterleavedVertices, &mesh->interleavedVertexCount);
 
     // features
     for (std::uint32_t i = 0; i < mesh->registrationCount; ++i)
@@ -153,17 +391,48 @@ void moBindMesh(VkCommandBuffer commandBuffer, MoMesh mesh, VkPipelineLayout pip
 
 void moDrawMesh(VkCommandBuffer commandBuffer, MoMesh mesh)
 {
-    VkBuffer vertexBuffers[] = {mesh->verticesBuffer->buffer,
-                                mesh->textureCoordsBuffer->buffer,
-                                mesh->normalsBuffer->buffer,
-                                mesh->tangentsBuffer->buffer,
-                                mesh->bitangentsBuffer->buffer};
-    VkDeviceSize offsets[] = {0,
-                              0,
-                              0,
-                              0,
-                              0};
-    vkCmdBindVertexBuffers(commandBuffer, 0, 5, vertexBuffers, offsets);
+    switch (mesh->vertexLayout)
+    {
+    case MO_VERTEX_LAYOUT_INTERLEAVED:
+    {
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh->verticesBuffer->buffer, &offset);
+        break;
+    }
+    case MO_VERTEX_LAYOUT_PACKED:
+    {
+        VkBuffer vertexBuffers[] = {mesh->verticesBuffer->buffer,
+                                    mesh->attributesBuffer->buffer};
+        VkDeviceSize offsets[] = {0,
+                                  0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+        break;
+    }
+    default:
+    {
+        VkBuffer vertexBuffers[] = {mesh->verticesBuffer->buffer,
+                                    mesh->textureCoordsBuffer->buffer,
+                                    mesh->normalsBuffer->buffer,
+                                    mesh->tangentsBuffer->buffer,
+                                    mesh->bitangentsBuffer->buffer};
+        VkDeviceSize offsets[] = {0,
+                                  0,
+                                  0,
+                                  0,
+                                  0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 5, vertexBuffers, offsets);
+        break;
+    }
+    }
+    vkCmdBindIndexBuffer(commandBuffer, mesh->indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
+
+    vkCmdDrawIndexed(commandBuffer, mesh->indexBufferSize, 1, 0, 0, 0);
+}
+
+void moDrawMeshPositions(VkCommandBuffer commandBuffer, MoMesh mesh)
+{
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh->verticesBuffer->buffer, &offset);
     vkCmdBindIndexBuffer(commandBuffer, mesh->indexBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
 
     vkCmdDrawIndexed(commandBuffer, mesh->indexBufferSize, 1, 0, 0, 0);
@@ -13,14 +13,20 @@ typedef struct MoMeshRegistration {
 
 typedef struct MoMesh_T {
     // runtime
+    MoVertexLayout vertexLayout;
+    // float3 positions, MoVertex with MO_VERTEX_LAYOUT_INTERLEAVED
     MoDeviceBuffer verticesBuffer;
+    // MO_VERTEX_LAYOUT_SEPARATE only
     MoDeviceBuffer textureCoordsBuffer;
     MoDeviceBuffer normalsBuffer;
     MoDeviceBuffer tangentsBuffer;
     MoDeviceBuffer bitangentsBuffer;
+    // MoPackedVertexAttributes, MO_VERTEX_LAYOUT_PACKED only
+    MoDeviceBuffer attributesBuffer;
     MoDeviceBuffer indexBuffer;
     MoDeviceBuffer bvhObjectBuffer;
     MoDeviceBuffer bvhNodesBuffer;
+    MoDeviceBuffer bvhTransformsBuffer;
     uint32_t indexBufferSize;
 
     // source
@@ -28,6 +34,9 @@ typedef struct MoMesh_T {
     uint32_t                       indexCount;
     const linalg::aliases::float3* pVertices;
     uint32_t                       vertexCount;
+    // MO_VERTEX_LAYOUT_INTERLEAVED only, refits move the positions and upload the whole stream in one copy
+    const MoVertex*                pInterleavedVertices;
+    uint32_t                       interleavedVertexCount;
 
     // features
     const MoMeshRegistration* pRegistrations;
@@ -44,12 +53,25 @@ typedef struct MoMeshCreateInfo {
     const linalg::aliases::float3* pTangents;
     const linalg::aliases::float3* pBitangents;
     uint32_t                       vertexCount;
+    // of the vertex, index and BVH buffers, MO_MEMORY_PLACEMENT_HOST_VISIBLE for meshes refitted every frame
+    MoMemoryPlacement              memoryPlacement;
+    // streams the attributes are uploaded as, the vertexLayout of the pipeline layouts the mesh is registered with
+    MoVertexLayout                 vertexLayout;
+    // optional, BVH build options
+    const MoBVHCreateInfo*         pBVHCreateInfo;
+    // optional, BVH cache file mapped instead of building when its source hash matches, written after building otherwise
+    const char*                    pBVHCachePath;
 } MoMeshCreateInfo;
 
 // upload a new mesh to the GPU and return a handle
 void moCreateMesh(const MoMeshCreateInfo* pCreateInfo, MoMesh* pMesh);
+// the mesh's vertexLayout must be the pipeline layout's
 void moRegisterMesh(MoPipelineLayout pipeline, MoMesh mesh);
 
+// move the mesh's vertices, refitting its BVH and uploading only the BVH ranges that changed
+// the mesh must not be in use by the GPU
+void moRefitMesh(MoMesh mesh, const linalg::aliases::float3* pVertices);
+
 // free a mesh
 void moDestroyMesh(MoMesh mesh);
 
@@ -57,6 +79,9 @@ void moDestroyMesh(MoMesh mesh);
 void moBindMesh(VkCommandBuffer commandBuffer, MoMesh mesh, VkPipelineLayout pipelineLayout);
 void moDrawMesh(VkCommandBuffer commandBuffer, MoMesh mesh);
 
+// draw a mesh with a pipeline created with positionOnly, binding only its first stream
+void moDrawMeshPositions(VkCommandBuffer commandBuffer, MoMesh mesh);
+
 /*
 ------------------------------------------------------------------------------
 This software is available under 2 licenses -- choose whichever you prefer.
@@ -6,6 +6,7 @@
 #include <assimp/scene.h>
 
 #include <filesystem>
+#include <string>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -51,7 +52,21 @@ void moDestroyNode(MoNode node)
     delete node;
 }
 
-void moCreateScene(MoCommandBuffer commandBuffer, const char *filename, MoScene* pScene)
+// world transforms of the mesh nodes below node, in the order of pInstanceNodes
+static void moCollectInstances(MoNode node, const float4x4& model, std::vector<MoNode>& nodes, std::vector<float4x4>& models)
+{
+    if (node->mesh)
+    {
+        nodes.push_back(node);
+        models.push_back(model);
+    }
+    for (std::uint32_t i = 0; i < node->nodeCount; ++i)
+    {
+        moCollectInstances(node->pNodes[i], mul(model, node->pNodes[i]->model), nodes, models);
+    }
+}
+
+void moCreateScene(MoCommandBuffer commandBuffer, const char *filename, MoScene* pScene, const char* pBVHCacheDirectory)
 {
     MoScene scene = *pScene = new MoScene_T();
     *scene = {};
@@ -159,16 +174,66 @@ void moCreateScene(MoCommandBuffer commandBuffer, const char *filename, MoScene*
             info.pNormals = normals.data();
             info.pTangents = tangents.data();
             info.pBitangents = bitangents.data();
+            // one file per mesh, rebuilt whenever the geometry changes
+            std::string cachePath;
+            if (pBVHCacheDirectory)
+            {
+                cachePath = (std::filesystem::path(pBVHCacheDirectory) / std::filesystem::path(filename).filename()).string() + "." + std::to_string(meshIdx) + ".bvh";
+                info.pBVHCachePath = cachePath.c_str();
+            }
 
             moCreateMesh(&info, const_cast<MoMesh*>(&scene->pMeshes[meshIdx]));
         }
 
         moCreateNode(aScene, scene, aScene->mRootNode, const_cast<MoNode*>(&scene->root));
+
+        std::vector<MoNode> nodes;
+        std::vector<float4x4> models;
+        moCollectInstances(scene->root, scene->root->model, nodes, models);
+        std::vector<MoBVHInstance> instances(nodes.size());
+        for (std::size_t i = 0; i < nodes.size(); ++i)
+        {
+            instances[i].model = models[i];
+            instances[i].bvh = nodes[i]->mesh->bvh;
+        }
+        carray_resize(&scene->pInstanceNodes, &scene->instanceNodeCount, std::uint32_t(nodes.size()));
+        carray_copy(scene->pInstanceNodes, nodes.data(), std::uint32_t(nodes.size()));
+        moCreateTopLevelBVH(instances.data(), std::uint32_t(instances.size()), &scene->bvh);
     }
 }
 
+bool moIntersectScene(MoScene scene, const MoRay& ray, MoSceneIntersectResult& result, bool backfaceCulling)
+{
+    std::uint32_t instanceIndex = 0;
+    if (scene->bvh == nullptr || !moIntersectTopLevelBVH(scene->bvh, ray, result.intersection, instanceIndex, backfaceCulling))
+    {
+        result.node = nullptr;
+        return false;
+    }
+    result.node = scene->pInstanceNodes[instanceIndex];
+    return true;
+}
+
+void moRefitScene(MoScene scene)
+{
+    if (scene->bvh == nullptr)
+    {
+        return;
+    }
+
+    std::vector<MoNode> nodes;
+    std::vector<float4x4> models;
+    moCollectInstances(scene->root, scene->root->model, nodes, models);
+    moRefitTopLevelBVH(scene->bvh, models.data());
+}
+
 void moDestroyScene(MoScene scene)
 {
+    if (scene->bvh)
+    {
+        moDestroyTopLevelBVH(scene->bvh);
+    }
+    carray_free(scene->pInstanceNodes, &scene->instanceNodeCount);
     moDestroyNode(scene->root);
     for (std::uint32_t i = 0; i < scene->meshCount; ++i)
     {
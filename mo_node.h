@@ -23,9 +23,27 @@ typedef struct MoScene_T
     const MoMaterial*         pMaterials;
     std::uint32_t             materialCount;
     MoNode                    root;
+    // nodes with a mesh in depth first order, the instances of bvh
+    const MoNode*             pInstanceNodes;
+    std::uint32_t             instanceNodeCount;
+    MoTopLevelBVH             bvh;
 }* MoScene;
 
-void moCreateScene(MoCommandBuffer commandBuffer, const char* filename, MoScene* pScene);
+typedef struct MoSceneIntersectResult {
+    // node whose mesh was hit
+    MoNode                    node;
+    // in the node's mesh space, distance is along the world ray
+    MoIntersectResult         intersection;
+} MoSceneIntersectResult;
+
+// pBVHCacheDirectory is optional, an existing directory the meshes' BVH cache files are kept in, see MoMeshCreateInfo::pBVHCachePath
+void moCreateScene(MoCommandBuffer commandBuffer, const char* filename, MoScene* pScene, const char* pBVHCacheDirectory = nullptr);
+
+// closest hit of the world ray against every mesh node of the scene
+bool moIntersectScene(MoScene scene, const MoRay& ray, MoSceneIntersectResult& result, bool backfaceCulling = false);
+
+// update the scene's BVH after node models changed or meshes were refit
+void moRefitScene(MoScene scene);
 
 void moDestroyScene(MoScene scene);
 
@@ -2,6 +2,11 @@
 #include "mo_device.h"
 #include "mo_swapchain.h"
 
+#include "mo_array.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
 #include <cstring>
 
 using namespace linalg;
@@ -9,10 +14,11 @@ using namespace linalg::aliases;
 
 extern MoDevice g_Device;
 
-void moCreatePipelineLayout(MoPipelineLayout *pPipeline)
+void moCreatePipelineLayout(MoPipelineLayout *pPipeline, MoPipelineLayoutCreateFlags flags, MoVertexLayout vertexLayout)
 {
     MoPipelineLayout pipeline = *pPipeline = new MoPipelineLayout_T();
     *pipeline = {};
+    pipeline->vertexLayout = vertexLayout;
 
     VkResult err;
 
@@ -69,9 +75,9 @@ void moCreatePipelineLayout(MoPipelineLayout *pPipeline)
     }
 
     {
-        VkDescriptorSetLayoutBinding binding[2];
+        VkDescriptorSetLayoutBinding binding[4];
 
-        // triangle bvh objects
+        // triangle bvh objects, or the mesh vertices with MO_BVH_TRIANGLE_STORAGE_INDEXED
         binding[0].binding = 0;
         binding[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
         binding[0].descriptorCount = 1;
@@ -83,6 +89,18 @@ void moCreatePipelineLayout(MoPipelineLayout *pPipeline)
         binding[1].descriptorCount = 1;
         binding[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
+        // triangle bvh transforms, MO_BVH_TRIANGLE_FORMAT_TRANSFORM only
+        binding[2].binding = 2;
+        binding[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        binding[2].descriptorCount = 1;
+        binding[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        // mesh indices, MO_BVH_TRIANGLE_STORAGE_INDEXED only
+        binding[3].binding = 3;
+        binding[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        binding[3].descriptorCount = 1;
+        binding[3].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
         VkDescriptorSetLayoutCreateInfo info = {};
         info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         info.bindingCount = (uint32_t)countof(binding);
@@ -91,6 +109,28 @@ void moCreatePipelineLayout(MoPipelineLayout *pPipeline)
         g_Device->pCheckVkResultFn(err);
     }
 
+    pipeline->descriptorSetLayoutCount = MO_SSBO_DESC_LAYOUT + 1;
+
+    // ring buffer bindings
+    if (flags & MO_PIPELINE_LAYOUT_FEATURE_RING_BUFFER)
+    {
+        VkDescriptorSetLayoutBinding binding[1];
+        // per object constants, at a dynamic offset
+        binding[0].binding = 0;
+        binding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        binding[0].descriptorCount = 1;
+        binding[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        binding[0].pImmutableSamplers = VK_NULL_HANDLE;
+
+        VkDescriptorSetLayoutCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        info.bindingCount = countof(binding);
+        info.pBindings = binding;
+        err = vkCreateDescriptorSetLayout(g_Device->device, &info, VK_NULL_HANDLE, &pipeline->descriptorSetLayout[MO_DYNAMIC_DESC_LAYOUT]);
+        g_Device->pCheckVkResultFn(err);
+        pipeline->descriptorSetLayoutCount = MO_DYNAMIC_DESC_LAYOUT + 1;
+    }
+
     {
         VkDescriptorSetLayout descriptorSetLayout[MO_FRAME_COUNT] = {};
         for (size_t i = 0; i < MO_FRAME_COUNT; ++i)
@@ -131,7 +171,7 @@ void moCreatePipelineLayout(MoPipelineLayout *pPipeline)
         push_constants[0] = {VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MoPushConstant)};
         VkPipelineLayoutCreateInfo layout_info = {};
         layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        layout_info.setLayoutCount = countof(pipeline->descriptorSetLayout);
+        layout_info.setLayoutCount = pipeline->descriptorSetLayoutCount;
         layout_info.pSetLayouts = pipeline->descriptorSetLayout;
         layout_info.pushConstantRangeCount = countof(push_constants);
         layout_info.pPushConstantRanges = push_constants;
@@ -165,30 +205,57 @@ void moCreatePipeline(const MoPipelineCreateInfo *pCreateInfo, VkPipeline *pPipe
     stage[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
     stage[0].module = vert_module;
     stage[0].pName = "main";
+    stage[0].pSpecializationInfo = pCreateInfo->pSpecializationInfo;
     stage[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     stage[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     stage[1].module = frag_module;
     stage[1].pName = "main";
+    stage[1].pSpecializationInfo = pCreateInfo->pSpecializationInfo;
 
     VkVertexInputBindingDescription binding_desc[5] = {};
-    binding_desc[0] = {0, sizeof(float3), VK_VERTEX_INPUT_RATE_VERTEX };
-    binding_desc[1] = {1, sizeof(float2), VK_VERTEX_INPUT_RATE_VERTEX };
-    binding_desc[2] = {2, sizeof(float3), VK_VERTEX_INPUT_RATE_VERTEX };
-    binding_desc[3] = {3, sizeof(float3), VK_VERTEX_INPUT_RATE_VERTEX };
-    binding_desc[4] = {4, sizeof(float3), VK_VERTEX_INPUT_RATE_VERTEX };
-
     VkVertexInputAttributeDescription attribute_desc[5] = {};
-    attribute_desc[0] = {0, binding_desc[0].binding, VK_FORMAT_R32G32B32_SFLOAT, 0 };
-    attribute_desc[1] = {1, binding_desc[1].binding, VK_FORMAT_R32G32_SFLOAT,    0 };
-    attribute_desc[2] = {2, binding_desc[2].binding, VK_FORMAT_R32G32B32_SFLOAT, 0 };
-    attribute_desc[3] = {3, binding_desc[3].binding, VK_FORMAT_R32G32B32_SFLOAT, 0 };
-    attribute_desc[4] = {4, binding_desc[4].binding, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+    uint32_t binding_count = 0;
+    switch (pCreateInfo->vertexLayout)
+    {
+    case MO_VERTEX_LAYOUT_INTERLEAVED:
+        binding_desc[0] = {0, sizeof(MoVertex), VK_VERTEX_INPUT_RATE_VERTEX };
+        attribute_desc[0] = {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MoVertex, position) };
+        attribute_desc[1] = {1, 0, VK_FORMAT_R32G32_SFLOAT,    offsetof(MoVertex, textureCoords) };
+        attribute_desc[2] = {2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MoVertex, normal) };
+        attribute_desc[3] = {3, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MoVertex, tangent) };
+        attribute_desc[4] = {4, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MoVertex, bitangent) };
+        binding_count = 1;
+        break;
+    case MO_VERTEX_LAYOUT_PACKED:
+        binding_desc[0] = {0, sizeof(float3), VK_VERTEX_INPUT_RATE_VERTEX };
+        binding_desc[1] = {1, sizeof(MoPackedVertexAttributes), VK_VERTEX_INPUT_RATE_VERTEX };
+        attribute_desc[0] = {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+        attribute_desc[1] = {1, 1, VK_FORMAT_R16G16_SFLOAT,    offsetof(MoPackedVertexAttributes, textureCoords) };
+        attribute_desc[2] = {2, 1, VK_FORMAT_R8G8B8A8_SNORM,   offsetof(MoPackedVertexAttributes, normal) };
+        attribute_desc[3] = {3, 1, VK_FORMAT_R8G8B8A8_SNORM,   offsetof(MoPackedVertexAttributes, tangent) };
+        attribute_desc[4] = {4, 1, VK_FORMAT_R8G8B8A8_SNORM,   offsetof(MoPackedVertexAttributes, bitangent) };
+        binding_count = 2;
+        break;
+    default:
+        binding_desc[0] = {0, sizeof(float3), VK_VERTEX_INPUT_RATE_VERTEX };
+        binding_desc[1] = {1, sizeof(float2), VK_VERTEX_INPUT_RATE_VERTEX };
+        binding_desc[2] = {2, sizeof(float3), VK_VERTEX_INPUT_RATE_VERTEX };
+        binding_desc[3] = {3, sizeof(float3), VK_VERTEX_INPUT_RATE_VERTEX };
+        binding_desc[4] = {4, sizeof(float3), VK_VERTEX_INPUT_RATE_VERTEX };
+        attribute_desc[0] = {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+        attribute_desc[1] = {1, 1, VK_FORMAT_R32G32_SFLOAT,    0 };
+        attribute_desc[2] = {2, 2, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+        attribute_desc[3] = {3, 3, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+        attribute_desc[4] = {4, 4, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+        binding_count = 5;
+        break;
+    }
 
     VkPipelineVertexInputStateCreateInfo vertex_info = {};
     vertex_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_info.vertexBindingDescriptionCount = countof(binding_desc);
+    vertex_info.vertexBindingDescriptionCount = pCreateInfo->positionOnly ? 1 : binding_count;
     vertex_info.pVertexBindingDescriptions = binding_desc;
-    vertex_info.vertexAttributeDescriptionCount = countof(attribute_desc);
+    vertex_info.vertexAttributeDescriptionCount = pCreateInfo->positionOnly ? 1 : countof(attribute_desc);
     vertex_info.pVertexAttributeDescriptions = attribute_desc;
 
     VkPipelineInputAssemblyStateCreateInfo assembly_info = {};
@@ -285,6 +352,127 @@ void moBindPipeline(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkPipeli
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, MO_PROGRAM_DESC_LAYOUT, 1, &pipelineDescriptorSet, 0, VK_NULL_HANDLE);
 }
 
+void moCreateRingBuffer(const MoRingBufferCreateInfo *pCreateInfo, MoRingBuffer *pRingBuffer)
+{
+    MoRingBuffer ringBuffer = *pRingBuffer = new MoRingBuffer_T();
+    *ringBuffer = {};
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(g_Device->physicalDevice, &properties);
+    ringBuffer->alignment = 16;
+    if (pCreateInfo->usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+    {
+        ringBuffer->alignment = std::max(ringBuffer->alignment, properties.limits.minUniformBufferOffsetAlignment);
+    }
+    if (pCreateInfo->usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+    {
+        ringBuffer->alignment = std::max(ringBuffer->alignment, properties.limits.minStorageBufferOffsetAlignment);
+    }
+
+    ringBuffer->frameSize = ((pCreateInfo->frameSize - 1) / ringBuffer->alignment + 1) * ringBuffer->alignment;
+    ringBuffer->range = pCreateInfo->range;
+    // the last allocation of the last frame still has range bytes behind its offset
+    moCreateBuffer(&ringBuffer->buffer, ringBuffer->frameSize * MO_FRAME_COUNT + ringBuffer->range, pCreateInfo->usage, MO_MEMORY_PLACEMENT_HOST_VISIBLE);
+}
+
+void moRegisterRingBuffer(MoPipelineLayout pipeline, MoRingBuffer ringBuffer)
+{
+    assert(pipeline->descriptorSetLayoutCount > MO_DYNAMIC_DESC_LAYOUT && "created without MO_PIPELINE_LAYOUT_FEATURE_RING_BUFFER");
+
+    MoRingBufferRegistration registration = {};
+    registration.pipelineLayout = pipeline->pipelineLayout;
+
+    {
+        VkDescriptorSetAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = g_Device->descriptorPool;
+        alloc_info.descriptorSetCount = 1;
+        alloc_info.pSetLayouts = &pipeline->descriptorSetLayout[MO_DYNAMIC_DESC_LAYOUT];
+        VkResult err = vkAllocateDescriptorSets(g_Device->device, &alloc_info, &registration.descriptorSet);
+        g_Device->pCheckVkResultFn(err);
+    }
+
+    VkDescriptorBufferInfo bufferInfo[1] = {};
+    bufferInfo[0].buffer = ringBuffer->buffer->buffer;
+    bufferInfo[0].offset = 0;
+    bufferInfo[0].range = ringBuffer->range;
+
+    VkWriteDescriptorSet descriptorWrite[1] = {};
+    descriptorWrite[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite[0].dstSet = registration.descriptorSet;
+    descriptorWrite[0].dstBinding = 0;
+    descriptorWrite[0].dstArrayElement = 0;
+    descriptorWrite[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrite[0].descriptorCount = 1;
+    descriptorWrite[0].pBufferInfo = &bufferInfo[0];
+    vkUpdateDescriptorSets(g_Device->device, 1, descriptorWrite, 0, VK_NULL_HANDLE);
+
+    carray_push_back(&ringBuffer->pRegistrations, &ringBuffer->registrationCount, registration);
+}
+
+void moBeginRingBuffer(MoRingBuffer ringBuffer, uint32_t frame, VkFence fence)
+{
+    if (fence != VK_NULL_HANDLE)
+    {
+        VkResult err = vkWaitForFences(g_Device->device, 1, &fence, VK_TRUE, UINT64_MAX);
+        g_Device->pCheckVkResultFn(err);
+    }
+
+    ringBuffer->frame = frame % MO_FRAME_COUNT;
+    ringBuffer->head = ringBuffer->frame * ringBuffer->frameSize;
+}
+
+bool moAllocateRingBuffer(MoRingBuffer ringBuffer, VkDeviceSize size, VkDeviceSize *pOffset, void **ppData)
+{
+    const VkDeviceSize end = (ringBuffer->frame + 1) * ringBuffer->frameSize;
+    if (ringBuffer->head + size > end)
+    {
+        return false;
+    }
+
+    *pOffset = ringBuffer->head;
+    *ppData = static_cast<char*>(ringBuffer->buffer->pMapped) + ringBuffer->head;
+    ringBuffer->head = std::min(end, ((ringBuffer->head + size - 1) / ringBuffer->alignment + 1) * ringBuffer->alignment);
+    return true;
+}
+
+void moEndRingBuffer(MoRingBuffer ringBuffer)
+{
+    const VkDeviceSize begin = ringBuffer->frame * ringBuffer->frameSize;
+    if (ringBuffer->head > begin)
+    {
+        moFlushBuffer(ringBuffer->buffer, begin, ringBuffer->head - begin);
+    }
+}
+
+void moBindRingBuffer(VkCommandBuffer commandBuffer, MoRingBuffer ringBuffer, VkPipelineLayout pipelineLayout, VkDeviceSize offset)
+{
+    const uint32_t dynamicOffset = uint32_t(offset);
+    std::uint32_t i = 0;
+    while (i < ringBuffer->registrationCount && ringBuffer->pRegistrations[i].pipelineLayout != pipelineLayout)
+    {
+        ++i;
+    }
+    assert(i < ringBuffer->registrationCount && "moRegisterRingBuffer was not called for this pipeline layout");
+    if (i < ringBuffer->registrationCount)
+    {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, MO_DYNAMIC_DESC_LAYOUT, 1, &ringBuffer->pRegistrations[i].descriptorSet, 1, &dynamicOffset);
+    }
+}
+
+void moDestroyRingBuffer(MoRingBuffer ringBuffer)
+{
+    vkQueueWaitIdle(g_Device->queue);
+
+    for (std::uint32_t i = 0; i < ringBuffer->registrationCount; ++i)
+    {
+        vkFreeDescriptorSets(g_Device->device, g_Device->descriptorPool, 1, &ringBuffer->pRegistrations[i].descriptorSet);
+    }
+    carray_free(ringBuffer->pRegistrations, &ringBuffer->registrationCount);
+    moDeleteBuffer(ringBuffer->buffer);
+    delete ringBuffer;
+}
+
 /*
 ------------------------------------------------------------------------------
 This software is available under 2 licenses -- choose whichever you prefer.
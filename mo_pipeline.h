@@ -9,14 +9,38 @@
 #define MO_MATERIAL_DESC_LAYOUT 1
 #define MO_RENDER_DESC_LAYOUT 2
 #define MO_SSBO_DESC_LAYOUT 3
-#define MO_COUNT_DESC_LAYOUT MO_SSBO_DESC_LAYOUT+1
+// MO_PIPELINE_LAYOUT_FEATURE_RING_BUFFER only, devices may bind as few as 4 sets
+#define MO_DYNAMIC_DESC_LAYOUT 4
+#define MO_COUNT_DESC_LAYOUT MO_DYNAMIC_DESC_LAYOUT+1
+
+typedef enum MoPipelineLayoutFeature {
+    MO_PIPELINE_LAYOUT_FEATURE_NONE        = 0,
+    // a fifth set, MO_DYNAMIC_DESC_LAYOUT, for moRegisterRingBuffer
+    MO_PIPELINE_LAYOUT_FEATURE_RING_BUFFER = 0b0001,
+    MO_PIPELINE_LAYOUT_FEATURE_MAX_ENUM    = 0x7FFFFFFF
+} MoPipelineLayoutFeature;
+typedef VkFlags MoPipelineLayoutCreateFlags;
+
+typedef enum MoVertexLayout {
+    // one stream per attribute, locations 0 to 4 at bindings 0 to 4
+    MO_VERTEX_LAYOUT_SEPARATE    = 0,
+    // a single MoVertex stream at binding 0
+    MO_VERTEX_LAYOUT_INTERLEAVED = 1,
+    // float3 positions at binding 0, MoPackedVertexAttributes at binding 1
+    MO_VERTEX_LAYOUT_PACKED      = 2,
+    MO_VERTEX_LAYOUT_MAX_ENUM    = 0x7FFFFFFF
+} MoVertexLayout;
 
 typedef struct MoPipelineLayout_T {
     VkPipelineLayout pipelineLayout;
     VkDescriptorSetLayout descriptorSetLayout[MO_COUNT_DESC_LAYOUT];
+    // sets in pipelineLayout, MO_DYNAMIC_DESC_LAYOUT + 1 with MO_PIPELINE_LAYOUT_FEATURE_RING_BUFFER, MO_SSBO_DESC_LAYOUT + 1 otherwise
+    uint32_t descriptorSetLayoutCount;
     // the buffers bound to this descriptor set may change frame to frame, one set per frame
     VkDescriptorSet descriptorSet[MO_FRAME_COUNT];
     MoDeviceBuffer  uniformBuffer[MO_FRAME_COUNT];
+    // of the meshes registered with it, the pipelines created on it bind the same streams
+    MoVertexLayout  vertexLayout;
 }* MoPipelineLayout;
 
 typedef enum MoPipelineFeature {
@@ -30,6 +54,23 @@ typedef enum MoPipelineFeature {
 } MoPipelineFeature;
 typedef VkFlags MoPipelineCreateFlags;
 
+// 56 bytes
+typedef struct MoVertex {
+    linalg::aliases::float3 position;
+    linalg::aliases::float2 textureCoords;
+    linalg::aliases::float3 normal;
+    linalg::aliases::float3 tangent;
+    linalg::aliases::float3 bitangent;
+} MoVertex;
+
+// 16 bytes next to a 12 bytes position, half float texture coordinates and snorm tangent frame
+typedef struct MoPackedVertexAttributes {
+    uint16_t textureCoords[2];
+    int8_t   normal[4];
+    int8_t   tangent[4];
+    int8_t   bitangent[4];
+} MoPackedVertexAttributes;
+
 typedef struct MoPipelineCreateInfo {
     const uint32_t*       pVertexShader;
     uint32_t              vertexShaderSize;
@@ -38,10 +79,16 @@ typedef struct MoPipelineCreateInfo {
     VkPipelineLayout      pipelineLayout;
     VkRenderPass          renderPass;
     MoPipelineCreateFlags flags;
+    // optional, specialization constants of both stages, e.g. moBVHTriangleFormat of raytrace.h
+    const VkSpecializationInfo* pSpecializationInfo;
+    // must match the vertexLayout of the meshes drawn, the vertexLayout of the MoPipelineLayout
+    MoVertexLayout        vertexLayout;
+    // only location 0 from binding 0, for depth and occlusion passes drawn with moDrawMeshPositions
+    VkBool32              positionOnly;
 } MoPipelineCreateInfo;
 
 //create a pipeline
-void moCreatePipelineLayout(MoPipelineLayout *pPipeline);
+void moCreatePipelineLayout(MoPipelineLayout *pPipeline, MoPipelineLayoutCreateFlags flags = MO_PIPELINE_LAYOUT_FEATURE_NONE, MoVertexLayout vertexLayout = MO_VERTEX_LAYOUT_SEPARATE);
 void moCreatePipeline(const MoPipelineCreateInfo *pCreateInfo, VkPipeline *pPipeline);
 
 // destroy a pipeline
@@ -50,6 +97,55 @@ void moDestroyPipelineLayout(MoPipelineLayout pipeline);
 // start a new frame against the given pipeline
 void moBindPipeline(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkPipelineLayout pipelineLayout, VkDescriptorSet pipelineDescriptorSet);
 
+typedef struct MoRingBufferCreateInfo {
+    // bytes handed out per frame in flight
+    VkDeviceSize       frameSize;
+    // bytes a draw reads from its dynamic offset, the uniform block bound to MO_DYNAMIC_DESC_LAYOUT
+    VkDeviceSize       range;
+    // VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT for moRegisterRingBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT for instance data and dynamic vertices
+    VkBufferUsageFlags usage;
+} MoRingBufferCreateInfo;
+
+typedef struct MoRingBufferRegistration {
+    VkPipelineLayout pipelineLayout;
+    VkDescriptorSet descriptorSet;
+} MoRingBufferRegistration;
+
+// one persistently mapped buffer split in MO_FRAME_COUNT regions, a region is reused once the frame that filled it completed
+typedef struct MoRingBuffer_T {
+    MoDeviceBuffer buffer;
+    VkDeviceSize   frameSize;
+    VkDeviceSize   range;
+    // of every allocation, meets the device's dynamic offset alignment
+    VkDeviceSize   alignment;
+    uint32_t       frame;
+    // next allocation in buffer, between frame * frameSize and (frame + 1) * frameSize
+    VkDeviceSize   head;
+    const MoRingBufferRegistration* pRegistrations;
+    uint32_t                        registrationCount;
+}* MoRingBuffer;
+
+// create a ring buffer for transient per frame data
+void moCreateRingBuffer(const MoRingBufferCreateInfo* pCreateInfo, MoRingBuffer* pRingBuffer);
+// the pipeline layout must be created with MO_PIPELINE_LAYOUT_FEATURE_RING_BUFFER
+void moRegisterRingBuffer(MoPipelineLayout pipeline, MoRingBuffer ringBuffer);
+
+// start allocating from frame's region, waiting for fence first unless it is VK_NULL_HANDLE
+// moBeginSwapChain already waited for the fence of swapChain->currentFrame
+void moBeginRingBuffer(MoRingBuffer ringBuffer, uint32_t frame, VkFence fence);
+
+// size bytes written through *ppData, at *pOffset in ringBuffer->buffer, false when the frame's region is full
+bool moAllocateRingBuffer(MoRingBuffer ringBuffer, VkDeviceSize size, VkDeviceSize* pOffset, void** ppData);
+
+// make the frame's allocations visible to the device, before submitting the frame
+void moEndRingBuffer(MoRingBuffer ringBuffer);
+
+// bind the MO_DYNAMIC_DESC_LAYOUT uniform block at an offset returned by moAllocateRingBuffer, the ring buffer must be registered with pipelineLayout
+void moBindRingBuffer(VkCommandBuffer commandBuffer, MoRingBuffer ringBuffer, VkPipelineLayout pipelineLayout, VkDeviceSize offset);
+
+// free a ring buffer
+void moDestroyRingBuffer(MoRingBuffer ringBuffer);
+
 /*
 ------------------------------------------------------------------------------
 This software is available under 2 licenses -- choose whichever you prefer.
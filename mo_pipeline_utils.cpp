@@ -6,11 +6,14 @@
 
 using namespace std::filesystem;
 
-void moCreatePipeline(VkRenderPass renderPass, VkPipelineLayout pipelineLayout, const char* glslFilename, VkPipeline *pPipeline, MoPipelineCreateFlags flags)
+void moCreatePipeline(VkRenderPass renderPass, MoPipelineLayout pipelineLayout, const char* glslFilename, VkPipeline *pPipeline, MoPipelineCreateFlags flags, VkBool32 positionOnly, const VkSpecializationInfo* pSpecializationInfo)
 {
     MoPipelineCreateInfo info = {};
     info.flags = flags;
-    info.pipelineLayout = pipelineLayout;
+    info.vertexLayout = pipelineLayout->vertexLayout;
+    info.positionOnly = positionOnly;
+    info.pSpecializationInfo = pSpecializationInfo;
+    info.pipelineLayout = pipelineLayout->pipelineLayout;
     info.renderPass = renderPass;
     std::vector<char> mo_phong_shader_vert_spv;
     {
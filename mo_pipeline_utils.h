@@ -2,7 +2,9 @@
 
 #include "mo_pipeline.h"
 
-void moCreatePipeline(VkRenderPass renderPass, VkPipelineLayout pipelineLayout, const char *glslFilename, VkPipeline *pPipeline, MoPipelineCreateFlags flags = MO_PIPELINE_FEATURE_DEFAULT);
+// vertex streams as in the pipeline layout's vertexLayout, only the position with positionOnly
+// pSpecializationInfo is optional, e.g. the BVH formats raytrace.h is specialized for when they differ from its defaults
+void moCreatePipeline(VkRenderPass renderPass, MoPipelineLayout pipelineLayout, const char *glslFilename, VkPipeline *pPipeline, MoPipelineCreateFlags flags = MO_PIPELINE_FEATURE_DEFAULT, VkBool32 positionOnly = VK_FALSE, const VkSpecializationInfo* pSpecializationInfo = nullptr);
 
 /*
 ------------------------------------------------------------------------------
@@ -35,102 +35,6 @@ void main()
 #ifdef COMPILING_FRAGMENT
 #extension GL_GOOGLE_include_directive : enable
 #include "raytrace.h"
-layout(std430, set = 3, binding = 0) buffer BVHObjects
-{
-    MoTriangle pObjects[];
-} inBVHObjects;
-layout(std430, set = 3, binding = 1) buffer BVHSplitNodes
-{
-    MoBVHSplitNode pSplitNodes[];
-} inBVHSplitNodes;
-
-// Working set
-MoBVHWorkingSet traversal[64];
-bool moIntersectTriangleBVH(in MoRay ray, out MoIntersectResult result)
-{
-    result.distance = 1.0 / 0.0;
-    int stackPtr = 0;
-
-    traversal[stackPtr].index = 0;
-    traversal[stackPtr].distance = -1.0 / 0.0;
-
-    while (stackPtr >= 0)
-    {
-        uint index = traversal[stackPtr].index;
-        float near = traversal[stackPtr].distance;
-        stackPtr--;
-        MoBVHSplitNode node = inBVHSplitNodes.pSplitNodes[index];
-
-        if (near > result.distance)
-        {
-            continue;
-        }
-
-        if (node.offset == 0)
-        {
-            float t = 1.0 / 0.0;
-            float u, v;
-            MoTriangle triangle = inBVHObjects.pObjects[node.start];
-            if (moRayTriangleIntersect(triangle, ray, t, u, v))
-            {
-                if (t < result.distance)
-                {
-                    result.triangle = triangle;
-                    result.distance = t;
-                }
-                if (t <= 0.0)
-                {
-                    return true;
-                }
-            }
-        }
-        else
-        {
-            uint closer = index + 1;
-            uint other = index + node.offset;
-
-            float bbhits[5];
-
-            bool hitLeft = moIntersect(inBVHSplitNodes.pSplitNodes[index + 1].boundingBox, ray, bbhits[0], bbhits[1]);
-            bool hitRight = moIntersect(inBVHSplitNodes.pSplitNodes[index + node.offset].boundingBox, ray, bbhits[2], bbhits[3]);
-
-            if (hitLeft && hitRight)
-            {
-                if (bbhits[2] < bbhits[0])
-                {
-                    other = index + 1;
-                    closer = index + node.offset;
-                    // swap
-                    bbhits[4] = bbhits[0];
-                    bbhits[0] = bbhits[2];
-                    bbhits[2] = bbhits[4];
-                    // swap
-                    bbhits[4] = bbhits[1];
-                    bbhits[1] = bbhits[3];
-                    bbhits[3] = bbhits[4];
-                }
-
-                ++stackPtr;
-                traversal[stackPtr] = MoBVHWorkingSet(other, bbhits[2]);
-                ++stackPtr;
-                traversal[stackPtr] = MoBVHWorkingSet(closer, bbhits[0]);
-            }
-            else if (hitLeft)
-            {
-                ++stackPtr;
-                traversal[stackPtr] = MoBVHWorkingSet(closer, bbhits[0]);
-            }
-            else if (hitRight)
-            {
-                ++stackPtr;
-                traversal[stackPtr] = MoBVHWorkingSet(other, bbhits[2]);
-            }
-        }
-    }
-
-    return result.distance < (1.0 / 0.0);
-}
-
 const vec3 SurfaceBias = vec3(0.01);
 layout(location = 0) out vec4 fragment;
 layout(location = 0) in VertexData
@@ -143,8 +47,7 @@ void main()
 {
     MoRay ray;
     moInitRay(ray, fma(inData.normal, SurfaceBias, inData.vertex), inData.lightDir);
-    MoIntersectResult nextResult;
-    if (moIntersectTriangleBVH(ray, nextResult))
+    if (moOccludedBVH(ray, 0.0, 1.0 / 0.0))
     {
         fragment = vec4(0,0,0,1);
     }
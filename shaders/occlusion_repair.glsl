@@ -5,8 +5,8 @@ layout(location=0) out VertexData
 {
     vec3 vertex;
 } outData;
+// position only, see moDrawMeshPositions
 layout(location = 0) in vec3 vertex;
-layout(location = 1) in vec2 vertexTexcoord;
 void main()
 {
     outData.vertex = vertex + vec3(0.5,0.5,0);
@@ -1,9 +1,27 @@
+// MoBVHTriangleFormat of the meshes traversed, set through MoPipelineCreateInfo::pSpecializationInfo
+#define MO_BVH_TRIANGLE_FORMAT_VERTICES 0
+#define MO_BVH_TRIANGLE_FORMAT_WATERTIGHT 1
+#define MO_BVH_TRIANGLE_FORMAT_TRANSFORM 2
+layout(constant_id = 0) const uint moBVHTriangleFormat = MO_BVH_TRIANGLE_FORMAT_VERTICES;
+// MoBVHNodeFormat of the meshes traversed
+#define MO_BVH_NODE_FORMAT_FLOAT 0
+#define MO_BVH_NODE_FORMAT_QUANTIZED_16 1
+#define MO_BVH_NODE_FORMAT_QUANTIZED_8 2
+layout(constant_id = 1) const uint moBVHNodeFormat = MO_BVH_NODE_FORMAT_FLOAT;
+// MoBVHTriangleStorage of the meshes traversed
+#define MO_BVH_TRIANGLE_STORAGE_COPY 0
+#define MO_BVH_TRIANGLE_STORAGE_INDEXED 1
+layout(constant_id = 2) const uint moBVHTriangleStorage = MO_BVH_TRIANGLE_STORAGE_COPY;
+
 /// RAY
 struct MoRay
 {
     vec3 origin;
     vec3 direction;
     vec3 oneOverDirection;
+    // watertight test, axes with the ray running along kz and the shear that aligns it with z
+    uvec3 k;
+    vec3 shear;
 };
 
 void moInitRay(inout MoRay self, in vec3 origin, in vec3 direction)
@@ -11,6 +29,14 @@ void moInitRay(inout MoRay self, in vec3 origin, in vec3 direction)
     self.origin = origin;
     self.direction = direction;
     self.oneOverDirection = 1.0 / self.direction;
+
+    vec3 absolute = abs(direction);
+    uint kz = absolute.x > absolute.y ? (absolute.x > absolute.z ? 0 : 2) : (absolute.y > absolute.z ? 1 : 2);
+    uint kx = (kz + 1) % 3;
+    uint ky = (kx + 1) % 3;
+    // keep the winding of the triangles
+    self.k = direction[kz] < 0.0 ? uvec3(ky, kx, kz) : uvec3(kx, ky, kz);
+    self.shear = vec3(direction[self.k.x], direction[self.k.y], 1.0) / direction[kz];
 }
 
 /// BBOX
@@ -28,7 +54,8 @@ bool moIntersect(in MoBBox self, in MoRay ray, out float t_near, out float t_far
     t_near = max(max(min(t1.x, t2.x), min(t1.y, t2.y)), min(t1.z, t2.z));
     t_far = min(min(max(t1.x, t2.x), max(t1.y, t2.y)), max(t1.z, t2.z));
 
-    return t_far >= t_near;
+    // 1 + 2 * gamma(3) rounded up, MO_BVH_SLAB_SCALE of mo_bvh.cpp, keeps the test conservative under rounding, from Thiago Ize's "Robust BVH Ray Traversal"
+    return t_far * 1.0000004 >= t_near;
 }
 
 /// TRIANGLE
@@ -77,14 +104,84 @@ bool moRayTriangleIntersect(in MoTriangle self, in MoRay ray, out float t, out f
     return false;
 }
 
+// adapted from Woop, Benthin and Wald's "Watertight Ray/Triangle Intersection", without the double precision fallback
+bool moRayTriangleIntersectWatertight(in MoTriangle self, in MoRay ray, out float t, out float u, out float v)
+{
+    float EPSILON = 0.0000001f;
+    vec3 a = self.v0 - ray.origin;
+    vec3 b = self.v1 - ray.origin;
+    vec3 c = self.v2 - ray.origin;
+    vec2 a2 = vec2(a[ray.k.x], a[ray.k.y]) - ray.shear.xy * a[ray.k.z];
+    vec2 b2 = vec2(b[ray.k.x], b[ray.k.y]) - ray.shear.xy * b[ray.k.z];
+    vec2 c2 = vec2(c[ray.k.x], c[ray.k.y]) - ray.shear.xy * c[ray.k.z];
+
+    // precise, edges shared by two triangles must round the same way in both
+    precise float e0 = c2.x * b2.y - c2.y * b2.x;
+    precise float e1 = a2.x * c2.y - a2.y * c2.x;
+    precise float e2 = b2.x * a2.y - b2.y * a2.x;
+    if ((e0 < 0.0 || e1 < 0.0 || e2 < 0.0) && (e0 > 0.0 || e1 > 0.0 || e2 > 0.0))
+    {
+        return false;
+    }
+    float determinant = e0 + e1 + e2;
+    if (determinant == 0.0)
+    {
+        return false;
+    }
+
+    t = ray.shear.z * (e0 * a[ray.k.z] + e1 * b[ray.k.z] + e2 * c[ray.k.z]) / determinant;
+    u = e1 / determinant;
+    v = e2 / determinant;
+    return t > EPSILON;
+}
+
+// maps a triangle onto the unit triangle, rows of the inverse of [edge1 edge2 normal v0]
+struct MoTriangleTransform
+{
+    vec4 m0, m1, m2;
+};
+
+// adapted from Sven Woop's "A Ray Tracing Hardware Architecture for Dynamic Scenes"
+bool moRayTriangleIntersect(in MoTriangleTransform self, in MoRay ray, out float t, out float u, out float v)
+{
+    float EPSILON = 0.0000001f;
+    t = -(dot(self.m2.xyz, ray.origin) + self.m2.w) / dot(self.m2.xyz, ray.direction);
+    u = dot(self.m0.xyz, ray.origin) + self.m0.w + t * dot(self.m0.xyz, ray.direction);
+    v = dot(self.m1.xyz, ray.origin) + self.m1.w + t * dot(self.m1.xyz, ray.direction);
+    // written so that the NaNs of degenerate and parallel cases fail
+    return t > EPSILON && u >= 0.0 && v >= 0.0 && u + v <= 1.0;
+}
+
 /// BVH
+// MO_BVH_STACK_SIZE of mo_bvh.h, trees are at most MO_BVH_STACK_SIZE - 1 levels deep
+#define MO_BVH_STACK_SIZE 64
+
 struct MoBVHSplitNode
 {
     MoBBox boundingBox;
     uint start;
     uint offset;
+    uint count;
+};
+
+// bounds relative to the parent's, min and max packed little endian as in MoBVHQuantizedNode16 of mo_bvh.h
+struct MoBVHQuantizedNode16
+{
+    uint bounds[3];
+    // leaves: first triangle of the range, otherwise offset of the right child
+    uint index;
+    // leaves: number of triangles in the range, 0 otherwise
+    uint count;
+};
+
+struct MoBVHQuantizedNode8
+{
+    uint bounds[2];
+    uint index;
+    uint count;
 };
 
+// the node is loaded again when popped, from the parent bounds kept alongside with the quantized formats
 struct MoBVHWorkingSet
 {
     uint index;
@@ -96,3 +193,268 @@ struct MoIntersectResult
     MoTriangle triangle;
     float distance;
 };
+
+/// BVH TRAVERSAL
+layout(std430, set = 3, binding = 0) buffer BVHObjects
+{
+    MoTriangle pObjects[];
+} inBVHObjects;
+// same binding, the mesh's vertex buffer, tightly packed
+layout(std430, set = 3, binding = 0) buffer BVHVertices
+{
+    float pVertices[];
+} inBVHVertices;
+layout(std430, set = 3, binding = 1) buffer BVHSplitNodes
+{
+    MoBVHSplitNode pSplitNodes[];
+} inBVHSplitNodes;
+// same binding, the quantized nodes follow the root bounds
+layout(std430, set = 3, binding = 1) buffer BVHQuantizedNodes16
+{
+    MoBBox boundingBox;
+    MoBVHQuantizedNode16 pNodes[];
+} inBVHQuantizedNodes16;
+layout(std430, set = 3, binding = 1) buffer BVHQuantizedNodes8
+{
+    MoBBox boundingBox;
+    MoBVHQuantizedNode8 pNodes[];
+} inBVHQuantizedNodes8;
+layout(std430, set = 3, binding = 2) buffer BVHTransforms
+{
+    MoTriangleTransform pTransforms[];
+} inBVHTransforms;
+// the mesh's index buffer, in leaf order
+layout(std430, set = 3, binding = 3) buffer BVHIndices
+{
+    uint pIndices[];
+} inBVHIndices;
+
+vec3 moLoadBVHVertex(uint index)
+{
+    return vec3(inBVHVertices.pVertices[index * 3], inBVHVertices.pVertices[index * 3 + 1], inBVHVertices.pVertices[index * 3 + 2]);
+}
+
+MoTriangle moLoadBVHTriangle(uint index)
+{
+    if (moBVHTriangleStorage == MO_BVH_TRIANGLE_STORAGE_INDEXED)
+    {
+        return MoTriangle(moLoadBVHVertex(inBVHIndices.pIndices[index * 3]),
+                          moLoadBVHVertex(inBVHIndices.pIndices[index * 3 + 1]),
+                          moLoadBVHVertex(inBVHIndices.pIndices[index * 3 + 2]));
+    }
+    return inBVHObjects.pObjects[index];
+}
+
+bool moIntersectBVHTriangle(uint index, in MoRay ray, out float t, out float u, out float v)
+{
+    if (moBVHTriangleFormat == MO_BVH_TRIANGLE_FORMAT_WATERTIGHT)
+    {
+        return moRayTriangleIntersectWatertight(moLoadBVHTriangle(index), ray, t, u, v);
+    }
+    if (moBVHTriangleFormat == MO_BVH_TRIANGLE_FORMAT_TRANSFORM)
+    {
+        return moRayTriangleIntersect(inBVHTransforms.pTransforms[index], ray, t, u, v);
+    }
+    return moRayTriangleIntersect(moLoadBVHTriangle(index), ray, t, u, v);
+}
+
+// the same arithmetic as moDequantize of mo_bvh.cpp, precise so that the bounds stay conservative
+MoBBox moDequantize(in vec3 quantizedMin, in vec3 quantizedMax, float maxQuantized, in MoBBox parent)
+{
+    precise vec3 step = (parent.max - parent.min) * (1.0 / maxQuantized);
+    precise vec3 boundingBoxMin = parent.min + quantizedMin * step;
+    precise vec3 boundingBoxMax = parent.max - (maxQuantized - quantizedMax) * step;
+    return MoBBox(boundingBoxMin, boundingBoxMax);
+}
+
+// bounds of the root's parent, the quantized root is relative to them
+MoBBox moBVHBoundingBox()
+{
+    if (moBVHNodeFormat == MO_BVH_NODE_FORMAT_QUANTIZED_16)
+    {
+        return inBVHQuantizedNodes16.boundingBox;
+    }
+    if (moBVHNodeFormat == MO_BVH_NODE_FORMAT_QUANTIZED_8)
+    {
+        return inBVHQuantizedNodes8.boundingBox;
+    }
+    return inBVHSplitNodes.pSplitNodes[0].boundingBox;
+}
+
+// nodes are decoded from their parent's bounds
+bool moBVHQuantized()
+{
+    return moBVHNodeFormat != MO_BVH_NODE_FORMAT_FLOAT;
+}
+
+// node at index with its bounds decoded from the parent's, parent is unused by MO_BVH_NODE_FORMAT_FLOAT
+MoBVHSplitNode moLoadBVHSplitNode(uint index, in MoBBox parent)
+{
+    if (moBVHNodeFormat == MO_BVH_NODE_FORMAT_QUANTIZED_16)
+    {
+        MoBVHQuantizedNode16 node = inBVHQuantizedNodes16.pNodes[index];
+        vec3 quantizedMin = vec3(node.bounds[0] & 0xffffu, node.bounds[0] >> 16, node.bounds[1] & 0xffffu);
+        vec3 quantizedMax = vec3(node.bounds[1] >> 16, node.bounds[2] & 0xffffu, node.bounds[2] >> 16);
+        MoBBox boundingBox = moDequantize(quantizedMin, quantizedMax, 65535.0, parent);
+        return node.count != 0 ? MoBVHSplitNode(boundingBox, node.index, 0u, node.count)
+                               : MoBVHSplitNode(boundingBox, 0u, node.index, 0u);
+    }
+    if (moBVHNodeFormat == MO_BVH_NODE_FORMAT_QUANTIZED_8)
+    {
+        MoBVHQuantizedNode8 node = inBVHQuantizedNodes8.pNodes[index];
+        uvec4 bytes0 = (uvec4(node.bounds[0]) >> uvec4(0, 8, 16, 24)) & 0xffu;
+        uvec2 bytes1 = (uvec2(node.bounds[1]) >> uvec2(0, 8)) & 0xffu;
+        MoBBox boundingBox = moDequantize(vec3(bytes0.xyz), vec3(bytes0.w, bytes1), 255.0, parent);
+        return node.count != 0 ? MoBVHSplitNode(boundingBox, node.index, 0u, node.count)
+                               : MoBVHSplitNode(boundingBox, 0u, node.index, 0u);
+    }
+    return inBVHSplitNodes.pSplitNodes[index];
+}
+
+// Working set, the parents only with the quantized formats
+MoBVHWorkingSet traversal[MO_BVH_STACK_SIZE];
+MoBBox traversalParents[MO_BVH_STACK_SIZE];
+void moPushBVHWorkingSet(inout int stackPtr, uint index, float distance, in MoBBox parent)
+{
+    ++stackPtr;
+    traversal[stackPtr] = MoBVHWorkingSet(index, distance);
+    if (moBVHQuantized())
+    {
+        traversalParents[stackPtr] = parent;
+    }
+}
+
+bool moIntersectTriangleBVH(in MoRay ray, out MoIntersectResult result)
+{
+    result.distance = 1.0 / 0.0;
+    int stackPtr = -1;
+
+    moPushBVHWorkingSet(stackPtr, 0u, -1.0 / 0.0, moBVHBoundingBox());
+
+    while (stackPtr >= 0)
+    {
+        uint index = traversal[stackPtr].index;
+        float near = traversal[stackPtr].distance;
+        int parent = stackPtr;
+        stackPtr--;
+
+        if (near > result.distance)
+        {
+            continue;
+        }
+
+        MoBVHSplitNode node = moLoadBVHSplitNode(index, traversalParents[moBVHQuantized() ? parent : 0]);
+
+        if (node.offset == 0)
+        {
+            for (uint i = node.start; i < node.start + node.count; ++i)
+            {
+                float t = 1.0 / 0.0;
+                float u, v;
+                if (moIntersectBVHTriangle(i, ray, t, u, v))
+                {
+                    if (t < result.distance)
+                    {
+                        result.triangle = moLoadBVHTriangle(i);
+                        result.distance = t;
+                    }
+                }
+            }
+        }
+        else
+        {
+            uint closer = index + 1;
+            uint other = index + node.offset;
+            MoBVHSplitNode closerNode = moLoadBVHSplitNode(closer, node.boundingBox);
+            MoBVHSplitNode otherNode = moLoadBVHSplitNode(other, node.boundingBox);
+
+            float bbhits[5];
+
+            bool hitLeft = moIntersect(closerNode.boundingBox, ray, bbhits[0], bbhits[1]);
+            bool hitRight = moIntersect(otherNode.boundingBox, ray, bbhits[2], bbhits[3]);
+
+            if (hitLeft && hitRight)
+            {
+                if (bbhits[2] < bbhits[0])
+                {
+                    other = index + 1;
+                    closer = index + node.offset;
+                    // swap
+                    bbhits[4] = bbhits[0];
+                    bbhits[0] = bbhits[2];
+                    bbhits[2] = bbhits[4];
+                    // swap
+                    bbhits[4] = bbhits[1];
+                    bbhits[1] = bbhits[3];
+                    bbhits[3] = bbhits[4];
+                }
+
+                moPushBVHWorkingSet(stackPtr, other, bbhits[2], node.boundingBox);
+                moPushBVHWorkingSet(stackPtr, closer, bbhits[0], node.boundingBox);
+            }
+            else if (hitLeft)
+            {
+                moPushBVHWorkingSet(stackPtr, closer, bbhits[0], node.boundingBox);
+            }
+            else if (hitRight)
+            {
+                moPushBVHWorkingSet(stackPtr, other, bbhits[2], node.boundingBox);
+            }
+        }
+    }
+
+    return result.distance < (1.0 / 0.0);
+}
+
+// any hit between tMin and tMax, children are visited in no particular order
+bool moOccludedBVH(in MoRay ray, float tMin, float tMax)
+{
+    uint stack[MO_BVH_STACK_SIZE];
+    MoBBox parents[MO_BVH_STACK_SIZE];
+    int stackPtr = 0;
+
+    stack[stackPtr] = 0;
+    if (moBVHQuantized())
+    {
+        parents[stackPtr] = moBVHBoundingBox();
+    }
+
+    while (stackPtr >= 0)
+    {
+        uint index = stack[stackPtr];
+        MoBVHSplitNode node = moLoadBVHSplitNode(index, parents[moBVHQuantized() ? stackPtr : 0]);
+        stackPtr--;
+
+        float t_near, t_far;
+        if (!moIntersect(node.boundingBox, ray, t_near, t_far) || t_far < tMin || t_near > tMax)
+        {
+            continue;
+        }
+
+        if (node.offset == 0)
+        {
+            for (uint i = node.start; i < node.start + node.count; ++i)
+            {
+                float t, u, v;
+                if (moIntersectBVHTriangle(i, ray, t, u, v) && t >= tMin && t <= tMax)
+                {
+                    return true;
+                }
+            }
+        }
+        else
+        {
+            ++stackPtr;
+            stack[stackPtr] = index + node.offset;
+            ++stackPtr;
+            stack[stackPtr] = index + 1;
+            if (moBVHQuantized())
+            {
+                parents[stackPtr - 1] = node.boundingBox;
+                parents[stackPtr] = node.boundingBox;
+            }
+        }
+    }
+
+    return false;
+}
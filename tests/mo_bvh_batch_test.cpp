@@ -0,0 +1,106 @@
+#include "mo_bvh_test.h"
+
+// moIntersectBVHBatch on one thread, several threads and a worker pool against moIntersectBVH
+
+static void moTestBatches()
+{
+    MoTestMesh testMesh = moCreateTriangleSoup(5000);
+    MoBVH bvh;
+    moCreateBVH(&testMesh.mesh, nullptr, &bvh);
+
+    std::vector<MoRay> rays(4000);
+    std::vector<MoIntersectResult> expected(rays.size());
+    std::uint32_t expectedHitCount = 0;
+    for (std::size_t i = 0; i < rays.size(); ++i)
+    {
+        rays[i] = moRandomRay();
+        expected[i] = {};
+        expectedHitCount += moIntersectBVH(bvh, rays[i], expected[i]);
+    }
+
+    MoBVHWorkerPool workerPool;
+    moCreateBVHWorkerPool(4, &workerPool);
+    for (std::uint32_t sortRays = 0; sortRays < 2; ++sortRays)
+    {
+        for (std::uint32_t threadCount : {1u, 4u, 0u})
+        {
+            MoBVHBatchInfo batchInfo = {};
+            batchInfo.threadCount = threadCount;
+            batchInfo.sortRays = sortRays;
+            // 0 runs on the pool, twice to reuse its threads
+            batchInfo.workerPool = threadCount == 0 ? workerPool : nullptr;
+            for (std::uint32_t repeat = 0; repeat < (threadCount == 0 ? 2u : 1u); ++repeat)
+            {
+                std::vector<MoIntersectResult> intersections(rays.size());
+                MO_CHECK(moIntersectBVHBatch(bvh, rays.data(), std::uint32_t(rays.size()), intersections.data(), &batchInfo) == expectedHitCount);
+                for (std::size_t i = 0; i < rays.size(); ++i)
+                {
+                    MO_CHECK(intersections[i].distance == expected[i].distance);
+                }
+            }
+        }
+    }
+
+    // fewer rays than a task, then none
+    MoBVHBatchInfo batchInfo = {};
+    batchInfo.workerPool = workerPool;
+    MoIntersectResult intersections[3] = {};
+    std::uint32_t hitCount = 0;
+    for (std::uint32_t i = 0; i < 3; ++i)
+    {
+        hitCount += expected[i].distance < std::numeric_limits<float>::max();
+    }
+    MO_CHECK(moIntersectBVHBatch(bvh, rays.data(), 3, intersections, &batchInfo) == hitCount);
+    MO_CHECK(moIntersectBVHBatch(bvh, rays.data(), 0, intersections, &batchInfo) == 0);
+
+    moDestroyBVHWorkerPool(workerPool);
+    moDestroyBVH(bvh);
+}
+
+int main()
+{
+    moTestBatches();
+    return moTestResult();
+}
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE A - MIT License
+Copyright (c) 2018 Patrick Pelletier
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE B - Public Domain (www.unlicense.org)
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------
+*/
@@ -0,0 +1,294 @@
+#include "mo_bvh_test.h"
+
+// every build mode and format against brute force
+
+struct MoTreeInfo
+{
+    std::uint32_t depth;
+    std::uint32_t leafCount;
+    std::uint32_t maxLeafSize;
+};
+
+// every node is reached once, bounds contain what is below them and every triangle is in exactly one leaf
+static MoTreeInfo moVerifySplitNodes(MoBVH bvh)
+{
+    MoTreeInfo info = {};
+    std::vector<std::uint32_t> leafCounts(bvh->triangleCount, 0);
+    std::uint32_t nodeCount = 0;
+
+    // spatial splits clip the bounds of the triangles they copy
+    std::vector<std::uint32_t> copyCounts(bvh->triangleCount, 0);
+    for (std::uint32_t i = 0; i < bvh->triangleCount; ++i)
+    {
+        ++copyCounts[bvh->pSourceTriangles[i]];
+    }
+
+    struct Entry
+    {
+        std::uint32_t index;
+        std::uint32_t depth;
+    };
+    std::vector<Entry> entries = {{0, 0}};
+    while (!entries.empty() && bvh->splitNodeCount > 0)
+    {
+        const Entry entry = entries.back();
+        entries.pop_back();
+        ++nodeCount;
+        info.depth = std::max(info.depth, entry.depth);
+
+        const MoBVHSplitNode& node = bvh->pSplitNodes[entry.index];
+        if (node.offset == 0)
+        {
+            ++info.leafCount;
+            info.maxLeafSize = std::max(info.maxLeafSize, node.count);
+            MO_CHECK(node.count > 0 && node.start + node.count <= bvh->triangleCount);
+            for (std::uint32_t i = node.start; i < std::min(node.start + node.count, bvh->triangleCount); ++i)
+            {
+                const MoBBox boundingBox = moGetBVHTriangle(bvh, i).getBoundingBox();
+                if (copyCounts[bvh->pSourceTriangles[i]] > 1)
+                {
+                    MO_CHECK(minelem(boundingBox.max - node.boundingBox.min) >= 0.f && maxelem(boundingBox.min - node.boundingBox.max) <= 0.f);
+                }
+                else
+                {
+                    MO_CHECK(minelem(boundingBox.min - node.boundingBox.min) >= 0.f && maxelem(boundingBox.max - node.boundingBox.max) <= 0.f);
+                }
+                ++leafCounts[i];
+            }
+            continue;
+        }
+
+        MO_CHECK(node.offset >= 2 && entry.index + node.offset < bvh->splitNodeCount);
+        if (node.offset < 2 || entry.index + node.offset >= bvh->splitNodeCount)
+        {
+            continue;
+        }
+        for (std::uint32_t child : {entry.index + 1, entry.index + node.offset})
+        {
+            const MoBBox& boundingBox = bvh->pSplitNodes[child].boundingBox;
+            MO_CHECK(minelem(boundingBox.min - node.boundingBox.min) >= 0.f && maxelem(boundingBox.max - node.boundingBox.max) <= 0.f);
+            entries.push_back({child, entry.depth + 1});
+        }
+    }
+
+    MO_CHECK(nodeCount == bvh->splitNodeCount);
+    MO_CHECK(std::count(leafCounts.begin(), leafCounts.end(), 1u) == std::ptrdiff_t(leafCounts.size()));
+    return info;
+}
+
+// nodes are laid out depth first with the child of larger surface area next to its parent, leaves cover consecutive triangles
+static void moTestLayout(MoBVH bvh)
+{
+    std::uint32_t nextTriangle = 0;
+    for (std::uint32_t index = 0; index < bvh->splitNodeCount; ++index)
+    {
+        const MoBVHSplitNode& node = bvh->pSplitNodes[index];
+        if (node.offset == 0)
+        {
+            MO_CHECK(node.start == nextTriangle);
+            nextTriangle = node.start + node.count;
+        }
+        else if (index + node.offset < bvh->splitNodeCount)
+        {
+            MO_CHECK(bvh->pSplitNodes[index + 1].boundingBox.surfaceArea() >= bvh->pSplitNodes[index + node.offset].boundingBox.surfaceArea());
+        }
+    }
+    MO_CHECK(nextTriangle == bvh->triangleCount);
+}
+
+static void moTestBuilders()
+{
+    MoBVHCreateInfo sah = {};
+    sah.threadCount = 1;
+    MoBVHCreateInfo sahBins = sah;
+    sahBins.binCount = 4;
+    MoBVHCreateInfo sahThreaded = sah;
+    sahThreaded.threadCount = 4;
+    MoBVHCreateInfo midpoint = sah;
+    midpoint.buildMode = MO_BVH_BUILD_MODE_MIDPOINT;
+    MoBVHCreateInfo lbvh = sah;
+    lbvh.buildMode = MO_BVH_BUILD_MODE_LBVH;
+    MoBVHCreateInfo lbvh63 = lbvh;
+    lbvh63.mortonCodeBits = 63;
+    MoBVHCreateInfo lbvhThreaded = lbvh;
+    lbvhThreaded.threadCount = 4;
+    MoBVHCreateInfo spatialSplits = sah;
+    spatialSplits.buildMode = MO_BVH_BUILD_MODE_SPATIAL_SPLITS;
+    MoBVHCreateInfo watertight = sah;
+    watertight.triangleFormat = MO_BVH_TRIANGLE_FORMAT_WATERTIGHT;
+    MoBVHCreateInfo transform = midpoint;
+    transform.triangleFormat = MO_BVH_TRIANGLE_FORMAT_TRANSFORM;
+    MoBVHCreateInfo quantized16 = sah;
+    quantized16.buildMode = MO_BVH_BUILD_MODE_SPATIAL_SPLITS;
+    quantized16.nodeFormat = MO_BVH_NODE_FORMAT_QUANTIZED_16;
+    MoBVHCreateInfo quantized8 = midpoint;
+    quantized8.nodeFormat = MO_BVH_NODE_FORMAT_QUANTIZED_8;
+    MoBVHCreateInfo indexed = sah;
+    indexed.triangleStorage = MO_BVH_TRIANGLE_STORAGE_INDEXED;
+    indexed.nodeFormat = MO_BVH_NODE_FORMAT_QUANTIZED_8;
+
+    std::vector<const MoBVHCreateInfo*> createInfos = {nullptr, &sah, &sahBins, &midpoint};
+    createInfos.insert(createInfos.end(), {&sahThreaded});
+    createInfos.insert(createInfos.end(), {&lbvh, &lbvh63, &lbvhThreaded});
+    createInfos.insert(createInfos.end(), {&watertight, &transform});
+    createInfos.insert(createInfos.end(), {&quantized16, &quantized8});
+    createInfos.insert(createInfos.end(), {&indexed});
+    createInfos.insert(createInfos.end(), {&spatialSplits});
+    const MoTestMesh meshes[] = {moCreateHeightField(60), moCreateTriangleSoup(3000), moCreateSkinnyTriangles(2000)};
+    for (const MoTestMesh& sourceMesh : meshes)
+    {
+        for (const MoBVHCreateInfo* pCreateInfo : createInfos)
+        {
+            // indexed storage reorders the mesh's indices
+            MoTestMesh testMesh = moCopyMesh(sourceMesh);
+            MoBVH bvh;
+            moCreateBVH(&testMesh.mesh, pCreateInfo, &bvh);
+
+            const MoTreeInfo info = moVerifySplitNodes(bvh);
+            MO_CHECK(info.depth < MO_BVH_STACK_SIZE);
+            MO_CHECK(info.maxLeafSize <= MO_BVH_DEFAULT_MAX_LEAF_SIZE);
+            if (pCreateInfo && pCreateInfo->buildMode == MO_BVH_BUILD_MODE_SPATIAL_SPLITS)
+            {
+                MO_CHECK(bvh->triangleCount <= testMesh.mesh.indexCount / 3 * (100 + MO_BVH_DEFAULT_SPATIAL_SPLIT_BUDGET) / 100);
+            }
+            else
+            {
+                MO_CHECK(bvh->triangleCount == testMesh.mesh.indexCount / 3);
+            }
+            moTestLayout(bvh);
+
+            moTestTraversal(testMesh, bvh, 200);
+            moDestroyBVH(bvh);
+        }
+    }
+}
+
+// leaves hold up to maxLeafSize triangles, whatever the build mode
+static void moTestLeafSizes()
+{
+    MoTestMesh testMesh = moCreateTriangleSoup(2000);
+    for (std::uint32_t maxLeafSize : {1u, 2u, 8u})
+    {
+        for (MoBVHBuildMode buildMode : {MO_BVH_BUILD_MODE_BINNED_SAH, MO_BVH_BUILD_MODE_MIDPOINT, MO_BVH_BUILD_MODE_LBVH})
+        {
+            MoBVHCreateInfo createInfo = {};
+            createInfo.buildMode = buildMode;
+            createInfo.maxLeafSize = maxLeafSize;
+            MoBVH bvh;
+            moCreateBVH(&testMesh.mesh, &createInfo, &bvh);
+
+            const MoTreeInfo info = moVerifySplitNodes(bvh);
+            MO_CHECK(info.maxLeafSize <= maxLeafSize);
+            MO_CHECK(info.leafCount * maxLeafSize >= bvh->triangleCount);
+            if (maxLeafSize == 1)
+            {
+                MO_CHECK(info.leafCount == bvh->triangleCount);
+            }
+
+            moTestTraversal(testMesh, bvh, 100);
+            moDestroyBVH(bvh);
+        }
+    }
+}
+
+// triangles across the plane x = 2^(i - 100) pile up in one branch per level with every build mode but spatial splits,
+// the builders stop splitting at the depth the traversal stacks hold
+static void moTestDepth()
+{
+    MoTestMesh testMesh;
+    for (std::uint32_t i = 0; i < 200; ++i)
+    {
+        const float x = std::ldexp(1.f, int(i) - 100);
+        const std::uint32_t first = std::uint32_t(testMesh.vertices.size());
+        testMesh.vertices.insert(testMesh.vertices.end(), {float3(x, -1.f, -1.f), float3(x, 1.f, -1.f), float3(x, 0.f, 1.f)});
+        testMesh.indices.insert(testMesh.indices.end(), {first, first + 1, first + 2});
+    }
+    // enough triangles under the first levels for the threaded builds to split them in parallel
+    for (std::uint32_t i = 0; i < 5000; ++i)
+    {
+        const float x = std::ldexp(moRandom(-1.f, 1.f), -120);
+        const std::uint32_t first = std::uint32_t(testMesh.vertices.size());
+        testMesh.vertices.insert(testMesh.vertices.end(), {float3(x, moRandom(-1.f, 0.f), -1.f), float3(x, moRandom(0.f, 1.f), -1.f), float3(x, 0.f, 1.f)});
+        testMesh.indices.insert(testMesh.indices.end(), {first, first + 1, first + 2});
+    }
+    moFinalizeMesh(testMesh);
+
+    for (MoBVHBuildMode buildMode : {MO_BVH_BUILD_MODE_MIDPOINT, MO_BVH_BUILD_MODE_BINNED_SAH, MO_BVH_BUILD_MODE_LBVH, MO_BVH_BUILD_MODE_SPATIAL_SPLITS})
+    {
+        for (std::uint32_t threadCount : {1u, 4u})
+        {
+            MoBVHCreateInfo createInfo = {};
+            createInfo.buildMode = buildMode;
+            createInfo.maxLeafSize = 1;
+            createInfo.threadCount = threadCount;
+            MoBVH bvh;
+            moCreateBVH(&testMesh.mesh, &createInfo, &bvh);
+            const MoTreeInfo info = moVerifySplitNodes(bvh);
+            MO_CHECK(info.depth < MO_BVH_STACK_SIZE);
+
+            // along the pile, through every level of the tree
+            for (float direction : {1.f, -1.f})
+            {
+                const MoRay ray(float3(-direction * 2.f, 0.f, 0.f), float3(direction, 0.f, 0.f));
+                float expectedDistance;
+                const bool expectedHit = moIntersectBruteForce(bvh, ray, expectedDistance);
+                MoIntersectResult intersection = {};
+                const bool hit = moIntersectBVH(bvh, ray, intersection);
+                MO_CHECK(moSameHit(hit, intersection.distance, expectedHit, expectedDistance));
+                MO_CHECK(moOccludedBVH(bvh, ray, std::numeric_limits<float>::max()) == expectedHit);
+            }
+            moTestTraversal(testMesh, bvh, 50);
+            moDestroyBVH(bvh);
+        }
+    }
+}
+
+int main()
+{
+    moTestBuilders();
+    moTestLeafSizes();
+    moTestDepth();
+    return moTestResult();
+}
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE A - MIT License
+Copyright (c) 2018 Patrick Pelletier
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE B - Public Domain (www.unlicense.org)
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------
+*/
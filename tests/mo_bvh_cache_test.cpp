@@ -0,0 +1,152 @@
+#include "mo_bvh_test.h"
+
+#include <cstddef>
+
+// moSaveBVH and moLoadBVH round trips, and the cache files moLoadBVH must reject
+
+static void moTestCache()
+{
+    const char* pPath = "mo_bvh_test.bvh";
+    MoBVHCreateInfo sah = {};
+    MoBVHCreateInfo quantized = sah;
+    quantized.nodeFormat = MO_BVH_NODE_FORMAT_QUANTIZED_16;
+    quantized.triangleFormat = MO_BVH_TRIANGLE_FORMAT_TRANSFORM;
+    MoBVHCreateInfo indexed = sah;
+    indexed.buildMode = MO_BVH_BUILD_MODE_LBVH;
+    indexed.triangleStorage = MO_BVH_TRIANGLE_STORAGE_INDEXED;
+    indexed.nodeFormat = MO_BVH_NODE_FORMAT_QUANTIZED_8;
+    for (const MoBVHCreateInfo* pCreateInfo : {&sah, &quantized, &indexed})
+    {
+        MoTestMesh builtMesh = moCreateTriangleSoup(3000);
+        MoTestMesh loadedMesh = moCopyMesh(builtMesh);
+        const std::uint64_t sourceHash = moHashBVHSource(&builtMesh.mesh, pCreateInfo);
+
+        // the thread count and options spelled out at their defaults do not change the tree
+        MoBVHCreateInfo other = *pCreateInfo;
+        other.threadCount = 7;
+        other.binCount = MO_BVH_DEFAULT_BIN_COUNT;
+        other.maxLeafSize = MO_BVH_DEFAULT_MAX_LEAF_SIZE;
+        MO_CHECK(moHashBVHSource(&builtMesh.mesh, &other) == sourceHash);
+        other.maxLeafSize = 2;
+        MO_CHECK(moHashBVHSource(&builtMesh.mesh, &other) != sourceHash);
+        MoTestMesh otherMesh = moCreateTriangleSoup(3000);
+        MO_CHECK(moHashBVHSource(&otherMesh.mesh, pCreateInfo) != sourceHash);
+
+        MoBVH bvh;
+        moCreateBVH(&builtMesh.mesh, pCreateInfo, &bvh);
+        MO_CHECK(moSaveBVH(bvh, sourceHash, pPath));
+
+        MoBVH loaded = nullptr;
+        MO_CHECK(moLoadBVH(&loadedMesh.mesh, sourceHash, pPath, &loaded));
+        if (loaded == nullptr)
+        {
+            moDestroyBVH(bvh);
+            continue;
+        }
+        MO_CHECK(loadedMesh.indices == builtMesh.indices);
+        MO_CHECK(loaded->splitNodeCount == bvh->splitNodeCount);
+        for (std::uint32_t i = 0; i < 300; ++i)
+        {
+            const MoRay ray = moRandomRay();
+            MoIntersectResult built = {}, cached = {};
+            MO_CHECK(moIntersectBVH(bvh, ray, built) == moIntersectBVH(loaded, ray, cached));
+            MO_CHECK(built.distance == cached.distance && built.triangleIndex == cached.triangleIndex);
+        }
+
+        // a mapped tree refits in memory
+        for (float3& vertex : loadedMesh.vertices)
+        {
+            vertex = vertex * 1.1f;
+        }
+        moRefitBVH(loaded, loadedMesh.vertices.data());
+        moTestTraversal(loadedMesh, loaded, 100);
+        moDestroyBVH(loaded);
+
+        // stale hashes, damaged nodes and truncated files are rejected
+        MoTestMesh rejectedMesh = moCopyMesh(builtMesh);
+        MoBVH rejected = nullptr;
+        MO_CHECK(!moLoadBVH(&rejectedMesh.mesh, sourceHash + 1, pPath, &rejected));
+
+        std::uint32_t leaf = 0;
+        while (bvh->pSplitNodes[leaf].count == 0)
+        {
+            ++leaf;
+        }
+        const std::size_t splitNodesOffset = 64;
+        const std::uint32_t damagedValues[] = {0xfffffff0u, bvh->triangleCount};
+        const std::size_t damagedOffsets[] = {splitNodesOffset + offsetof(MoBVHSplitNode, offset),
+                                              splitNodesOffset + leaf * sizeof(MoBVHSplitNode) + offsetof(MoBVHSplitNode, start)};
+        for (std::uint32_t k = 0; k < 2; ++k)
+        {
+            MO_CHECK(moSaveBVH(bvh, sourceHash, pPath));
+            FILE* pFile = fopen(pPath, "r+b");
+            fseek(pFile, long(damagedOffsets[k]), SEEK_SET);
+            fwrite(&damagedValues[k], sizeof(std::uint32_t), 1, pFile);
+            fclose(pFile);
+            MO_CHECK(!moLoadBVH(&rejectedMesh.mesh, sourceHash, pPath, &rejected));
+        }
+
+        MO_CHECK(moSaveBVH(bvh, sourceHash, pPath));
+        {
+            FILE* pFile = fopen(pPath, "rb");
+            std::vector<char> contents(200);
+            MO_CHECK(fread(contents.data(), 1, contents.size(), pFile) == contents.size());
+            fclose(pFile);
+            pFile = fopen(pPath, "wb");
+            fwrite(contents.data(), 1, contents.size(), pFile);
+            fclose(pFile);
+        }
+        MO_CHECK(!moLoadBVH(&rejectedMesh.mesh, sourceHash, pPath, &rejected));
+
+        moDestroyBVH(bvh);
+    }
+    remove(pPath);
+}
+
+int main()
+{
+    moTestCache();
+    return moTestResult();
+}
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE A - MIT License
+Copyright (c) 2018 Patrick Pelletier
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE B - Public Domain (www.unlicense.org)
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------
+*/
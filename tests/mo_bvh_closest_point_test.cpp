@@ -0,0 +1,110 @@
+#include "mo_bvh_test.h"
+
+// moClosestPointBVH and moClosestPointBVHBatch against the nearest of every triangle
+
+static float moClosestPointBruteForce(const MoTestMesh& testMesh, const float3& point)
+{
+    float closest = std::numeric_limits<float>::max();
+    for (std::uint32_t triangle = 0; triangle < testMesh.mesh.indexCount / 3; ++triangle)
+    {
+        closest = std::min(closest, moDistanceSquared(point, moMeshTriangle(testMesh, triangle)));
+    }
+    return std::sqrt(closest);
+}
+
+static void moTestClosestPoints()
+{
+    MoBVHCreateInfo sah = {};
+    MoBVHCreateInfo quantized = sah;
+    quantized.nodeFormat = MO_BVH_NODE_FORMAT_QUANTIZED_8;
+    for (const MoBVHCreateInfo* pCreateInfo : {&sah, &quantized})
+    {
+        MoTestMesh testMesh = moCreateTriangleSoup(5000);
+        MoBVH bvh;
+        moCreateBVH(&testMesh.mesh, pCreateInfo, &bvh);
+
+        std::vector<float3> points(300);
+        for (float3& point : points)
+        {
+            point = float3(moRandom(-70.f, 70.f), moRandom(-70.f, 70.f), moRandom(-70.f, 70.f));
+        }
+
+        // one by one and batched on a pool
+        MoBVHWorkerPool workerPool;
+        moCreateBVHWorkerPool(4, &workerPool);
+        MoBVHBatchInfo batchInfo = {};
+        batchInfo.sortRays = true;
+        batchInfo.workerPool = workerPool;
+        std::vector<MoIntersectResult> closest(points.size());
+        MO_CHECK(moClosestPointBVHBatch(bvh, points.data(), std::uint32_t(points.size()), std::numeric_limits<float>::max(), closest.data(), &batchInfo) == points.size());
+        moDestroyBVHWorkerPool(workerPool);
+
+        for (std::size_t i = 0; i < points.size(); ++i)
+        {
+            const float expectedDistance = moClosestPointBruteForce(testMesh, points[i]);
+            const float tolerance = 1e-3f * std::max(1.f, expectedDistance);
+            MoIntersectResult result = {};
+            MO_CHECK(moClosestPointBVH(bvh, points[i], std::numeric_limits<float>::max(), result));
+            MO_CHECK(std::abs(result.distance - expectedDistance) <= tolerance);
+            MO_CHECK(std::abs(closest[i].distance - expectedDistance) <= tolerance);
+
+            // the barycentric coordinates locate the point on the triangle
+            const MoTriangle triangle = moGetBVHTriangle(bvh, result.triangleIndex);
+            const float3 position = triangle.v0 * result.barycentric.x + triangle.v1 * result.barycentric.y + triangle.v2 * result.barycentric.z;
+            MO_CHECK(std::abs(length(position - points[i]) - result.distance) <= tolerance);
+            if (expectedDistance > 1e-3f)
+            {
+                MO_CHECK(!moClosestPointBVH(bvh, points[i], expectedDistance * 0.5f, result));
+            }
+        }
+        moDestroyBVH(bvh);
+    }
+}
+
+int main()
+{
+    moTestClosestPoints();
+    return moTestResult();
+}
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE A - MIT License
+Copyright (c) 2018 Patrick Pelletier
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE B - Public Domain (www.unlicense.org)
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------
+*/
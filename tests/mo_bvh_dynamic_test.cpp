@@ -0,0 +1,225 @@
+#include "mo_bvh_test.h"
+
+// the dynamic BVH's invariants and queries against a list of the live objects
+
+// parent links, bounds and heights of the subtree, returns its height
+static std::int32_t moVerifyDynamicNode(MoDynamicBVH dynamicBVH, std::uint32_t index)
+{
+    const MoDynamicBVHNode& node = dynamicBVH->pNodes[index];
+    if (node.left == MO_DYNAMIC_BVH_NULL)
+    {
+        MO_CHECK(node.height == 0);
+        return 0;
+    }
+    const MoDynamicBVHNode& left = dynamicBVH->pNodes[node.left];
+    const MoDynamicBVHNode& right = dynamicBVH->pNodes[node.right];
+    MO_CHECK(left.parent == index && right.parent == index);
+    for (std::uint32_t axis = 0; axis < 3; ++axis)
+    {
+        MO_CHECK(node.boundingBox.min[axis] <= std::min(left.boundingBox.min[axis], right.boundingBox.min[axis]));
+        MO_CHECK(node.boundingBox.max[axis] >= std::max(left.boundingBox.max[axis], right.boundingBox.max[axis]));
+    }
+    const std::int32_t leftHeight = moVerifyDynamicNode(dynamicBVH, node.left);
+    const std::int32_t rightHeight = moVerifyDynamicNode(dynamicBVH, node.right);
+    MO_CHECK(node.height == 1 + std::max(leftHeight, rightHeight));
+    return node.height;
+}
+
+static bool moOverlap(const MoBBox& a, const MoBBox& b)
+{
+    return a.min.x <= b.max.x && a.min.y <= b.max.y && a.min.z <= b.max.z
+        && b.min.x <= a.max.x && b.min.y <= a.max.y && b.min.z <= a.max.z;
+}
+
+// entry distance of the ray into the box, 0 from inside
+static bool moIntersectBox(const MoBBox& boundingBox, const MoRay& ray, float& t)
+{
+    float tNear, tFar;
+    if (!boundingBox.intersect(ray, tNear, tFar) || tFar < 0.f)
+    {
+        return false;
+    }
+    t = std::max(tNear, 0.f);
+    return true;
+}
+
+// MoIntersectObjectFunction of the objects' exact boxes, pUserData is the vector of them
+static bool moIntersectObject(std::uint32_t object, const MoRay& ray, MoIntersectResult& intersection, void* pUserData)
+{
+    const std::vector<MoBBox>& boxes = *static_cast<const std::vector<MoBBox>*>(pUserData);
+    float t;
+    if (!moIntersectBox(boxes[object], ray, t) || t >= intersection.distance)
+    {
+        return false;
+    }
+    intersection.distance = t;
+    return true;
+}
+
+static void moTestDynamic()
+{
+    // sorted insertions stay logarithmic
+    {
+        MoDynamicBVH dynamicBVH;
+        moCreateDynamicBVH(nullptr, &dynamicBVH);
+        for (std::uint32_t i = 0; i < 4096; ++i)
+        {
+            moInsertDynamicBVH(dynamicBVH, MoBBox(float3(float(i), 0.f, 0.f), float3(float(i) + 0.5f, 0.5f, 0.5f)));
+        }
+        moVerifyDynamicNode(dynamicBVH, dynamicBVH->root);
+        MO_CHECK(dynamicBVH->pNodes[dynamicBVH->root].height <= 24);
+        moDestroyDynamicBVH(dynamicBVH);
+    }
+
+    // random inserts, moves and removals against a list of the live objects
+    MoDynamicBVH dynamicBVH;
+    moCreateDynamicBVH(nullptr, &dynamicBVH);
+    std::vector<MoBBox> boxes;
+    std::vector<bool> alive;
+    auto insert = [&]()
+    {
+        const float3 center(moRandom(-50.f, 50.f), moRandom(-50.f, 50.f), moRandom(-50.f, 50.f));
+        const float3 extent(moRandom(0.2f, 2.f));
+        const MoBBox boundingBox(center - extent, center + extent);
+        const std::uint32_t object = moInsertDynamicBVH(dynamicBVH, boundingBox);
+        if (object >= boxes.size())
+        {
+            boxes.resize(object + 1);
+            alive.resize(object + 1, false);
+        }
+        boxes[object] = boundingBox;
+        alive[object] = true;
+    };
+    for (std::uint32_t step = 0; step < 50; ++step)
+    {
+        for (std::uint32_t k = 0; k < 100; ++k)
+        {
+            insert();
+        }
+        for (std::uint32_t object = 0; object < boxes.size(); ++object)
+        {
+            if (alive[object] && g_Generator() % 4 == 0)
+            {
+                const float3 offset(moRandom(-0.3f, 0.3f), moRandom(-0.3f, 0.3f), moRandom(-0.3f, 0.3f));
+                boxes[object] = MoBBox(boxes[object].min + offset, boxes[object].max + offset);
+                moUpdateDynamicBVH(dynamicBVH, object, boxes[object]);
+            }
+        }
+        for (std::uint32_t k = 0; k < 40; ++k)
+        {
+            const std::uint32_t object = g_Generator() % boxes.size();
+            if (alive[object])
+            {
+                moRemoveDynamicBVH(dynamicBVH, object);
+                alive[object] = false;
+            }
+        }
+
+        moVerifyDynamicNode(dynamicBVH, dynamicBVH->root);
+        const MoBBox query(float3(moRandom(-50.f, 40.f)), float3(moRandom(40.f, 50.f)) * float3(1.f, 0.2f, 0.2f));
+        std::vector<std::uint32_t> objects(boxes.size());
+        const std::uint32_t objectCount = moOverlapDynamicBVH(dynamicBVH, query, objects.data(), std::uint32_t(objects.size()));
+        objects.resize(std::min<std::size_t>(objectCount, objects.size()));
+        for (std::uint32_t object = 0; object < boxes.size(); ++object)
+        {
+            // the tree tests the grown bounds, objects overlapping the query exactly must be among them
+            if (alive[object] && moOverlap(boxes[object], query))
+            {
+                MO_CHECK(std::find(objects.begin(), objects.end(), object) != objects.end());
+            }
+        }
+        for (std::uint32_t object : objects)
+        {
+            MO_CHECK(object < alive.size() && alive[object]);
+        }
+
+        // rays against the closest of the live objects' exact boxes
+        for (std::uint32_t i = 0; i < 50; ++i)
+        {
+            const MoRay ray = moRandomRay();
+            float expectedDistance = std::numeric_limits<float>::max();
+            for (std::uint32_t object = 0; object < boxes.size(); ++object)
+            {
+                float t;
+                if (alive[object] && moIntersectBox(boxes[object], ray, t))
+                {
+                    expectedDistance = std::min(expectedDistance, t);
+                }
+            }
+
+            MoIntersectResult intersection = {};
+            std::uint32_t object = MO_DYNAMIC_BVH_NULL;
+            const bool hit = moIntersectDynamicBVH(dynamicBVH, ray, intersection, object, moIntersectObject, &boxes);
+            MO_CHECK(hit == (expectedDistance < std::numeric_limits<float>::max()));
+            if (hit)
+            {
+                float t;
+                MO_CHECK(intersection.distance == expectedDistance);
+                MO_CHECK(object < alive.size() && alive[object] && moIntersectBox(boxes[object], ray, t) && t == expectedDistance);
+            }
+        }
+    }
+
+    // an emptied tree answers nothing
+    for (std::uint32_t object = 0; object < boxes.size(); ++object)
+    {
+        if (alive[object])
+        {
+            moRemoveDynamicBVH(dynamicBVH, object);
+        }
+    }
+    MO_CHECK(dynamicBVH->root == MO_DYNAMIC_BVH_NULL);
+    MoIntersectResult intersection = {};
+    std::uint32_t object;
+    MO_CHECK(!moIntersectDynamicBVH(dynamicBVH, moRandomRay(), intersection, object, moIntersectObject, &boxes));
+    MO_CHECK(moOverlapDynamicBVH(dynamicBVH, MoBBox(float3(-100.f), float3(100.f)), nullptr, 0) == 0);
+    moDestroyDynamicBVH(dynamicBVH);
+}
+
+int main()
+{
+    moTestDynamic();
+    return moTestResult();
+}
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE A - MIT License
+Copyright (c) 2018 Patrick Pelletier
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE B - Public Domain (www.unlicense.org)
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------
+*/
@@ -0,0 +1,100 @@
+#include "mo_bvh_test.h"
+
+// moIntersectBVHPacket against the same rays traced one at a time
+
+static void moTestPackets()
+{
+    MoTestMesh testMesh = moCreateTriangleSoup(5000);
+    MoBVH bvh;
+    moCreateBVH(&testMesh.mesh, nullptr, &bvh);
+
+    for (std::uint32_t size : {4u, 8u, 16u})
+    {
+        for (std::uint32_t p = 0; p < 100; ++p)
+        {
+            MoRayPacket packet = {};
+            packet.rayCount = size;
+            packet.activeMask = p % 7 == 0 ? 0x5555u : ~0u;
+            // coherent rays from a common origin, and every fifth packet scattered
+            const MoRay center = moRandomRay();
+            const float spread = p % 5 == 0 ? 1.f : 0.05f;
+            MoRay packetRays[MO_RAY_PACKET_MAX_SIZE];
+            for (std::uint32_t k = 0; k < size; ++k)
+            {
+                const float3 direction = normalize(center.direction + float3(moRandom(-spread, spread), moRandom(-spread, spread), moRandom(-spread, spread)));
+                packetRays[k] = MoRay(center.origin, direction);
+                packet.originX[k] = center.origin.x;
+                packet.originY[k] = center.origin.y;
+                packet.originZ[k] = center.origin.z;
+                packet.directionX[k] = direction.x;
+                packet.directionY[k] = direction.y;
+                packet.directionZ[k] = direction.z;
+            }
+            MoIntersectResult intersections[MO_RAY_PACKET_MAX_SIZE];
+            const std::uint32_t hitMask = moIntersectBVHPacket(bvh, packet, intersections);
+            for (std::uint32_t k = 0; k < size; ++k)
+            {
+                const bool packetHit = (hitMask >> k) & 1;
+                if (!(packet.activeMask & (1u << k)))
+                {
+                    MO_CHECK(!packetHit);
+                    continue;
+                }
+                MoIntersectResult intersection = {};
+                const bool hit = moIntersectBVH(bvh, packetRays[k], intersection);
+                MO_CHECK(moSameHit(packetHit, intersections[k].distance, hit, intersection.distance));
+            }
+            MO_CHECK(hitMask >> size == 0);
+        }
+    }
+
+    moDestroyBVH(bvh);
+}
+
+int main()
+{
+    moTestPackets();
+    return moTestResult();
+}
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE A - MIT License
+Copyright (c) 2018 Patrick Pelletier
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE B - Public Domain (www.unlicense.org)
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------
+*/
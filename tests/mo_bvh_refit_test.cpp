@@ -0,0 +1,91 @@
+#include "mo_bvh_test.h"
+
+// moRefitBVH after the vertices moved against brute force over the moved triangles
+
+static void moTestRefit()
+{
+    MoBVHCreateInfo sah = {};
+    MoBVHCreateInfo indexed = sah;
+    indexed.triangleStorage = MO_BVH_TRIANGLE_STORAGE_INDEXED;
+    MoBVHCreateInfo quantized = sah;
+    quantized.nodeFormat = MO_BVH_NODE_FORMAT_QUANTIZED_16;
+    quantized.triangleFormat = MO_BVH_TRIANGLE_FORMAT_TRANSFORM;
+    quantized.buildMode = MO_BVH_BUILD_MODE_SPATIAL_SPLITS;
+    std::vector<const MoBVHCreateInfo*> createInfos = {&sah};
+    createInfos.push_back(&quantized);
+    createInfos.push_back(&indexed);
+    for (const MoBVHCreateInfo* pCreateInfo : createInfos)
+    {
+        MoTestMesh testMesh = moCreateTriangleSoup(3000);
+        MoBVH bvh;
+        moCreateBVH(&testMesh.mesh, pCreateInfo, &bvh);
+
+        // move half of the vertices, the refit range must cover what changed
+        for (std::size_t i = 0; i < testMesh.vertices.size() / 2; ++i)
+        {
+            testMesh.vertices[i] = testMesh.vertices[i] * 1.3f + float3(moRandom(-1.f, 1.f), moRandom(-1.f, 1.f), moRandom(-1.f, 1.f));
+        }
+        MoBVHRefitInfo refitInfo;
+        moRefitBVH(bvh, testMesh.vertices.data(), &refitInfo);
+        MO_CHECK(refitInfo.splitNodeCount > 0);
+        MO_CHECK(refitInfo.firstSplitNode + refitInfo.splitNodeCount <= bvh->splitNodeCount);
+
+        // nothing moved the second time, indexed storage keeps no copy to compare against
+        moRefitBVH(bvh, testMesh.vertices.data(), &refitInfo);
+        if (pCreateInfo->triangleStorage != MO_BVH_TRIANGLE_STORAGE_INDEXED)
+        {
+            MO_CHECK(refitInfo.triangleCount == 0 && refitInfo.splitNodeCount == 0);
+        }
+
+        moTestTraversal(testMesh, bvh, 300);
+        moDestroyBVH(bvh);
+    }
+}
+
+int main()
+{
+    moTestRefit();
+    return moTestResult();
+}
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE A - MIT License
+Copyright (c) 2018 Patrick Pelletier
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE B - Public Domain (www.unlicense.org)
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------
+*/
@@ -0,0 +1,225 @@
+#include "mo_bvh_test.h"
+
+#include <thread>
+
+// built with MO_BVH_TRAVERSAL_STATS, the counters of moIntersectBVH against what a known tree makes it do
+
+static bool moSameStats(const MoBVHTraversalStats& a, const MoBVHTraversalStats& b)
+{
+    return a.queryCount == b.queryCount && a.nodesVisited == b.nodesVisited && a.boxTests == b.boxTests
+        && a.triangleTests == b.triangleTests && a.stackHighWater == b.stackHighWater;
+}
+
+// counters of a single moIntersectBVH from a reset
+static MoBVHTraversalStats moTraceStats(MoBVH bvh, const MoRay& ray, bool expectedHit)
+{
+    moResetBVHTraversalStats();
+    MoIntersectResult intersection = {};
+    MO_CHECK(moIntersectBVH(bvh, ray, intersection) == expectedHit);
+    return moGetBVHTraversalStats();
+}
+
+// a root and two leaves, the triangles 10 apart along x
+static void moTestKnownTree()
+{
+    MoTestMesh testMesh;
+    testMesh.vertices = {float3(0.f, 0.f, 0.f), float3(0.f, 1.f, 0.f), float3(0.f, 0.f, 1.f),
+                         float3(10.f, 0.f, 0.f), float3(10.f, 1.f, 0.f), float3(10.f, 0.f, 1.f)};
+    testMesh.indices = {0, 1, 2, 3, 4, 5};
+    moFinalizeMesh(testMesh);
+
+    for (MoBVHNodeFormat nodeFormat : {MO_BVH_NODE_FORMAT_FLOAT, MO_BVH_NODE_FORMAT_QUANTIZED_16})
+    {
+        MoBVHCreateInfo createInfo = {};
+        createInfo.buildMode = MO_BVH_BUILD_MODE_MIDPOINT;
+        createInfo.maxLeafSize = 1;
+        createInfo.nodeFormat = nodeFormat;
+        MoBVH bvh;
+        moCreateBVH(&testMesh.mesh, &createInfo, &bvh);
+
+        MoBVHStats stats;
+        moGetBVHStats(bvh, &stats);
+        MO_CHECK(stats.splitNodeCount == 1 && stats.leafCount == 2 && stats.maxDepth == 1);
+        MO_CHECK(stats.depthHistogram[0] == 0 && stats.depthHistogram[1] == 2);
+        MO_CHECK(stats.leafSizeHistogram[1] == 2);
+        MO_CHECK(stats.overlap == 0.f);
+        // the root's area is 42 and each leaf's 2, visited along with its triangle
+        MO_CHECK(std::abs(stats.sahCost - (42.f + 2.f * 2.f * 2.f) / 42.f) <= 1e-5f);
+        MO_CHECK(stats.memorySize > 3 * sizeof(MoBVHSplitNode) + 2 * sizeof(MoTriangle));
+
+        // the root is always visited, the miss tests its children and pushes nothing
+        MoBVHTraversalStats stats0 = moTraceStats(bvh, MoRay(float3(-5.f, 5.f, 5.f), float3(1.f, 0.f, 0.f)), false);
+        MO_CHECK(moSameStats(stats0, MoBVHTraversalStats{1, 1, 2, 0, 0}));
+
+        // through the first leaf only
+        MoBVHTraversalStats stats1 = moTraceStats(bvh, MoRay(float3(-5.f, 0.25f, 0.25f), normalize(float3(1.f, 0.f, 0.08f))), true);
+        MO_CHECK(moSameStats(stats1, MoBVHTraversalStats{1, 2, 2, 1, 1}));
+
+        // through both leaves, the farther one is culled by the first hit after both were pushed
+        MoBVHTraversalStats stats2 = moTraceStats(bvh, MoRay(float3(-5.f, 0.25f, 0.25f), float3(1.f, 0.f, 0.f)), true);
+        MO_CHECK(moSameStats(stats2, MoBVHTraversalStats{1, 2, 2, 1, 2}));
+
+        // a reset only clears the calling thread's counters
+        moResetBVHTraversalStats();
+        MO_CHECK(moSameStats(moGetBVHTraversalStats(), MoBVHTraversalStats{}));
+
+        MoBVHTraversalStats total = {};
+        for (const MoBVHTraversalStats& stats : {stats0, stats1, stats2})
+        {
+            moAccumulateBVHTraversalStats(stats, &total);
+        }
+        MO_CHECK(moSameStats(total, MoBVHTraversalStats{3, 5, 6, 2, 2}));
+
+        // without a reset the counters of consecutive queries add up the same way
+        for (float y : {5.f, 0.25f})
+        {
+            MoIntersectResult intersection = {};
+            moIntersectBVH(bvh, MoRay(float3(-5.f, y, 0.25f), float3(1.f, 0.f, 0.f)), intersection);
+        }
+        MO_CHECK(moSameStats(moGetBVHTraversalStats(), MoBVHTraversalStats{2, 3, 4, 1, 2}));
+        moDestroyBVH(bvh);
+    }
+}
+
+// the stack of the deepest tree the builders make stays within MO_BVH_STACK_SIZE
+static void moTestStackHighWater()
+{
+    MoTestMesh testMesh;
+    for (std::uint32_t i = 0; i < 200; ++i)
+    {
+        const float x = std::ldexp(1.f, int(i) - 100);
+        const std::uint32_t first = std::uint32_t(testMesh.vertices.size());
+        testMesh.vertices.insert(testMesh.vertices.end(), {float3(x, -1.f, -1.f), float3(x, 1.f, -1.f), float3(x, 0.f, 1.f)});
+        testMesh.indices.insert(testMesh.indices.end(), {first, first + 1, first + 2});
+    }
+    moFinalizeMesh(testMesh);
+
+    MoBVHCreateInfo createInfo = {};
+    createInfo.buildMode = MO_BVH_BUILD_MODE_MIDPOINT;
+    createInfo.maxLeafSize = 1;
+    MoBVH bvh;
+    moCreateBVH(&testMesh.mesh, &createInfo, &bvh);
+
+    MoBVHStats stats;
+    moGetBVHStats(bvh, &stats);
+    MO_CHECK(stats.maxDepth == MO_BVH_STACK_SIZE - 1);
+
+    // backwards along the pile, every level pushes the sibling it passes
+    moResetBVHTraversalStats();
+    MoIntersectResult intersection = {};
+    MO_CHECK(moIntersectBVH(bvh, MoRay(float3(3.f, 0.f, 0.f), float3(-1.f, 0.f, 0.f)), intersection));
+    const MoBVHTraversalStats traversalStats = moGetBVHTraversalStats();
+    MO_CHECK(traversalStats.stackHighWater > 1 && traversalStats.stackHighWater <= MO_BVH_STACK_SIZE);
+    MO_CHECK(traversalStats.nodesVisited > stats.maxDepth);
+    moDestroyBVH(bvh);
+}
+
+// every thread counts its own queries, their sum is the count of the same queries on one thread
+static void moTestThreads()
+{
+    MoTestMesh testMesh = moCreateHeightField(30);
+    moFinalizeMesh(testMesh);
+    MoBVH bvh;
+    moCreateBVH(&testMesh.mesh, nullptr, &bvh);
+
+    std::vector<MoRay> rays(400);
+    for (MoRay& ray : rays)
+    {
+        ray = moRandomRay();
+    }
+
+    moResetBVHTraversalStats();
+    for (const MoRay& ray : rays)
+    {
+        MoIntersectResult intersection = {};
+        moIntersectBVH(bvh, ray, intersection);
+    }
+    const MoBVHTraversalStats expected = moGetBVHTraversalStats();
+    MO_CHECK(expected.queryCount == rays.size() && expected.nodesVisited >= rays.size() && expected.triangleTests > 0);
+
+    const std::uint32_t threadCount = 4;
+    std::vector<MoBVHTraversalStats> initialStats(threadCount);
+    std::vector<MoBVHTraversalStats> threadStats(threadCount);
+    std::vector<std::thread> threads;
+    for (std::uint32_t thread = 0; thread < threadCount; ++thread)
+    {
+        threads.emplace_back([&, thread]()
+        {
+            initialStats[thread] = moGetBVHTraversalStats();
+            moResetBVHTraversalStats();
+            for (std::size_t ray = thread; ray < rays.size(); ray += threadCount)
+            {
+                MoIntersectResult intersection = {};
+                moIntersectBVH(bvh, rays[ray], intersection);
+            }
+            threadStats[thread] = moGetBVHTraversalStats();
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    MoBVHTraversalStats total = {};
+    for (std::uint32_t thread = 0; thread < threadCount; ++thread)
+    {
+        // new threads start from zero, not from the main thread's counters
+        MO_CHECK(moSameStats(initialStats[thread], MoBVHTraversalStats{}));
+        MO_CHECK(threadStats[thread].queryCount == rays.size() / threadCount);
+        moAccumulateBVHTraversalStats(threadStats[thread], &total);
+    }
+    MO_CHECK(moSameStats(total, expected));
+    // the threads' queries left the main thread's counters alone
+    MO_CHECK(moSameStats(moGetBVHTraversalStats(), expected));
+    moDestroyBVH(bvh);
+}
+
+int main()
+{
+    moTestKnownTree();
+    moTestStackHighWater();
+    moTestThreads();
+    return moTestResult();
+}
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE A - MIT License
+Copyright (c) 2018 Patrick Pelletier
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE B - Public Domain (www.unlicense.org)
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------
+*/
@@ -0,0 +1,309 @@
+#include "mo_bvh_test.h"
+
+// sphere and capsule casts and capsule overlaps against every triangle of the mesh
+
+// distance between the capsule's segment moved by offset and the triangle, convex along the segment
+static float moCapsuleDistance(const MoCapsule& capsule, const float3& offset, const MoTriangle& triangle)
+{
+    const float3 p0 = capsule.p0 + offset;
+    const float3 axis = capsule.p1 - capsule.p0;
+    float low = 0.f, high = 1.f;
+    for (std::uint32_t i = 0; i < 30 && dot(axis, axis) > 0.f; ++i)
+    {
+        const float a = low + (high - low) / 3.f;
+        const float b = high - (high - low) / 3.f;
+        if (moDistanceSquared(p0 + axis * a, triangle) < moDistanceSquared(p0 + axis * b, triangle))
+        {
+            high = b;
+        }
+        else
+        {
+            low = a;
+        }
+    }
+    return std::sqrt(moDistanceSquared(p0 + axis * ((low + high) * 0.5f), triangle));
+}
+
+enum MoSweepContact
+{
+    MoSweepContact_None,
+    MoSweepContact_Hit,
+    // the capsule grazes the triangle, too close to call
+    MoSweepContact_Grazing,
+};
+
+// first contact with the triangle moving along direction, the gap between them is convex along the sweep so that it
+// reaches zero before its lowest point if at all
+static MoSweepContact moSweepBruteForce(const MoCapsule& capsule, const float3& direction, float maxDistance, const MoTriangle& triangle, float tolerance, float& t)
+{
+    const auto gap = [&](float distance) { return moCapsuleDistance(capsule, direction * distance, triangle) - capsule.radius; };
+    t = 0.f;
+    const float start = gap(0.f);
+    if (start <= 0.f)
+    {
+        return MoSweepContact_Hit;
+    }
+    // the gap shrinks no faster than the capsule moves
+    if (start > maxDistance)
+    {
+        return MoSweepContact_None;
+    }
+
+    float low = 0.f, high = maxDistance;
+    for (std::uint32_t i = 0; i < 30; ++i)
+    {
+        const float a = low + (high - low) / 3.f;
+        const float b = high - (high - low) / 3.f;
+        if (gap(a) < gap(b))
+        {
+            high = b;
+        }
+        else
+        {
+            low = a;
+        }
+    }
+    const float lowest = gap((low + high) * 0.5f);
+    if (std::abs(lowest) <= tolerance)
+    {
+        return MoSweepContact_Grazing;
+    }
+    if (lowest > 0.f)
+    {
+        return MoSweepContact_None;
+    }
+
+    float outside = 0.f, inside = (low + high) * 0.5f;
+    for (std::uint32_t i = 0; i < 30; ++i)
+    {
+        const float middle = (outside + inside) * 0.5f;
+        (gap(middle) <= 0.f ? inside : outside) = middle;
+    }
+    t = inside;
+    return MoSweepContact_Hit;
+}
+
+// a sphere is cast when both ends of the capsule are the same point
+static void moTestCast(const MoTestMesh& testMesh, MoBVH bvh, const MoCapsule& capsule, bool sphere, const float3& direction, float maxDistance, std::uint32_t& skipped)
+{
+    const float tolerance = 5e-3f;
+
+    // the triangles whose bounds the swept capsule reaches
+    const float3 radius(capsule.radius + tolerance);
+    MoBBox sweptBox(min(capsule.p0, capsule.p1) - radius, max(capsule.p0, capsule.p1) + radius);
+    sweptBox.expandToInclude(MoBBox(sweptBox.min + direction * maxDistance, sweptBox.max + direction * maxDistance));
+
+    float expectedDistance = std::numeric_limits<float>::max();
+    for (std::uint32_t triangle = 0; triangle < testMesh.mesh.indexCount / 3; ++triangle)
+    {
+        const MoTriangle meshTriangle = moMeshTriangle(testMesh, triangle);
+        const MoBBox boundingBox = meshTriangle.getBoundingBox();
+        if (minelem(sweptBox.max - boundingBox.min) < 0.f || maxelem(sweptBox.min - boundingBox.max) > 0.f)
+        {
+            continue;
+        }
+        float t;
+        switch (moSweepBruteForce(capsule, direction, maxDistance, meshTriangle, tolerance, t))
+        {
+        case MoSweepContact_Hit:
+            expectedDistance = std::min(expectedDistance, t);
+            break;
+        case MoSweepContact_Grazing:
+            ++skipped;
+            return;
+        default:
+            break;
+        }
+    }
+    const bool expectedHit = expectedDistance <= maxDistance;
+    if (std::abs(expectedDistance - maxDistance) <= tolerance)
+    {
+        ++skipped;
+        return;
+    }
+
+    MoSweepResult result = {};
+    const bool hit = sphere ? moSphereCastBVH(bvh, capsule.p0, capsule.radius, direction, maxDistance, result)
+                            : moCapsuleCastBVH(bvh, capsule, direction, maxDistance, result);
+    MO_CHECK(hit == expectedHit);
+    if (!hit || !expectedHit)
+    {
+        return;
+    }
+    MO_CHECK(std::abs(result.distance - expectedDistance) <= tolerance);
+
+    // the triangle reported touches the capsule where it stopped, at the position given
+    MO_CHECK(result.triangleIndex < bvh->triangleCount);
+    if (result.triangleIndex >= bvh->triangleCount)
+    {
+        return;
+    }
+    const MoTriangle triangle = moGetBVHTriangle(bvh, result.triangleIndex);
+    MO_CHECK(result.sourceTriangleIndex == bvh->pSourceTriangles[result.triangleIndex]);
+    MO_CHECK(bvh->pTriangles == nullptr || result.pTriangle == &bvh->pTriangles[result.triangleIndex]);
+    const float3 offset = direction * result.distance;
+    const float distance = moCapsuleDistance(capsule, offset, triangle);
+    MO_CHECK(distance <= capsule.radius + tolerance);
+    MO_CHECK(result.distance == 0.f || distance >= capsule.radius - tolerance);
+    MO_CHECK(moDistanceSquared(result.position, triangle) <= tolerance * tolerance);
+    MO_CHECK(std::abs(length(result.normal) - 1.f) <= 1e-3f);
+    if (result.distance > 0.f)
+    {
+        // the normal points from the contact to the capsule's segment
+        const float3 onSegment = result.position + result.normal * capsule.radius;
+        MO_CHECK(moSegmentDistanceSquared(onSegment, capsule.p0 + offset, capsule.p1 + offset) <= 1e-2f * capsule.radius * capsule.radius);
+    }
+}
+
+static void moTestOverlap(const MoTestMesh& testMesh, MoBVH bvh, const MoCapsule& capsule)
+{
+    const float tolerance = 5e-3f;
+
+    std::vector<MoContact> contacts(testMesh.mesh.indexCount / 3);
+    const std::uint32_t contactCount = moOverlapCapsuleBVH(bvh, capsule, contacts.data(), std::uint32_t(contacts.size()));
+    MO_CHECK(contactCount <= contacts.size());
+    contacts.resize(std::min<std::size_t>(contactCount, contacts.size()));
+
+    // every mesh triangle once, even the ones spatial splits copied
+    std::vector<std::uint32_t> reported(testMesh.mesh.indexCount / 3, 0);
+    for (const MoContact& contact : contacts)
+    {
+        MO_CHECK(contact.triangleIndex < bvh->triangleCount && contact.sourceTriangleIndex < reported.size());
+        if (contact.triangleIndex >= bvh->triangleCount || contact.sourceTriangleIndex >= reported.size())
+        {
+            continue;
+        }
+        MO_CHECK(contact.sourceTriangleIndex == bvh->pSourceTriangles[contact.triangleIndex]);
+        ++reported[contact.sourceTriangleIndex];
+
+        const MoTriangle triangle = moGetBVHTriangle(bvh, contact.triangleIndex);
+        const float distance = moCapsuleDistance(capsule, float3(0.f), triangle);
+        MO_CHECK(std::abs(contact.depth - (capsule.radius - distance)) <= tolerance);
+        MO_CHECK(moDistanceSquared(contact.position, triangle) <= tolerance * tolerance);
+        MO_CHECK(std::abs(length(contact.normal) - 1.f) <= 1e-3f);
+        if (distance > tolerance)
+        {
+            const float3 onSegment = contact.position + contact.normal * distance;
+            MO_CHECK(moSegmentDistanceSquared(onSegment, capsule.p0, capsule.p1) <= tolerance * tolerance);
+        }
+    }
+
+    const float3 radius(capsule.radius + tolerance);
+    const MoBBox capsuleBox(min(capsule.p0, capsule.p1) - radius, max(capsule.p0, capsule.p1) + radius);
+    for (std::uint32_t triangle = 0; triangle < reported.size(); ++triangle)
+    {
+        MO_CHECK(reported[triangle] <= 1);
+        const MoTriangle meshTriangle = moMeshTriangle(testMesh, triangle);
+        const MoBBox boundingBox = meshTriangle.getBoundingBox();
+        if (minelem(capsuleBox.max - boundingBox.min) < 0.f || maxelem(capsuleBox.min - boundingBox.max) > 0.f)
+        {
+            MO_CHECK(reported[triangle] == 0);
+            continue;
+        }
+        const float distance = moCapsuleDistance(capsule, float3(0.f), meshTriangle);
+        if (std::abs(distance - capsule.radius) > tolerance)
+        {
+            MO_CHECK((reported[triangle] == 1) == (distance < capsule.radius));
+        }
+    }
+
+    // the count does not depend on the room given for the contacts
+    MoContact contact;
+    MO_CHECK(moOverlapCapsuleBVH(bvh, capsule, &contact, 1) == contactCount);
+    MO_CHECK(moOverlapCapsuleBVH(bvh, capsule, nullptr, 0) == contactCount);
+}
+
+static void moTestSweeps()
+{
+    MoBVHCreateInfo sah = {};
+    MoBVHCreateInfo spatialSplits = sah;
+    spatialSplits.buildMode = MO_BVH_BUILD_MODE_SPATIAL_SPLITS;
+    MoBVHCreateInfo indexed = sah;
+    indexed.triangleStorage = MO_BVH_TRIANGLE_STORAGE_INDEXED;
+
+    struct MoSweepCase
+    {
+        MoTestMesh              testMesh;
+        const MoBVHCreateInfo*  pCreateInfo;
+    };
+    MoSweepCase sweepCases[] = {{moCreateHeightField(30), &sah}, {moCreateSkinnyTriangles(300), &spatialSplits}, {moCreateTriangleSoup(1000), &indexed}};
+    for (MoSweepCase& sweepCase : sweepCases)
+    {
+        MoTestMesh& testMesh = sweepCase.testMesh;
+        moFinalizeMesh(testMesh);
+        // indexed storage reorders the indices it is built from, the brute force keeps the source order
+        MoTestMesh builtMesh = moCopyMesh(testMesh);
+        MoBVH bvh;
+        moCreateBVH(&builtMesh.mesh, sweepCase.pCreateInfo, &bvh);
+        if (sweepCase.pCreateInfo == &spatialSplits)
+        {
+            // copies of the same triangles in several leaves are what the duplicate filtering is for
+            MO_CHECK(bvh->triangleCount > testMesh.mesh.indexCount / 3);
+        }
+
+        std::uint32_t skipped = 0;
+        for (std::uint32_t i = 0; i < 150; ++i)
+        {
+            const bool sphere = i % 3 == 0;
+            MoCapsule capsule;
+            capsule.p0 = float3(moRandom(-55.f, 55.f), moRandom(-12.f, 12.f), moRandom(-55.f, 55.f));
+            capsule.p1 = sphere ? capsule.p0 : capsule.p0 + float3(moRandom(-3.f, 3.f), moRandom(-3.f, 3.f), moRandom(-3.f, 3.f));
+            capsule.radius = moRandom(0.2f, 3.f);
+            const float3 direction = normalize(float3(moRandom(-1.f, 1.f), moRandom(-1.f, 1.f), moRandom(-1.f, 1.f)));
+
+            moTestCast(testMesh, bvh, capsule, sphere, direction, moRandom(1.f, 40.f), skipped);
+            moTestOverlap(testMesh, bvh, capsule);
+        }
+        // too close to call, a few at most
+        MO_CHECK(skipped < 10);
+        moDestroyBVH(bvh);
+    }
+}
+
+int main()
+{
+    moTestSweeps();
+    return moTestResult();
+}
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE A - MIT License
+Copyright (c) 2018 Patrick Pelletier
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE B - Public Domain (www.unlicense.org)
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------
+*/
@@ -0,0 +1,320 @@
+#pragma once
+
+#include "mo_bvh.h"
+#include "mo_mesh.h"
+
+#include <linalg.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace linalg;
+using namespace linalg::aliases;
+
+// helpers shared by the BVH tests, each test checks its queries against brute force and returns the number of failures
+
+inline std::uint32_t g_FailureCount = 0;
+inline std::mt19937 g_Generator(1234);
+
+#define MO_CHECK(condition) moCheck(condition, #condition, __FILE__, __LINE__)
+
+inline void moCheck(bool condition, const char* pExpression, const char* pFile, int line)
+{
+    if (!condition)
+    {
+        // the first failures are enough to find the culprit
+        if (g_FailureCount < 20)
+        {
+            printf("%s:%d: check failed: %s\n", pFile, line, pExpression);
+        }
+        ++g_FailureCount;
+    }
+}
+
+// the exit code of the test
+inline int moTestResult()
+{
+    printf("%u failures\n", g_FailureCount);
+    return g_FailureCount == 0 ? 0 : 1;
+}
+
+inline float moRandom(float min, float max)
+{
+    return std::uniform_real_distribution<float>(min, max)(g_Generator);
+}
+
+struct MoTestMesh
+{
+    std::vector<std::uint32_t> indices;
+    std::vector<float3>        vertices;
+    MoMesh_T                   mesh;
+};
+
+inline void moFinalizeMesh(MoTestMesh& testMesh)
+{
+    testMesh.mesh = {};
+    testMesh.mesh.pIndices = testMesh.indices.data();
+    testMesh.mesh.indexCount = std::uint32_t(testMesh.indices.size());
+    testMesh.mesh.pVertices = testMesh.vertices.data();
+    testMesh.mesh.vertexCount = std::uint32_t(testMesh.vertices.size());
+}
+
+// copies point their mesh at their own arrays
+inline MoTestMesh moCopyMesh(const MoTestMesh& testMesh)
+{
+    MoTestMesh copy;
+    copy.indices = testMesh.indices;
+    copy.vertices = testMesh.vertices;
+    moFinalizeMesh(copy);
+    return copy;
+}
+
+inline MoTestMesh moCreateHeightField(std::uint32_t size)
+{
+    MoTestMesh testMesh;
+    for (std::uint32_t j = 0; j <= size; ++j)
+    {
+        for (std::uint32_t i = 0; i <= size; ++i)
+        {
+            testMesh.vertices.push_back({float(i) * 100.f / size - 50.f, std::sin(i * 0.3f) * std::cos(j * 0.2f) * 3.f, float(j) * 100.f / size - 50.f});
+        }
+    }
+    for (std::uint32_t j = 0; j < size; ++j)
+    {
+        for (std::uint32_t i = 0; i < size; ++i)
+        {
+            std::uint32_t a = j * (size + 1) + i, b = a + 1, c = a + size + 1, d = c + 1;
+            testMesh.indices.insert(testMesh.indices.end(), {a, c, b, b, c, d});
+        }
+    }
+    moFinalizeMesh(testMesh);
+    return testMesh;
+}
+
+inline MoTestMesh moCreateTriangleSoup(std::uint32_t triangleCount)
+{
+    MoTestMesh testMesh;
+    for (std::uint32_t t = 0; t < triangleCount; ++t)
+    {
+        const float3 center(moRandom(-50.f, 50.f), moRandom(-50.f, 50.f), moRandom(-50.f, 50.f));
+        for (std::uint32_t k = 0; k < 3; ++k)
+        {
+            testMesh.indices.push_back(std::uint32_t(testMesh.vertices.size()));
+            testMesh.vertices.push_back(center + float3(moRandom(-2.f, 2.f), moRandom(-2.f, 2.f), moRandom(-2.f, 2.f)));
+        }
+    }
+    moFinalizeMesh(testMesh);
+    return testMesh;
+}
+
+// long thin triangles with large overlapping bounds, what spatial splits are for
+inline MoTestMesh moCreateSkinnyTriangles(std::uint32_t triangleCount)
+{
+    MoTestMesh testMesh;
+    for (std::uint32_t t = 0; t < triangleCount; ++t)
+    {
+        const float3 center(moRandom(-50.f, 50.f), moRandom(-10.f, 10.f), moRandom(-50.f, 50.f));
+        const float3 axis = normalize(float3(moRandom(-1.f, 1.f), moRandom(-0.2f, 0.2f), moRandom(-1.f, 1.f))) * moRandom(10.f, 60.f);
+        const float3 width(moRandom(-0.1f, 0.1f), moRandom(-0.3f, 0.3f), moRandom(-0.1f, 0.1f));
+        const std::uint32_t first = std::uint32_t(testMesh.vertices.size());
+        testMesh.vertices.insert(testMesh.vertices.end(), {center - axis, center + axis, center + width});
+        testMesh.indices.insert(testMesh.indices.end(), {first, first + 1, first + 2});
+    }
+    moFinalizeMesh(testMesh);
+    return testMesh;
+}
+
+inline MoRay moRandomRay()
+{
+    const float3 origin(moRandom(-60.f, 60.f), moRandom(-10.f, 10.f), moRandom(-60.f, 60.f));
+    return MoRay(origin, normalize(float3(moRandom(-1.f, 1.f), moRandom(-1.f, 1.f), moRandom(-1.f, 1.f))));
+}
+
+inline MoTriangle moMeshTriangle(const MoTestMesh& testMesh, std::uint32_t triangle)
+{
+    MoTriangle result;
+    result.v0 = testMesh.mesh.pVertices[testMesh.mesh.pIndices[triangle * 3 + 0]];
+    result.v1 = testMesh.mesh.pVertices[testMesh.mesh.pIndices[triangle * 3 + 1]];
+    result.v2 = testMesh.mesh.pVertices[testMesh.mesh.pIndices[triangle * 3 + 2]];
+    return result;
+}
+
+inline float moSegmentDistanceSquared(const float3& point, const float3& a, const float3& b)
+{
+    const float3 ab = b - a;
+    const float t = std::min(1.f, std::max(0.f, dot(point - a, ab) / std::max(1e-30f, dot(ab, ab))));
+    const float3 d = a + ab * t - point;
+    return dot(d, d);
+}
+
+// nearest of the triangle's edges and, when the point projects inside it, of its plane
+inline float moDistanceSquared(const float3& point, const MoTriangle& triangle)
+{
+    float distanceSquared = std::min({moSegmentDistanceSquared(point, triangle.v0, triangle.v1),
+                                      moSegmentDistanceSquared(point, triangle.v1, triangle.v2),
+                                      moSegmentDistanceSquared(point, triangle.v2, triangle.v0)});
+
+    const float3 normal = cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+    const float normalLengthSquared = dot(normal, normal);
+    if (normalLengthSquared > 0.f)
+    {
+        const float3 projected = point - normal * (dot(point - triangle.v0, normal) / normalLengthSquared);
+        if (dot(cross(triangle.v1 - triangle.v0, projected - triangle.v0), normal) >= 0.f
+         && dot(cross(triangle.v2 - triangle.v1, projected - triangle.v1), normal) >= 0.f
+         && dot(cross(triangle.v0 - triangle.v2, projected - triangle.v2), normal) >= 0.f)
+        {
+            distanceSquared = std::min(distanceSquared, dot(projected - point, projected - point));
+        }
+    }
+    return distanceSquared;
+}
+
+// closest hit of every triangle of the BVH with the BVH's own triangle test, the reference for the traversals
+inline bool moIntersectBruteForce(MoBVH bvh, const MoRay& ray, float& distance, bool backfaceCulling = false)
+{
+    distance = std::numeric_limits<float>::max();
+    bool hit = false;
+    for (std::uint32_t triangle = 0; triangle < bvh->triangleCount; ++triangle)
+    {
+        float t, u, v;
+        bool triangleHit = false;
+        switch (bvh->triangleFormat)
+        {
+        case MO_BVH_TRIANGLE_FORMAT_WATERTIGHT:
+            triangleHit = moRayTriangleIntersectWatertight(ray, moGetBVHTriangle(bvh, triangle), t, u, v, backfaceCulling);
+            break;
+        case MO_BVH_TRIANGLE_FORMAT_TRANSFORM:
+            triangleHit = moRayTriangleIntersect(ray, bvh->pTriangleTransforms[triangle], t, u, v, backfaceCulling);
+            break;
+        default:
+            triangleHit = moRayTriangleIntersect(ray, moGetBVHTriangle(bvh, triangle), t, u, v, backfaceCulling);
+            break;
+        }
+        if (triangleHit && t < distance)
+        {
+            distance = t;
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+inline bool moEqual(const float3& a, const float3& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// the BVH's triangles are the mesh's, each of them at least once
+inline void moTestTriangles(const MoTestMesh& testMesh, MoBVH bvh)
+{
+    const std::uint32_t meshTriangleCount = testMesh.mesh.indexCount / 3;
+    std::vector<bool> covered(meshTriangleCount, false);
+    MO_CHECK(bvh->triangleIndexCount == bvh->triangleCount * 3 && bvh->sourceTriangleCount == bvh->triangleCount);
+    for (std::uint32_t triangle = 0; triangle < bvh->triangleCount; ++triangle)
+    {
+        const MoTriangle bvhTriangle = moGetBVHTriangle(bvh, triangle);
+        MO_CHECK(moEqual(bvhTriangle.v0, testMesh.mesh.pVertices[bvh->pTriangleIndices[triangle * 3 + 0]]));
+        MO_CHECK(moEqual(bvhTriangle.v1, testMesh.mesh.pVertices[bvh->pTriangleIndices[triangle * 3 + 1]]));
+        MO_CHECK(moEqual(bvhTriangle.v2, testMesh.mesh.pVertices[bvh->pTriangleIndices[triangle * 3 + 2]]));
+        const std::uint32_t sourceTriangle = bvh->pSourceTriangles[triangle];
+        MO_CHECK(sourceTriangle < meshTriangleCount);
+        if (sourceTriangle < meshTriangleCount)
+        {
+            covered[sourceTriangle] = true;
+        }
+    }
+    MO_CHECK(std::find(covered.begin(), covered.end(), false) == covered.end());
+}
+
+inline bool moSameHit(bool hit, float distance, bool expectedHit, float expectedDistance)
+{
+    return hit == expectedHit && (!hit || std::abs(distance - expectedDistance) <= 1e-4f * std::max(1.f, expectedDistance));
+}
+
+// the BVH's queries against brute force over its own triangles
+inline void moTestTraversal(const MoTestMesh& testMesh, MoBVH bvh, std::uint32_t rayCount)
+{
+    moTestTriangles(testMesh, bvh);
+
+    MoBVHWide bvh4, bvh8;
+    moCreateBVHWide(bvh, 4, &bvh4);
+    moCreateBVHWide(bvh, 8, &bvh8);
+    for (std::uint32_t i = 0; i < rayCount; ++i)
+    {
+        const MoRay ray = moRandomRay();
+        const bool backfaceCulling = i & 1;
+        float expectedDistance;
+        const bool expectedHit = moIntersectBruteForce(bvh, ray, expectedDistance, backfaceCulling);
+
+        MoIntersectResult intersection = {};
+        const bool hit = moIntersectBVH(bvh, ray, intersection, backfaceCulling);
+        MO_CHECK(moSameHit(hit, intersection.distance, expectedHit, expectedDistance));
+        if (hit)
+        {
+            MO_CHECK(intersection.sourceTriangleIndex < testMesh.mesh.indexCount / 3);
+            MO_CHECK(std::abs(intersection.barycentric.x + intersection.barycentric.y + intersection.barycentric.z - 1.f) < 1e-4f);
+        }
+
+        MoIntersectResult intersection4 = {}, intersection8 = {};
+        const bool hit4 = moIntersectBVHWide(bvh4, ray, intersection4, backfaceCulling);
+        const bool hit8 = moIntersectBVHWide(bvh8, ray, intersection8, backfaceCulling);
+        MO_CHECK(moSameHit(hit4, intersection4.distance, expectedHit, expectedDistance));
+        MO_CHECK(moSameHit(hit8, intersection8.distance, expectedHit, expectedDistance));
+
+        // occluded before the hit only when there is one
+        const float tMax = moRandom(0.f, 80.f);
+        const bool occluded = moOccludedBVH(bvh, ray, tMax, 0.f, backfaceCulling);
+        if (!expectedHit || std::abs(expectedDistance - tMax) > 1e-3f)
+        {
+            MO_CHECK(occluded == (expectedHit && expectedDistance <= tMax));
+        }
+    }
+    moDestroyBVHWide(bvh8);
+    moDestroyBVHWide(bvh4);
+}
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE A - MIT License
+Copyright (c) 2018 Patrick Pelletier
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE B - Public Domain (www.unlicense.org)
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------
+*/
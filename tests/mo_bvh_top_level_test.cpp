@@ -0,0 +1,114 @@
+#include "mo_bvh_test.h"
+
+// moIntersectTopLevelBVH against every instance traced in its object space, before and after the instances move
+
+static void moTestTopLevel()
+{
+    MoTestMesh heightField = moCreateHeightField(30);
+    MoTestMesh triangleSoup = moCreateTriangleSoup(500);
+    MoBVH heightFieldBVH, triangleSoupBVH;
+    moCreateBVH(&heightField.mesh, nullptr, &heightFieldBVH);
+    moCreateBVH(&triangleSoup.mesh, nullptr, &triangleSoupBVH);
+
+    // rigid transforms keep distances along the ray, a turn around y then a translation
+    std::vector<MoBVHInstance> instances(100);
+    for (MoBVHInstance& instance : instances)
+    {
+        const float angle = moRandom(0.f, 6.28f);
+        instance.model[0] = {std::cos(angle), 0.f, -std::sin(angle), 0.f};
+        instance.model[1] = {0.f, 1.f, 0.f, 0.f};
+        instance.model[2] = {std::sin(angle), 0.f, std::cos(angle), 0.f};
+        instance.model[3] = {moRandom(-400.f, 400.f), moRandom(-40.f, 40.f), moRandom(-400.f, 400.f), 1.f};
+        instance.bvh = (&instance - instances.data()) & 1 ? heightFieldBVH : triangleSoupBVH;
+    }
+    MoTopLevelBVH topLevelBVH;
+    moCreateTopLevelBVH(instances.data(), std::uint32_t(instances.size()), &topLevelBVH);
+
+    for (std::uint32_t pass = 0; pass < 2; ++pass)
+    {
+        for (std::uint32_t i = 0; i < 300; ++i)
+        {
+            const float3 origin(moRandom(-450.f, 450.f), moRandom(-60.f, 60.f), moRandom(-450.f, 450.f));
+            const MoRay ray(origin, normalize(float3(moRandom(-1.f, 1.f), moRandom(-0.3f, 0.3f), moRandom(-1.f, 1.f))));
+
+            float expectedDistance = std::numeric_limits<float>::max();
+            for (const MoBVHInstance& instance : instances)
+            {
+                const float4x4 inverseModel = inverse(instance.model);
+                const MoRay objectRay(mul(inverseModel, float4(ray.origin, 1.f)).xyz(), mul(inverseModel, float4(ray.direction, 0.f)).xyz());
+                MoIntersectResult intersection = {};
+                if (moIntersectBVH(instance.bvh, objectRay, intersection))
+                {
+                    expectedDistance = std::min(expectedDistance, intersection.distance);
+                }
+            }
+
+            MoIntersectResult intersection = {};
+            std::uint32_t instanceIndex;
+            const bool hit = moIntersectTopLevelBVH(topLevelBVH, ray, intersection, instanceIndex);
+            MO_CHECK(moSameHit(hit, intersection.distance, expectedDistance != std::numeric_limits<float>::max(), expectedDistance));
+            MO_CHECK(!hit || instanceIndex < instances.size());
+        }
+
+        // move every instance and check again
+        std::vector<float4x4> models(instances.size());
+        for (std::size_t i = 0; i < instances.size(); ++i)
+        {
+            instances[i].model[3] += float4(moRandom(-20.f, 20.f), 0.f, moRandom(-20.f, 20.f), 0.f);
+            models[i] = instances[i].model;
+        }
+        moRefitTopLevelBVH(topLevelBVH, models.data());
+    }
+
+    moDestroyTopLevelBVH(topLevelBVH);
+    moDestroyBVH(triangleSoupBVH);
+    moDestroyBVH(heightFieldBVH);
+}
+
+int main()
+{
+    moTestTopLevel();
+    return moTestResult();
+}
+
+/*
+------------------------------------------------------------------------------
+This software is available under 2 licenses -- choose whichever you prefer.
+------------------------------------------------------------------------------
+ALTERNATIVE A - MIT License
+Copyright (c) 2018 Patrick Pelletier
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+------------------------------------------------------------------------------
+ALTERNATIVE B - Public Domain (www.unlicense.org)
+This is free and unencumbered software released into the public domain.
+Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+software, either in source code form or as a compiled binary, for any purpose,
+commercial or non-commercial, and by any means.
+In jurisdictions that recognize copyright laws, the author or authors of this
+software dedicate any and all copyright interest in the software to the public
+domain. We make this dedication for the benefit of the public at large and to
+the detriment of our heirs and successors. We intend this dedication to be an
+overt act of relinquishment in perpetuity of all present and future rights to
+this software under copyright law.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------
+*/